@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Page size behind large blocks of AlignedAllocator
+enum class HugePages {
+    NONE,           // 4 KB pages (THP disabled for the block with MADV_NOHUGEPAGE)
+    TRANSPARENT,    // 2 MB aligned block advised with MADV_HUGEPAGE, the kernel backs it when it can
+    EXPLICIT        // MAP_HUGETLB from the reserved pool (vm.nr_hugepages), TRANSPARENT if that fails
+};
+
+// 64-byte aligned blocks. Blocks of at least LARGE_BLOCK bytes are mapped directly, 2 MB
+// aligned and rounded up to whole 2 MB pages, so the streaming passes over the dataset touch
+// one TLB entry per 2 MB instead of per 4 KB. How a block was allocated follows from its size
+// alone, so the page mode can change while blocks are alive. Outside Linux every block comes
+// from aligned operator new.
+namespace AlignedMemory {
+    constexpr size_t ALIGNMENT = 64;
+    constexpr size_t HUGE_PAGE = size_t(2) << 20;
+    constexpr size_t LARGE_BLOCK = HUGE_PAGE;
+
+    // Mode of the large blocks allocated from now on (process-wide, default TRANSPARENT)
+    void setHugePages(HugePages mode);
+    HugePages getHugePages();
+
+    void* allocate(size_t bytes);
+    void release(void* p, size_t bytes);
+
+    // EXPLICIT requests that fell back to transparent pages so far
+    long long getExplicitFallbacks();
+    // AnonHugePages of the process in bytes (/proc/self/smaps_rollup), -1 where unavailable
+    long long residentHugePageBytes();
+}
+
+template <class T>
+class AlignedAllocator {
+public:
+    using value_type = T;
+
+    AlignedAllocator() noexcept = default;
+    template <class U> AlignedAllocator(const AlignedAllocator<U>&) noexcept {}
+
+    T* allocate(size_t n) {
+        if (n > static_cast<size_t>(-1) / sizeof(T)) throw std::bad_array_new_length();
+        return static_cast<T*>(AlignedMemory::allocate(n * sizeof(T)));
+    }
+    void deallocate(T* p, size_t n) noexcept { AlignedMemory::release(p, n * sizeof(T)); }
+
+    // Default-init instead of value-init: resize(n) leaves trivial types (double, int) uninitialized,
+    // like new T[n], so a large block is first touched by whoever writes it. assign(n, v) still fills
+    template <class U> void construct(U* p) noexcept(std::is_nothrow_default_constructible<U>::value) {
+        ::new (static_cast<void*>(p)) U;
+    }
+    template <class U, class... Args> void construct(U* p, Args&&... args) {
+        ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
+    }
+
+    template <class U> bool operator==(const AlignedAllocator<U>&) const noexcept { return true; }
+    template <class U> bool operator!=(const AlignedAllocator<U>&) const noexcept { return false; }
+};
+
+template <class T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
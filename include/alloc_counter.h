@@ -0,0 +1,12 @@
+#pragma once
+
+// Test hook counting heap allocations, used to check that the steady-state iterations
+// of the engines do not allocate. Counting replaces the global operator new/delete and is
+// only compiled in with -DKMEANS_ALLOC_HOOK, otherwise count() is always 0.
+namespace AllocCounter {
+    bool enabled();
+    // Allocations made by all threads since the program started
+    long long count();
+    // Allocations made by the calling thread only, e.g. one simulated rank among others
+    long long threadCount();
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "utils.h"
+#include "kmeans_model.h"
+#include "cluster_metrics.h"
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// One node of the split tree. Inner nodes have two children, leaves carry a cluster id
+struct BisectingNode {
+    int left = -1;
+    int right = -1;
+    int leaf = -1;          // final cluster id, -1 for inner nodes
+    long long size = 0;     // training points below this node
+    double sse = 0.0;       // squared distances of those points to the node centroid
+};
+
+// Divisive k-means for very large k: every node is split in two by ParallelKMeans(2)
+// on its own points, and the leaf budget k is divided between the children in proportion
+// to their SSE. Large nodes use the whole thread team one after another, below a size
+// cutoff the independent subtrees run as OpenMP tasks. The tree is kept as a
+// coarse-to-fine index: a point descends to the nearer child, O(depth * dim) instead of O(k * dim).
+class BisectingKMeans {
+private:
+    // A pending split: the node, its points and how many leaves it may produce
+    struct Task {
+        int node;
+        std::vector<size_t> indices;
+        int budget;
+        uint64_t key;       // hash of the path from the root, seeds the split
+    };
+
+    int k;
+    int maxIter;
+    double threshold;
+    unsigned int seed;
+    int dim = 0;
+
+    std::vector<BisectingNode> nodes;
+    std::vector<double> nodeCentroids;  // node * dim, row-major
+    std::atomic<int> nextNode{0};
+    std::vector<Point> centroids;       // leaves, in cluster id order
+    KMeansResult result;
+    ModelMetadata trainingInfo;
+    std::atomic<int> totalIterations{0};
+
+    void meanOf(const Dataset& data, const std::vector<size_t>& indices, int node);
+    // Splits one node, fills the children and returns false when it has to stay a leaf
+    bool split(const Dataset& data, Task& task, Task& left, Task& right);
+    // Task-parallel recursion for the nodes below the cutoff
+    void splitSubtree(Dataset& data, Task task);
+    void makeLeaf(Dataset& data, const Task& task);
+    int numberLeaves(int node, int next);
+
+public:
+    BisectingKMeans(int k, int maxIter = 50, double threshold = 1e-4, unsigned int seed = 1);
+
+    // Writes the leaf id to Point::clusterId. iterations is the total over all 2-means runs
+    KMeansResult run(Dataset& data);
+
+    // Leaf reached by greedy descent (approximate nearest centroid), dist is the squared distance to it
+    int nearestLeaf(const double* point, double* dist = nullptr) const;
+    // Tree-index scoring of n contiguous points (n * dim doubles)
+    void predict(const double* points, size_t n, int* labels) const;
+
+    [[nodiscard]] const std::vector<Point>& getCentroids() const { return centroids; }
+    [[nodiscard]] const std::vector<BisectingNode>& getNodes() const { return nodes; }
+    // Flat model over the leaves, exact nearest-centroid scoring
+    [[nodiscard]] KMeansModel getModel() const { return KMeansModel(centroids, result.clusterSizes, trainingInfo); }
+};
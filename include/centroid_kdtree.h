@@ -0,0 +1,44 @@
+#pragma once
+
+#include "utils.h"
+#include <vector>
+
+// k-d tree over the centroids, rebuilt once per iteration and queried with branch-and-bound.
+// Only pays off in low dimensions with many clusters, see isBeneficial().
+// Nodes and permuted centroid copies live in flat arrays reused between rebuilds.
+class CentroidKDTree {
+private:
+    struct Node {
+        int splitDim;       // -1 for leaves
+        double splitValue;
+        int left, right;    // child node indices
+        int begin, end;     // range in ids/points (leaves only)
+    };
+
+    static constexpr int LEAF_SIZE = 8;
+
+    int k = 0;
+    int dim = 0;
+    std::vector<Node> nodes;
+    std::vector<int> ids;        // original centroid index, tree order
+    std::vector<double> points;  // centroid coords, tree order (k * dim)
+    std::vector<double> staging; // flattened input of build(std::vector<Point>)
+
+    int buildNode(int begin, int end);
+    void search(int nodeIdx, const double* point, double& bestDist, int& best) const;
+
+public:
+    // Automatic strategy selection, crossover points measured with --kdtree
+    // (brute force wins for high dim or small k)
+    static bool isBeneficial(int k, int dim) {
+        if (dim <= 3) return k >= 64;
+        if (dim <= 5) return k >= 256;
+        return dim <= 8 && k >= 1024;
+    }
+
+    void build(const double* centroids, int k, int dim);
+    void build(const std::vector<Point>& centroids);
+
+    // Same result as a brute-force scan (ties resolved to the lower centroid index)
+    int nearest(const double* point, double& bestDist) const;
+};
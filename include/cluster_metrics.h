@@ -0,0 +1,27 @@
+#pragma once
+
+#include "utils.h"
+#include <vector>
+
+// Outcome of a run() together with the quality metrics gathered during the assignment pass
+struct KMeansResult {
+    int iterations = 0;
+    bool converged = false;
+    // Sum of squared distances of every point to its assigned centroid, taken from the
+    // last assignment pass (i.e. against the centroids before the final update)
+    double inertia = 0.0;
+    std::vector<long long> clusterSizes;
+    std::vector<double> clusterSSE;
+    // Sampled silhouette estimate in [-1, 1], only computed when a sample size is set
+    double silhouette = 0.0;
+    // Empty clusters moved by the EmptyClusterPolicy over the whole run
+    int reseededClusters = 0;
+};
+
+class ClusterMetrics {
+public:
+    // Silhouette over a random sample of labeled points, O(sampleSize^2 * dim)
+    static double sampledSilhouette(const Dataset& data, int k, int sampleSize, unsigned int seed = 0);
+    // Exact silhouette of a flat (n * dim) set of labeled points
+    static double silhouette(const std::vector<double>& flat, const std::vector<int>& labels, int dim, int k);
+};
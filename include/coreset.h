@@ -0,0 +1,15 @@
+#pragma once
+
+#include "utils.h"
+#include <cstddef>
+#include <cstdint>
+
+// Lightweight coreset (sensitivity sampling against the data mean, Bachem et al. 2018).
+// Point x is drawn with probability q(x) = 1/2 * w(x) / W + 1/2 * w(x) d(x, mean)^2 / sum w d^2
+// and gets the weight w(x) / (m q(x)), so the weighted cost of any set of centroids on the
+// coreset is an unbiased estimate of its cost on the full data. Two passes over the data.
+class Coreset {
+public:
+    // m weighted points (drawn with replacement), seed == 0 draws a random seed
+    static Dataset build(const Dataset& data, size_t m, uint64_t seed = 0);
+};
@@ -1,15 +1,50 @@
 #pragma once
 
 #include "utils.h"
+#include "sparse_dataset.h"
 #include <string>
 #include <vector>
+#include <cstdint>
+
+enum class DataDistribution {
+    UNIFORM,            // uniform noise in [minVal, maxVal]^dim, no cluster structure
+    GAUSSIAN_MIXTURE,   // isotropic gaussian blobs around random centers
+    ANISOTROPIC_BLOBS   // gaussian blobs stretched by a random linear map per cluster
+};
+
+// Everything that defines a synthetic dataset. Same spec (with a fixed seed) -> same data,
+// whatever the thread count, rank count or slice of indices generated.
+struct GeneratorSpec {
+    DataDistribution distribution = DataDistribution::UNIFORM;
+    int dim = 3;
+    double minVal = 0.0;        // bounding box of the data (uniform) or of the cluster centers
+    double maxVal = 1000.0;
+    int numClusters = 10;
+    double clusterStd = 20.0;   // spread of every blob
+    uint64_t seed = 0;          // 0 draws a random seed
+};
 
 class DataLoader {
 public:
-    // Generates random synthetic dataset
-    static Dataset generateData(int numPoints, int dim, double minVal, double maxVal);
-    // Optional loading data from csv file (todo incase if something doesnt work with synth data generation)
+    // Generates random synthetic dataset (uniform noise)
+    static Dataset generateData(int numPoints, int dim, double minVal, double maxVal, uint64_t seed = 0);
+    // Generates a dataset from a spec, labels (optional) receive the ground-truth component
+    static Dataset generate(const GeneratorSpec& spec, long long numPoints, std::vector<int>* labels = nullptr);
+    // Writes points [firstIndex, firstIndex + count) straight into contiguous storage (count * dim),
+    // e.g. a rank generating only its own slice. The spec must carry a fixed seed.
+    static void generateInto(const GeneratorSpec& spec, long long firstIndex, long long count,
+                             double* out, int* labels = nullptr);
+    // Sparse (CSR) topic-like data: about density * dim nonzeros per row, most of them in the
+    // hot dims of the row's cluster, rows L2-normalized. Same seed -> same data for any thread count
+    static SparseDataset generateSparse(long long numPoints, int dim, double density, int numClusters,
+                                        uint64_t seed = 0, std::vector<int>* labels = nullptr);
+    // Caches ||x||^2 of every point in Point::normSq, in parallel
+    static void computeNorms(Dataset& data);
+    // Ground-truth cluster centers of a mixture spec (numClusters * dim)
+    static std::vector<double> groundTruthCenters(const GeneratorSpec& spec);
+    // One point per line, values separated by commas, semicolons or spaces. A first line that is
+    // not numeric (header), empty lines and '#' lines are skipped. Empty dataset on any error
     static Dataset loadFromCSV(const std::string& filename);
     //Function to print fragments of data (used for debugging)
     static void printData(const Dataset& data, int numLines = 5);
-};
\ No newline at end of file
+};
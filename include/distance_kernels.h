@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstddef>
+#include <limits>
+
+// Flat (row-major) kernels shared by the engines and the scoring model.
+// Every vector is a contiguous array of `dim` doubles.
+
+//Squared euclidean distance between two contiguous vectors
+[[nodiscard]] inline double squaredDistance(const double* a, const double* b, int dim) {
+    double sum = 0.0;
+    #pragma omp simd reduction(+:sum)
+    for (int d = 0; d < dim; ++d) {
+        double diff = a[d] - b[d];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+//Index of the nearest centroid in a flat k * dim array, its distance goes to bestDist
+inline int nearestCentroid(const double* point, const double* centroids, int k, int dim, double& bestDist) {
+    double minDist = std::numeric_limits<double>::max();
+    int bestCluster = -1;
+    for (int j = 0; j < k; ++j) {
+        double dist = squaredDistance(point, centroids + static_cast<size_t>(j) * dim, dim);
+        if (dist < minDist) {
+            minDist = dist;
+            bestCluster = j;
+        }
+    }
+    bestDist = minDist;
+    return bestCluster;
+}
+
+
+//Dot product of two contiguous vectors
+[[nodiscard]] inline double dotProduct(const double* a, const double* b, int dim) {
+    double sum = 0.0;
+    #pragma omp simd reduction(+:sum)
+    for (int d = 0; d < dim; ++d) sum += a[d] * b[d];
+    return sum;
+}
+
+//Squared norms of the k rows of a flat k * dim array
+inline void rowNorms(const double* rows, int k, int dim, double* norms) {
+    for (int j = 0; j < k; ++j) norms[j] = dotProduct(rows + static_cast<size_t>(j) * dim, rows + static_cast<size_t>(j) * dim, dim);
+}
+
+// Nearest centroid through ||x||^2 + ||c||^2 - 2 x.c with cached norms: one multiply-add per
+// coordinate instead of a subtraction and a multiply-add. The expanded form cancels badly when
+// the distance is small next to the norms, so whenever another centroid is within the rounding
+// bound of the best one the candidates are compared by their exact distance instead. The answer
+// is the one nearestCentroid gives (lowest index on exact ties), bestDist is the exact distance
+inline int nearestCentroidByNorms(const double* point, double pointNorm, const double* centroids,
+                                  const double* centroidNorms, int k, int dim, double& bestDist) {
+    double best = std::numeric_limits<double>::max();
+    double second = std::numeric_limits<double>::max();
+    double maxNorm = 0.0;
+    int bestCluster = -1;
+    auto consider = [&](int j, double dot) {
+        double dist = pointNorm + centroidNorms[j] - 2.0 * dot;
+        if (centroidNorms[j] > maxNorm) maxNorm = centroidNorms[j];
+        if (dist < best) {
+            second = best;
+            best = dist;
+            bestCluster = j;
+        } else if (dist < second) {
+            second = dist;
+        }
+    };
+
+    // Four centroids per pass over the point, every coordinate of x is loaded once for all four
+    int j = 0;
+    for (; j + 4 <= k; j += 4) {
+        const double* c0 = centroids + static_cast<size_t>(j) * dim;
+        const double* c1 = c0 + dim;
+        const double* c2 = c1 + dim;
+        const double* c3 = c2 + dim;
+        double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+        #pragma omp simd reduction(+:s0, s1, s2, s3)
+        for (int d = 0; d < dim; ++d) {
+            s0 += point[d] * c0[d];
+            s1 += point[d] * c1[d];
+            s2 += point[d] * c2[d];
+            s3 += point[d] * c3[d];
+        }
+        consider(j, s0);
+        consider(j + 1, s1);
+        consider(j + 2, s2);
+        consider(j + 3, s3);
+    }
+    for (; j < k; ++j) consider(j, dotProduct(point, centroids + static_cast<size_t>(j) * dim, dim));
+
+    // Rounding error of the norms, the dot and the exact kernel, each O(dim * eps * norms)
+    const double margin = (4.0 * dim + 8.0) * std::numeric_limits<double>::epsilon() * (pointNorm + maxNorm);
+    if (second - best <= 2.0 * margin) {
+        double exactBest = std::numeric_limits<double>::max();
+        for (j = 0; j < k; ++j) {
+            const double* c = centroids + static_cast<size_t>(j) * dim;
+            // Recomputed values may round differently from the blocked pass, hence the wider window
+            if (pointNorm + centroidNorms[j] - 2.0 * dotProduct(point, c, dim) > best + 4.0 * margin) continue;
+            double dist = squaredDistance(point, c, dim);
+            if (dist < exactBest) {
+                exactBest = dist;
+                bestCluster = j;
+            }
+        }
+        bestDist = exactBest;
+        return bestCluster;
+    }
+    bestDist = squaredDistance(point, centroids + static_cast<size_t>(bestCluster) * dim, dim);
+    return bestCluster;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "utils.h"
+#include "distance_kernels.h"
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
+
+// Distance used by the engines. Stored in the model file, so the values must stay stable
+enum class DistanceMetric {
+    SQUARED_EUCLIDEAN = 0,  // classic k-means, centroids are means
+    COSINE = 1,             // spherical k-means: 1 - cos(x, c), centroids are unit-length mean directions
+    MANHATTAN = 2           // k-medians: L1 distance, centroids are per-dimension medians
+};
+
+// Metric policies. The engines are instantiated once per policy, so the inner loop calls an
+// inlined, vectorized kernel instead of dispatching per distance.
+struct SquaredEuclideanMetric {
+    static constexpr DistanceMetric id = DistanceMetric::SQUARED_EUCLIDEAN;
+    static constexpr bool supportsKDTree = true;    // the centroid tree prunes on euclidean bounds
+    static constexpr bool normalizedCentroids = false;
+    static constexpr bool medianUpdate = false;
+
+    static double distance(const double* point, const double* centroid, int dim) {
+        return squaredDistance(point, centroid, dim);
+    }
+};
+
+struct CosineMetric {
+    static constexpr DistanceMetric id = DistanceMetric::COSINE;
+    static constexpr bool supportsKDTree = false;
+    static constexpr bool normalizedCentroids = true;
+    static constexpr bool medianUpdate = false;
+
+    // Centroids are unit length, so only the norm of the point is needed (same pass as the dot)
+    static double distance(const double* point, const double* centroid, int dim) {
+        double dot = 0.0, normSq = 0.0;
+        #pragma omp simd reduction(+:dot, normSq)
+        for (int d = 0; d < dim; ++d) {
+            dot += point[d] * centroid[d];
+            normSq += point[d] * point[d];
+        }
+        return normSq > 0.0 ? 1.0 - dot / std::sqrt(normSq) : 1.0;
+    }
+};
+
+struct ManhattanMetric {
+    static constexpr DistanceMetric id = DistanceMetric::MANHATTAN;
+    static constexpr bool supportsKDTree = false;
+    static constexpr bool normalizedCentroids = false;
+    static constexpr bool medianUpdate = true;
+
+    static double distance(const double* point, const double* centroid, int dim) {
+        double sum = 0.0;
+        #pragma omp simd reduction(+:sum)
+        for (int d = 0; d < dim; ++d) sum += std::fabs(point[d] - centroid[d]);
+        return sum;
+    }
+};
+
+// Calls fn with a default-constructed policy of the given metric: one switch per pass,
+// everything below it is compiled for that metric
+template <class Fn>
+decltype(auto) withMetric(DistanceMetric metric, Fn&& fn) {
+    switch (metric) {
+        case DistanceMetric::COSINE: return fn(CosineMetric{});
+        case DistanceMetric::MANHATTAN: return fn(ManhattanMetric{});
+        default: return fn(SquaredEuclideanMetric{});
+    }
+}
+
+// Index of the nearest centroid under Metric in a flat k * dim array, its distance goes to bestDist
+template <class Metric>
+inline int nearestCentroidWith(const double* point, const double* centroids, int k, int dim, double& bestDist) {
+    double minDist = std::numeric_limits<double>::max();
+    int bestCluster = -1;
+    for (int j = 0; j < k; ++j) {
+        double dist = Metric::distance(point, centroids + static_cast<size_t>(j) * dim, dim);
+        if (dist < minDist) {
+            minDist = dist;
+            bestCluster = j;
+        }
+    }
+    bestDist = minDist;
+    return bestCluster;
+}
+
+const char* metricName(DistanceMetric metric);
+// Upper bound on the distance between a point and a centroid, both with coordinates in [-maxAbs, maxAbs]
+double maxDistance(DistanceMetric metric, double maxAbs, int dim);
+
+// Centroid updates that are not a plain weighted mean
+class CentroidUpdate {
+public:
+    // Scales a centroid to unit length (spherical k-means), zero vectors are left as they are
+    static void normalize(double* centroid, int dim);
+    // Weighted per-dimension medians of every cluster, written into out[j].coords (k-medians).
+    // Clusters without points keep their old coordinates
+    static void medians(const Dataset& data, int k, std::vector<Point>& out);
+    // Lower weighted median of (value, weight) pairs, reorders the input
+    static double weightedMedian(std::vector<std::pair<double, double>>& values);
+};
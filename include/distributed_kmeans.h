@@ -1,8 +1,25 @@
 #pragma once
 
 #include "utils.h"
+#include "kmeans_model.h"
+#include "centroid_kdtree.h"
+#include "cluster_metrics.h"
+#include "empty_cluster.h"
+#include "distance_metrics.h"
+#include "kmeans_workspace.h"
+#include "label_writer.h"
+#include "reproducible_sum.h"
+#include "sparse_dataset.h"
+#include "sums_exchange.h"
+#include "transport.h"
 #include <vector>
-#include <mpi.h>
+
+// How the per-rank labels reach the disk
+enum class LabelOutputMode {
+    GATHER,      // gathered to rank 0, which writes one file
+    SHARDED,     // every rank writes <filename>.rank<N> with its own slice
+    COLLECTIVE   // one file written by all ranks at their offsets (MPI-IO with MpiTransport)
+};
 
 class DistributedKMeans {
 private:
@@ -11,6 +28,7 @@ private:
     double threshold;
 
     //MPI data
+    Transport* comm;    // MPI_COMM_WORLD or simulated ranks
     int world_rank; // process ID
     int world_size; // number of processes
 
@@ -26,15 +44,112 @@ private:
     void addLog(double start, double end, int type, const std::string& name);
 
     std::vector<Point> centroids;
+    Dataset localData;              // this rank's slice of the last run, with its labels
+    int localOffset = 0;            // global index of localData[0]
+    int totalPoints = 0;
+    std::vector<Point> initialCentroids; // empty -> random initialization
+    KMeansResult result;            // metrics of the last run, filled during the passes
+    ModelMetadata trainingInfo;
+    int silhouetteSample = 0;       // 0 disables the sampled silhouette
+    CentroidKDTree centroidTree;
+    EmptyClusterPolicy emptyPolicy = EmptyClusterPolicy::FARTHEST_POINT;
+    DistanceMetric metric = DistanceMetric::SQUARED_EUCLIDEAN;
+    ReseedTracker reseedTracker;
+    KMeansWorkspace workspace;      // per-run scratch incl. the Allreduce buffers
+    CommCompression compression = CommCompression::NONE;
+    SumsExchange exchange;          // reduces the sums row, compressed or not
+    bool hierarchical = false;
+    int ranksPerNode = 0;           // 0 -> real nodes (MPI_COMM_TYPE_SHARED)
+    NodeReducer nodeReducer;        // shared-memory window, kept across runs
+    long long commBytes = 0;        // payload this rank sent in the per-iteration collectives
+    long long steadyStateAllocations = 0;
+    int staleness = 0;              // 0: bulk synchronous, see setStaleness()
+    double reductionWait = 0.0;     // seconds this rank blocked on the per-iteration reductions
+    bool reproducible = false;
+    ReproducibleSum coordSum;       // same bounds on every rank, see configureSums()
+    ReproducibleSum weightSum;
+    ReproducibleSum sseSum;
 
     void initializeCentroids(const Dataset& data);
+    template <class Metric> void assignLocal(Dataset& local_data, const double* flat_centroids, const double* centroid_norms, int dim);
+    // Bounds of the reproducible sums from the global largest coordinate and weight (collective call)
+    void configureSums(const Dataset& local_data, int n_points, int dim);
+    // k-medians update: weighted median over the ranks of every rank's local medians
+    // (exact on one rank, an approximation of the global median otherwise)
+    void combineMedians(const Dataset& local_data, int dim, std::vector<double>& medians);
+    // Stale-synchronous main loop, returns the iterations this rank ran
+    int runStaleSynchronous(Dataset& local_data, std::vector<double>& flat_centroids, std::vector<double>& centroid_norms,
+                            int dim, bool& converged, long long& allocsAfterFirst);
+    bool writeCollective(const std::string& filename, LabelFormat format,
+                         const std::vector<int>& labels, const std::vector<double>* distances);
+    // Gathers a proportional sample of every rank's labeled points and scores it on rank 0
+    double sampledSilhouette(const Dataset& local_data, int n_points, int dim);
+    // Moves empty centroids using the per-rank candidates, returns how many were reseeded
+    int reseedEmptyClusters(const Dataset& local_data, const std::vector<int>& emptyClusters,
+                            const std::vector<double>& clusterSSE, int dim,
+                            std::vector<double>& flat_centroids, double& maxShift);
+    // Same for the sparse path (farthest points only), rows is the k * dim centroid buffer
+    int reseedSparse(const SparseDataset& local_data, const std::vector<int>& emptyClusters, int dim,
+                     double* rows, double& maxShift);
 
 public:
-    DistributedKMeans(int k, int maxIter = 100, double threshold = 1e-4);
+    // Every rank of the transport constructs its own instance and calls run() together
+    DistributedKMeans(int k, int maxIter = 100, double threshold = 1e-4, Transport& transport = Transport::world());
     ~DistributedKMeans();
 
-    int run(Dataset& data);
+    KMeansResult run(Dataset& data);
+    // CSR input on rank 0, rows are scattered with their nonzeros only. Labels are gathered
+    // back into data.labels on rank 0, centroids stay dense and are identical on every rank
+    KMeansResult run(SparseDataset& data);
     void saveLogsToCSV();
 
+    // Labels of the last run in global order, received by rank 0 only (collective call)
+    void gatherLabels(std::vector<int>& labels, std::vector<double>* distances = nullptr);
+    // Writes the labels of the last run (collective call). Distances are the squared
+    // distances to the final centroids. Returns false on every rank if any rank failed.
+    bool writeLabels(const std::string& filename, LabelFormat format, LabelOutputMode mode,
+                     bool withDistances = false);
+
     [[nodiscard]] const std::vector<Point>& getCentroids() const {return centroids;}
+    // Sampled silhouette estimate after the run (O(sampleSize^2 * dim)), 0 disables it
+    void setSilhouetteSample(int sampleSize) { silhouetteSample = sampleSize; }
+    void setEmptyClusterPolicy(EmptyClusterPolicy policy) { emptyPolicy = policy; }
+    // COSINE keeps unit-length centroids (spherical k-means), MANHATTAN moves them to medians
+    void setDistanceMetric(DistanceMetric newMetric) { metric = newMetric; }
+    // Start from given centroids (e.g. a solution on a coreset) instead of random points
+    void setInitialCentroids(const std::vector<Point>& initial) { initialCentroids = initial; }
+    // Compressed sums exchange for large k * dim. The ranks then update the centroids on their own
+    // instead of receiving them from rank 0. FLOAT32_DELTA confirms convergence with one exact pass
+    void setCommCompression(CommCompression mode) { compression = mode; }
+    // Two-level reductions: shared memory inside a node, Allreduce between node leaders only.
+    // ranksPerNode > 0 simulates nodes of that many consecutive ranks (testing on one machine).
+    // MPI transport only, simulated ranks fall back to flat reductions
+    void setHierarchicalReduce(bool enabled, int simulatedRanksPerNode = 0) {
+        hierarchical = enabled;
+        ranksPerNode = simulatedRanksPerNode;
+    }
+    // Stale-synchronous mode: every iteration starts a non-blocking reduction of the local sums and
+    // goes on with the newest centroids this rank has, at most `iterations` reductions behind, so a
+    // straggler only stalls the others once it is that far back. 0 (default) is bulk synchronous.
+    // Results are applied in order, the centroids of reduction r are the same on every rank. Converged
+    // once iterations + 1 consecutive results each moved the centroids less than the threshold,
+    // every rank stops at the same iteration. Empty clusters keep their centroid. Compression and
+    // hierarchical reductions do not apply, k-medians stays synchronous
+    void setStaleness(int iterations) { staleness = iterations > 0 ? iterations : 0; }
+    // Bit-identical centroids, SSE and inertia for any number of ranks and any reduction tree: the
+    // sums row carries ReproducibleSum accumulators (three times the bytes per Allreduce). Needs the
+    // exact bulk-synchronous exchange, so compression and staleness are ignored. k-medians combines
+    // per-rank medians and stays rank-count dependent. Dense data only
+    void setReproducible(bool enabled) { reproducible = enabled; }
+    // Seconds this rank spent blocked on the per-iteration reductions of the last run
+    [[nodiscard]] double getReductionWaitTime() const { return reductionWait; }
+    // Bytes this rank sent in the per-iteration collectives of the last run (with hierarchical
+    // reductions only what left the node)
+    [[nodiscard]] long long getCommunicatedBytes() const { return commBytes; }
+    // Heap allocations by this rank's thread after the first iteration of the last run (needs
+    // -DKMEANS_ALLOC_HOOK, includes what the transport allocates on that thread; simulated ranks
+    // do not see each other's allocations)
+    [[nodiscard]] long long getSteadyStateAllocations() const { return steadyStateAllocations; }
+
+    [[nodiscard]] KMeansModel getModel() const { return KMeansModel(centroids, result.clusterSizes, trainingInfo); }
 };
\ No newline at end of file
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+// What to do with a centroid that received no points in the last assignment
+enum class EmptyClusterPolicy {
+    KEEP,            // leave it where it was (old behaviour, the cluster usually stays dead)
+    FARTHEST_POINT,  // move it to one of the points farthest from their centroid
+    LARGEST_SSE      // move it to the farthest member of the cluster with the largest SSE
+};
+
+struct ReseedCandidate {
+    double dist;    // squared distance to the centroid the point was assigned to
+    int index;      // point index (local to the rank in the MPI engine)
+    int cluster;
+};
+
+// Collects reseeding candidates inside the assignment loop, so no extra data pass is needed.
+// One instance per thread, merged afterwards like the other thread-local accumulators.
+class ReseedTracker {
+private:
+    EmptyClusterPolicy policy = EmptyClusterPolicy::KEEP;
+    size_t capacity = 0;
+    std::vector<ReseedCandidate> top;       // heap with the last candidate in front (FARTHEST_POINT)
+    std::vector<ReseedCandidate> farthest;  // farthest member per cluster (LARGEST_SSE)
+
+    // Farther first, the lower index among equal distances, so the kept candidates do not depend
+    // on how the points were split between the trackers
+    static bool ahead(const ReseedCandidate& a, const ReseedCandidate& b) {
+        return a.dist != b.dist ? a.dist > b.dist : a.index < b.index;
+    }
+
+public:
+    // Upper bound on tracked FARTHEST_POINT candidates (and so on clusters reseeded per iteration)
+    static constexpr int MAX_CANDIDATES = 64;
+
+    void reset(EmptyClusterPolicy newPolicy, int k);
+    [[nodiscard]] bool active() const { return policy != EmptyClusterPolicy::KEEP; }
+
+    // Called for every assigned point
+    void observe(double dist, int index, int cluster) {
+        const ReseedCandidate candidate = {dist, index, cluster};
+        if (policy == EmptyClusterPolicy::FARTHEST_POINT) {
+            if (top.size() < capacity) {
+                top.push_back(candidate);
+                std::push_heap(top.begin(), top.end(), ahead);
+            } else if (ahead(candidate, top.front())) {
+                std::pop_heap(top.begin(), top.end(), ahead);
+                top.back() = candidate;
+                std::push_heap(top.begin(), top.end(), ahead);
+            }
+        } else if (policy == EmptyClusterPolicy::LARGEST_SSE) {
+            if (farthest[cluster].index < 0 || ahead(candidate, farthest[cluster])) farthest[cluster] = candidate;
+        }
+    }
+
+    void merge(const ReseedTracker& other);
+
+    // Pairs (empty cluster, point index) for the clusters that can be reseeded
+    [[nodiscard]] std::vector<std::pair<int, int>> choose(const std::vector<int>& emptyClusters,
+                                                          const std::vector<double>& clusterSSE) const;
+
+    // FARTHEST_POINT candidates, farthest first
+    [[nodiscard]] std::vector<ReseedCandidate> sortedCandidates() const;
+    // LARGEST_SSE candidates, one per cluster (index -1 when the cluster had no points)
+    [[nodiscard]] const std::vector<ReseedCandidate>& clusterFarthest() const { return farthest; }
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "thread_pool.h"
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <omp.h>
+
+enum class ExecutionBackend {
+    OPENMP,       // worksharing loop, threads forked for every phase
+    THREAD_POOL   // persistent WorkStealingPool, started once per run
+};
+
+// Runs chunked loops on the selected backend. Loop bodies get (begin, end, worker),
+// so per-worker accumulators indexed by `worker` work the same with both backends.
+class Executor {
+private:
+    ExecutionBackend backend = ExecutionBackend::OPENMP;
+    std::unique_ptr<WorkStealingPool> pool;
+
+public:
+    // Creates the pool (or re-creates it when the thread count changed)
+    void configure(ExecutionBackend newBackend);
+    [[nodiscard]] ExecutionBackend getBackend() const { return backend; }
+    [[nodiscard]] int numWorkers() const;
+    [[nodiscard]] long long getStolenChunks() const { return pool ? pool->getStolenChunks() : 0; }
+
+    // Items per chunk so that one chunk of data fills about half of the L2 cache
+    static long long chunkForL2(size_t bytesPerItem);
+
+    template <typename Fn>
+    void parallelFor(long long n, long long chunk, Fn&& fn) {
+        if (backend == ExecutionBackend::THREAD_POOL && pool) {
+            pool->parallelFor(n, chunk, fn);
+            return;
+        }
+
+        const long long numChunks = (n + chunk - 1) / chunk;
+        #pragma omp parallel for schedule(dynamic, 1)
+        for (long long c = 0; c < numChunks; ++c) {
+            fn(c * chunk, std::min(n, (c + 1) * chunk), omp_get_thread_num());
+        }
+    }
+};
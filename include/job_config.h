@@ -0,0 +1,88 @@
+#pragma once
+
+#include "aligned_memory.h"
+#include "data_loader.h"
+#include "distance_metrics.h"
+#include "distributed_kmeans.h"
+#include "empty_cluster.h"
+#include "executor.h"
+#include "label_writer.h"
+#include "sums_exchange.h"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Engines a job can run, named as the demo modes (seq, omp, bisect, mpi, plan)
+enum class JobEngine {
+    SEQUENTIAL,     // KMeans
+    OPENMP,         // ParallelKMeans
+    BISECTING,      // BisectingKMeans
+    DISTRIBUTED,    // DistributedKMeans over all ranks (mpirun, or --ranks N in-process)
+    PLANNED         // RunPlanner picks one of the above from a sample of the data
+};
+
+// Everything one job needs: where the data comes from, which engine runs with which
+// parameters, and what is written afterwards. Several values of k and seed make a sweep,
+// one run per (k, seed) pair, each repeated `repeat` times on the same data.
+//
+// Set from "--key value" (or --key=value) command-line options and from config files of
+// "key = value" lines ('#' starts a comment); "--config file" reads a file at that point,
+// so later options override it. Defaults: 5M uniform points in [0, 1000]^3, k = 10, 150 iterations.
+struct JobConfig {
+    // Data: a CSV file (one point per row, see DataLoader::loadFromCSV), the generator otherwise
+    std::string input;
+    GeneratorSpec generator;
+    long long numPoints = 5000000;
+
+    JobEngine engine = JobEngine::OPENMP;
+    std::vector<int> ks = {10};
+    std::vector<uint64_t> seeds = {0};      // initial centroids drawn from the data, 0 = random
+    int maxIter = 150;
+    double threshold = 1e-4;                // stop when no centroid moves further (squared)
+    int repeat = 1;
+
+    int threads = 0;                        // OpenMP threads per rank, 0 = runtime default
+    ExecutionBackend backend = ExecutionBackend::OPENMP;
+    DistanceMetric metric = DistanceMetric::SQUARED_EUCLIDEAN;
+    EmptyClusterPolicy emptyPolicy = EmptyClusterPolicy::FARTHEST_POINT;
+    CommCompression compression = CommCompression::NONE;   // precision of the distributed sums exchange
+    int staleness = 0;
+    bool normCache = true;
+    bool reorder = false;
+    bool packedCoords = false;              // OpenMP engine, see ParallelKMeans::setPackedCoords
+    bool reproducible = false;              // OpenMP and distributed engines, bit-identical for any thread/rank count
+    HugePages hugePages = HugePages::TRANSPARENT;   // large blocks, the Point array included
+    int silhouetteSample = 0;
+
+    // Outputs, empty = not written. "{k}", "{seed}" and "{repeat}" in a path are replaced, so
+    // the runs of a sweep do not overwrite each other
+    std::string modelPath;
+    std::string labelsPath;
+    LabelFormat labelFormat = LabelFormat::CSV;
+    LabelOutputMode labelMode = LabelOutputMode::GATHER;   // distributed engine only
+    bool labelDistances = false;
+    std::string summaryPath;                // one CSV row per run, appended (header on a new file)
+    bool profile = false;                   // phase times, traffic and reduction waits per run
+    bool quiet = false;                     // no progress output from the engines
+
+    // Returns false with a message in `error` on an unknown key or a bad value
+    bool set(const std::string& key, const std::string& value, std::string& error);
+    // "config = file" lines read further files, at most MAX_CONFIG_DEPTH deep and without cycles
+    bool loadFile(const std::string& filename, std::string& error);
+    // Options from argv[first] on. The transport options read by main (--ranks, --latency-us,
+    // --bandwidth-gbs, --jitter-us) are skipped
+    bool parseArgs(int argc, char* argv[], int first, std::string& error);
+    // Combinations the engines do not support
+    [[nodiscard]] bool validate(std::string& error) const;
+
+    void print(std::ostream& out) const;
+    static void printUsage(std::ostream& out);
+    static const char* engineName(JobEngine engine);
+
+    static constexpr size_t MAX_CONFIG_DEPTH = 16;
+
+private:
+    std::vector<std::string> openConfigs;   // files being read, a file that includes itself is an error
+    bool readFile(const std::string& filename, std::string& error);
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "job_config.h"
+#include "kmeans_model.h"
+#include "transport.h"
+#include "utils.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Runs a JobConfig without any interaction: loads or generates the data on rank 0, runs every
+// (k, seed) pair `repeat` times on the configured engine, prints one timing line per run and
+// writes the requested outputs. Collective over the transport; the single-process engines run
+// on rank 0 while the other ranks wait, the distributed engine scatters the data over all ranks.
+class JobRunner {
+private:
+    JobConfig config;
+    Transport& world;
+    Dataset data;           // rank 0 only
+    long long numPoints = 0;
+    int dim = 0;
+
+    // Rank 0: reads the input or runs the generator, false if there is no usable data
+    bool loadData();
+    // k distinct data points drawn with the seed, empty for seed 0 (the engine's own random pick)
+    [[nodiscard]] std::vector<Point> initialCentroids(int k, uint64_t seed) const;
+    // One run and its outputs, false if an output could not be written
+    bool runOnce(int k, uint64_t seed, int repeatIndex);
+    // Single-process engines (rank 0): labels and distances of `data` for the centroids
+    bool writeLabels(const std::string& path, const std::vector<Point>& centroids) const;
+    bool appendSummary(JobEngine engine, int k, uint64_t seed, int repeatIndex, int threads,
+                       const KMeansResult& result, double wall, double cpu) const;
+    [[nodiscard]] static std::string expandPath(std::string path, int k, uint64_t seed, int repeatIndex);
+
+public:
+    JobRunner(const JobConfig& config, Transport& world);
+
+    // Collective. 0 on success, 1 if the data could not be loaded or an output failed
+    int run();
+};
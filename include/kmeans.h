@@ -1,6 +1,12 @@
 #pragma once
 
 #include "utils.h"
+#include "kmeans_model.h"
+#include "centroid_kdtree.h"
+#include "cluster_metrics.h"
+#include "empty_cluster.h"
+#include "distance_metrics.h"
+#include "kmeans_workspace.h"
 #include <vector>
 
 class KMeans {
@@ -13,13 +19,35 @@ private:
     double totalUpdateTime = 0.0;
 
     std::vector<Point> centroids;
+    std::vector<Point> initialCentroids; // empty -> random initialization
+    KMeansResult result;            // metrics of the last run, filled during the passes
+    ModelMetadata trainingInfo;
+    int silhouetteSample = 0;       // 0 disables the sampled silhouette
+    CentroidKDTree centroidTree; // used instead of the brute-force scan for low dim / large k
+    EmptyClusterPolicy emptyPolicy = EmptyClusterPolicy::FARTHEST_POINT;
+    DistanceMetric metric = DistanceMetric::SQUARED_EUCLIDEAN;
+    ReseedTracker reseedTracker;
+    KMeansWorkspace workspace;      // per-run scratch, no allocations after the first iteration
+    long long steadyStateAllocations = 0;
 
     void initializeCentroids(const Dataset& data);
     void assignClusters(Dataset& data);
+    template <class Metric> void assignWith(Dataset& data);
     bool updateCentroids(const Dataset& data);
 public:
     KMeans(int k, int maxIter = 100, double threshold = 1e-4);
 
-    int run(Dataset& data);
+    KMeansResult run(Dataset& data);
     [[nodiscard]] const std::vector<Point>& getCentroids() const {return centroids;}
+    // Sampled silhouette estimate after the run (O(sampleSize^2 * dim)), 0 disables it
+    void setSilhouetteSample(int sampleSize) { silhouetteSample = sampleSize; }
+    void setEmptyClusterPolicy(EmptyClusterPolicy policy) { emptyPolicy = policy; }
+    // COSINE keeps unit-length centroids (spherical k-means), MANHATTAN moves them to medians
+    void setDistanceMetric(DistanceMetric newMetric) { metric = newMetric; }
+    // Start from given centroids (e.g. a solution on a coreset) instead of random points
+    void setInitialCentroids(const std::vector<Point>& initial) { initialCentroids = initial; }
+    // Heap allocations after the first iteration of the last run (needs -DKMEANS_ALLOC_HOOK)
+    [[nodiscard]] long long getSteadyStateAllocations() const { return steadyStateAllocations; }
+
+    [[nodiscard]] KMeansModel getModel() const { return KMeansModel(centroids, result.clusterSizes, trainingInfo); }
 };
\ No newline at end of file
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "utils.h"
+#include "centroid_kdtree.h"
+#include "distance_metrics.h"
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+// Training information stored next to the centroids
+struct ModelMetadata {
+    int64_t numPoints = 0;
+    int32_t iterations = 0;
+    double inertia = 0.0;   // 0 when the engine did not report it
+    int64_t trainedAt = 0;  // unix time (seconds)
+    DistanceMetric metric = DistanceMetric::SQUARED_EUCLIDEAN;
+};
+
+// On-disk layout (version 1). Every section starts at a 64-byte aligned offset,
+// so a mapped file is used in place with no parsing:
+//   [header][centroids: k * dim double][norms: k double][counts: k int64]
+struct ModelFileHeader {
+    char magic[8];          // "KMHPCMDL"
+    uint32_t version;
+    uint32_t dtype;         // MODEL_DTYPE_FLOAT64
+    int32_t k;
+    int32_t dim;
+    int64_t numPoints;
+    int32_t iterations;
+    int32_t metric;         // DistanceMetric (0, squared euclidean, in files written before it existed)
+    double inertia;
+    int64_t trainedAt;
+    uint64_t centroidsOffset;
+    uint64_t normsOffset;
+    uint64_t countsOffset;
+    uint64_t fileSize;
+    char padding[40];
+};
+static_assert(sizeof(ModelFileHeader) == 128, "Model header must stay 128 bytes");
+
+constexpr uint32_t MODEL_FILE_VERSION = 1;
+constexpr uint32_t MODEL_DTYPE_FLOAT64 = 1;
+
+// Trained model used for scoring new points against fixed centroids.
+// All data lives in one immutable buffer with the file layout: a heap block when built
+// from an engine, or a read-only mapping of the model file. Copies share the buffer.
+class KMeansModel {
+private:
+    int k = 0;
+    int dim = 0;
+    std::shared_ptr<const void> backing;
+    const ModelFileHeader* header = nullptr;
+    const double* centroids = nullptr;  // k * dim, row-major
+    const double* norms = nullptr;      // ||c||^2 per centroid
+    const int64_t* counts = nullptr;    // training points per cluster
+    CentroidKDTree centroidTree; // built only when CentroidKDTree::isBeneficial(k, dim)
+    bool useTree = false;
+    DistanceMetric metric = DistanceMetric::SQUARED_EUCLIDEAN;
+
+    void attach(std::shared_ptr<const void> buffer);
+    int nearest(const double* point, double& dist) const;
+
+public:
+    // Batches smaller than this are scored on the calling thread (no OpenMP fork/join)
+    static constexpr size_t PARALLEL_BATCH_THRESHOLD = 4096;
+
+    KMeansModel() = default;
+    explicit KMeansModel(const std::vector<Point>& trainedCentroids,
+                         const std::vector<long long>& clusterCounts = {},
+                         const ModelMetadata& metadata = {});
+
+    // Writes the versioned binary model file
+    bool save(const std::string& filename) const;
+    // Maps the model file read-only (one mmap, no parsing) and replaces the current model
+    bool load(const std::string& filename);
+
+    // Scores n contiguous points (n * dim doubles, row-major).
+    // labels must hold n entries, distances is optional (metric distance to the chosen centroid).
+    // Output buffers are owned by the caller, so a call performs no allocation.
+    void predict(const double* points, size_t n, int* labels, double* distances = nullptr) const;
+    // Single point, low-latency path
+    int predictOne(const double* point, double* distance = nullptr) const;
+    // Writes Point::clusterId for every point of the dataset
+    void assign(Dataset& data) const;
+
+    [[nodiscard]] int getK() const { return k; }
+    [[nodiscard]] int getDim() const { return dim; }
+    [[nodiscard]] DistanceMetric getMetric() const { return metric; }
+    [[nodiscard]] const double* getCentroidData() const { return centroids; }
+    [[nodiscard]] const double* getCentroidNorms() const { return norms; }
+    [[nodiscard]] const int64_t* getClusterCounts() const { return counts; }
+    [[nodiscard]] ModelMetadata getMetadata() const;
+    [[nodiscard]] bool empty() const { return k == 0; }
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "utils.h"
+#include "aligned_memory.h"
+#include "empty_cluster.h"
+#include <vector>
+
+// Scratch memory of one run, sized once in run() and reused by every iteration,
+// so the steady-state loop makes no heap allocations.
+// Each worker (thread, or the rank itself in the MPI engine) owns one accumulator row of
+// k * dim weighted coordinate sums, k SSE values and k weight totals, plus k point counts.
+// Keeping everything in one row lets the MPI engine reduce it with a single Allreduce.
+// Worker rows start on their own cache line, so neighbouring workers never share one.
+// With folds > 1 every value of the row is a ReproducibleSum accumulator of that many doubles.
+class KMeansWorkspace {
+private:
+    int k = 0;
+    int dim = 0;
+    int workers = 0;
+    int folds = 1;
+    AlignedVector<double> rows;     // workers * rowStride()
+    AlignedVector<int> counts;      // workers * countStride()
+
+    [[nodiscard]] size_t rowStride() const { return roundToLine<double>(rowSize()); }
+    [[nodiscard]] size_t countStride() const { return roundToLine<int>(k); }
+    template <class T>
+    static size_t roundToLine(size_t n) {
+        const size_t perLine = AlignedMemory::ALIGNMENT / sizeof(T);
+        return (n + perLine - 1) / perLine * perLine;
+    }
+
+public:
+    std::vector<Point> nextCentroids;   // back buffer, swapped with the engine's centroids
+    std::vector<ReseedTracker> trackers; // one per worker
+    std::vector<int> emptyClusters;     // capacity k
+    std::vector<double> reducedRow;     // rowSize(), merged or globally reduced row
+    std::vector<int> reducedCounts;     // k
+
+    // Allocates everything, later calls with the same shape reuse the buffers
+    void prepare(int numWorkers, int numClusters, int numDim, EmptyClusterPolicy policy, int sumFolds = 1);
+
+    [[nodiscard]] int rowSize() const { return folds * (k * dim + 2 * k); }
+    [[nodiscard]] int numWorkers() const { return workers; }
+    [[nodiscard]] int sumFolds() const { return folds; }
+    double* sums(int worker) { return rows.data() + worker * rowStride(); }
+    double* sse(int worker) { return sums(worker) + static_cast<size_t>(folds) * k * dim; }
+    double* weights(int worker) { return sse(worker) + static_cast<size_t>(folds) * k; }
+    int* workerCounts(int worker) { return counts.data() + worker * countStride(); }
+
+    // Zero the SSE and reset the trackers before an assignment pass
+    void resetAssignment(EmptyClusterPolicy policy);
+    // Zero the sums, weights and counts before an accumulation pass
+    void resetSums();
+    // Sums every worker row (in worker order) into reducedRow/reducedCounts
+    void reduceWorkers();
+    // Folded rows: turns reducedRow into plain values in place (k * dim sums, k SSE, k weights)
+    void collapseReduced();
+    // The new centroids become current, the old ones are the next back buffer
+    void swapCentroids(std::vector<Point>& centroids) { centroids.swap(nextCentroids); }
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "utils.h"
+#include "distance_metrics.h"
+#include <cstdint>
+#include <future>
+#include <string>
+#include <vector>
+
+enum class LabelFormat {
+    BINARY,  // LabelFileHeader, int32 labels, then (8-byte aligned) float64 distances
+    CSV      // "index,label[,distance]" rows
+};
+
+// Binary label file. Shards written per rank carry their own header, firstIndex tells
+// where the shard starts in the full dataset.
+struct LabelFileHeader {
+    char magic[8];          // "KMLABELS"
+    uint32_t version;
+    uint32_t flags;         // LABEL_FLAG_DISTANCES
+    int64_t numPoints;      // points in this file
+    int64_t firstIndex;     // global index of the first point
+    uint64_t distancesOffset; // 0 when there are no distances
+    char padding[24];
+};
+static_assert(sizeof(LabelFileHeader) == 64, "Label header must stay 64 bytes");
+
+constexpr uint32_t LABEL_FILE_VERSION = 1;
+constexpr uint32_t LABEL_FLAG_DISTANCES = 1;
+
+// Writes cluster assignments after a run. distances are optional everywhere (nullptr / empty).
+class LabelWriter {
+public:
+    // Header of a binary file holding n labels (and distances)
+    static LabelFileHeader makeHeader(long long n, long long firstIndex, bool withDistances);
+    // Formats the CSV rows in parallel (one text block per thread, joined in order)
+    static std::string formatCSV(const int* labels, const double* distances, size_t n,
+                                 long long firstIndex, bool withHeader);
+
+    static bool write(const std::string& filename, LabelFormat format, const int* labels,
+                      const double* distances, size_t n, long long firstIndex = 0);
+    // Same as write() on a background thread, so it overlaps whatever the caller does next
+    // (e.g. loading the next job). The buffers are moved into the task.
+    static std::future<bool> writeAsync(std::string filename, LabelFormat format, std::vector<int> labels,
+                                        std::vector<double> distances, long long firstIndex = 0);
+
+    // Labels of a dataset after run(), distances are the metric distances to the final centroids
+    // (squared for the default metric)
+    static void extract(const Dataset& data, const std::vector<Point>& centroids,
+                        std::vector<int>& labels, std::vector<double>* distances = nullptr,
+                        DistanceMetric metric = DistanceMetric::SQUARED_EUCLIDEAN);
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "transport.h"
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <vector>
+
+// Cost model of the simulated network, charged to every rank after each collective
+struct LocalLatency {
+    double latencyUs = 0.0;     // per collective call
+    double bandwidthGBs = 0.0;  // per byte this rank sends or receives, 0 = free
+    double jitterUs = 0.0;      // random extra delay of the calling rank per call (exponential, this
+                                // mean): noise and stragglers, which bulk-synchronous loops wait for
+};
+
+// State shared by the simulated ranks of one run: a reusable barrier and one published
+// buffer pointer per rank. Collectives read the other ranks' buffers directly.
+// Non-blocking reductions are copied in on start and reduced by the last rank to arrive.
+class LocalCluster {
+private:
+    std::mutex mutex;
+    std::condition_variable released;
+    int arrived = 0;
+    long long generation = 0;
+
+    struct PendingReduction {
+        std::vector<std::vector<char>> contributions; // per rank, reduced in rank order
+        std::vector<char> result;
+        int arrived = 0;
+        int collected = 0;
+        bool done = false;
+        double readyAt = 0.0;   // simulated arrival of the result, latest start plus the cost
+    };
+    std::map<long long, PendingReduction> pending;  // by sequence number
+    std::condition_variable reduced;
+
+public:
+    const int size;
+    LocalLatency latency;
+    std::vector<const void*> published;
+    std::vector<const int*> publishedCounts;
+    std::vector<const int*> publishedDispls;
+    std::vector<int> failed;
+
+    LocalCluster(int numRanks, const LocalLatency& cost);
+    void barrier();
+    void startReduction(long long sequence, int rank, const void* data, int count, CommDatatype type, CommOp op,
+                        double readyAt);
+    // Copies the result once every rank has started it and readyAt has passed. Blocking waits
+    // until then, otherwise returns false if the result is not there yet
+    bool collectReduction(long long sequence, void* recv, bool blocking);
+};
+
+// One simulated rank. Collectives are shared-memory copies between the rank threads,
+// reductions run in rank order so every rank gets the same bits.
+class LocalTransport : public Transport {
+private:
+    std::shared_ptr<LocalCluster> cluster;
+    int localRank;
+    std::vector<char> scratch;  // reduction result, reused between calls
+    struct Request {
+        long long sequence = -1;    // -1: free handle
+        void* recv = nullptr;
+    };
+    std::vector<Request> requests;
+    long long nextSequence = 0;     // non-blocking collectives started by this rank
+    std::mt19937_64 jitter;
+
+    // Sleeps for the simulated cost of a collective moving `bytes`, plus this rank's jitter
+    void charge(size_t bytes);
+    [[nodiscard]] double costUs(size_t bytes) const;
+    double drawJitterUs();
+
+public:
+    LocalTransport(std::shared_ptr<LocalCluster> cluster, int rank);
+
+    // Runs body on numRanks threads, each with its own rank; OpenMP threads are split between them
+    static void launch(int numRanks, const LocalLatency& latency, const std::function<void(Transport&)>& body);
+
+    [[nodiscard]] int rank() const override { return localRank; }
+    [[nodiscard]] int size() const override { return cluster->size; }
+    [[nodiscard]] double wtime() const override;
+
+    void barrier() override;
+    void bcast(void* data, int count, CommDatatype type, int root) override;
+    void allreduce(void* data, int count, CommDatatype type, CommOp op) override;
+    CommRequest iallreduce(const void* send, void* recv, int count, CommDatatype type, CommOp op) override;
+    bool test(CommRequest request) override;
+    void wait(CommRequest request) override;
+    void allgather(const void* send, int count, CommDatatype type, void* recv) override;
+    void gatherv(const void* send, int count, CommDatatype type,
+                 void* recv, const int* counts, const int* displs, int root) override;
+    void scatterv(const void* send, const int* counts, const int* displs, CommDatatype type,
+                  void* recv, int count, int root) override;
+    bool writeShared(const std::string& filename, const std::vector<FileBlock>& blocks) override;
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#ifdef USE_MPI
+
+#include "transport.h"
+#include <mpi.h>
+#include <vector>
+
+// Transport over an MPI communicator (MPI must be initialized by the caller)
+class MpiTransport : public Transport {
+private:
+    MPI_Comm comm;
+    int worldRank = 0;
+    int worldSize = 1;
+    std::vector<MPI_Request> requests; // CommRequest -> MPI request, MPI_REQUEST_NULL when free
+
+public:
+    explicit MpiTransport(MPI_Comm comm = MPI_COMM_WORLD);
+
+    [[nodiscard]] int rank() const override { return worldRank; }
+    [[nodiscard]] int size() const override { return worldSize; }
+    [[nodiscard]] double wtime() const override { return MPI_Wtime(); }
+
+    void barrier() override;
+    void bcast(void* data, int count, CommDatatype type, int root) override;
+    void allreduce(void* data, int count, CommDatatype type, CommOp op) override;
+    CommRequest iallreduce(const void* send, void* recv, int count, CommDatatype type, CommOp op) override;
+    bool test(CommRequest request) override;
+    void wait(CommRequest request) override;
+    void allgather(const void* send, int count, CommDatatype type, void* recv) override;
+    void gatherv(const void* send, int count, CommDatatype type,
+                 void* recv, const int* counts, const int* displs, int root) override;
+    void scatterv(const void* send, const int* counts, const int* displs, CommDatatype type,
+                  void* recv, int count, int root) override;
+    // MPI-IO, collective writes at the block offsets
+    bool writeShared(const std::string& filename, const std::vector<FileBlock>& blocks) override;
+
+    // For MPI-only features (shared-memory windows in NodeReducer)
+    [[nodiscard]] MPI_Comm communicator() const { return comm; }
+};
+
+#endif
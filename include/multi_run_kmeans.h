@@ -0,0 +1,62 @@
+#pragma once
+
+#include "utils.h"
+#include "kmeans_model.h"
+#include <vector>
+
+// Result of one independent centroid set
+struct RunSummary {
+    int k = 0;
+    int restart = 0;
+    int iterations = 0;
+    double inertia = 0.0;   // sum of squared distances for the final centroids
+    std::vector<Point> centroids;
+};
+
+// Runs nInit restarts for every k in ks at once. Each iteration streams the dataset
+// tile by tile and every active centroid set is evaluated against the tile while it is
+// still in cache, so memory bandwidth is paid once per iteration instead of once per run.
+// The dataset is read only: no per-run copies and Point::clusterId is left untouched.
+class MultiRunKMeans {
+private:
+    // Points per tile, small enough to stay in L1/L2 while all runs visit it
+    static constexpr int TILE_POINTS = 256;
+
+    struct RunState {
+        int k;
+        int restart;
+        int iterations = 0;
+        bool converged = false;
+        double inertia = 0.0;
+        std::vector<double> centroids; // k * dim
+        size_t offset;                 // start of this run in the per-thread accumulators
+    };
+
+    std::vector<int> ks;
+    int nInit;
+    int maxIter;
+    double threshold;
+    unsigned int seed;
+
+    std::vector<RunState> runs;
+    std::vector<RunSummary> bestRuns;
+
+    void initializeRuns(const std::vector<double>& flat, size_t n, int dim);
+    // One shared pass over the data: sums/weights/inertia of every active run.
+    // pointWeights is empty for unweighted data
+    void accumulate(const std::vector<double>& flat, const std::vector<double>& pointWeights, size_t n, int dim,
+                    bool finalPass, std::vector<double>& sums, std::vector<double>& weights);
+
+public:
+    // seed == 0 draws a random seed, any other value makes the initial centroids reproducible
+    MultiRunKMeans(const std::vector<int>& ks, int nInit, int maxIter = 100, double threshold = 1e-4,
+                   unsigned int seed = 0);
+
+    // Returns the number of shared data passes
+    int run(const Dataset& data);
+
+    // Lowest-inertia restart for every k, in the order of ks
+    [[nodiscard]] const std::vector<RunSummary>& getBestRuns() const { return bestRuns; }
+    // Every run, in (k, restart) order
+    [[nodiscard]] std::vector<RunSummary> getAllRuns() const;
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "transport.h"
+#include <cstddef>
+#ifdef USE_MPI
+#include <mpi.h>
+#endif
+
+// Two-level sum reduction for several ranks per node. Ranks of a node write their partial
+// results into an MPI-3 shared-memory window and reduce them there (each rank sums one slice
+// of the elements), only one leader per node takes part in the network Allreduce, and the
+// result is read back from the window. Inter-node traffic scales with nodes, not ranks.
+// Needs an MpiTransport; over any other transport it is never ready and sums are plain allreduces.
+class NodeReducer {
+private:
+    Transport* transport = nullptr;        // given to prepare(), used when the window is missing or too small
+#ifdef USE_MPI
+    MPI_Comm nodeComm = MPI_COMM_NULL;
+    MPI_Comm leaderComm = MPI_COMM_NULL;   // node leaders only, MPI_COMM_NULL elsewhere
+    MPI_Win window = MPI_WIN_NULL;
+#endif
+    int nodeRank = 0;
+    int nodeSize = 1;
+    int numNodes = 1;
+    int split = -1;                        // ranksPerNode of the current window
+    size_t slotBytes = 0;                  // per-rank slot; the reduced result has one more slot
+    char* slots = nullptr;                 // nodeSize + 1 slots, node rank order
+    long long networkBytes = 0;            // bytes this rank sent in leader Allreduces
+
+    template <class T> void sumInPlace(T* data, int count);
+
+public:
+    NodeReducer() = default;
+    NodeReducer(const NodeReducer&) = delete;
+    NodeReducer& operator=(const NodeReducer&) = delete;
+    ~NodeReducer();
+
+    // Collective over the transport. ranksPerNode > 0 groups consecutive ranks into simulated nodes
+    // (for testing on one machine), 0 uses MPI_COMM_TYPE_SHARED. Reuses the window when it is
+    // already large enough for maxBytes per call
+    void prepare(Transport& transport, size_t maxBytes, int ranksPerNode = 0);
+    void release();
+    [[nodiscard]] bool ready() const;
+
+    // In-place global sums, collective over the transport given to prepare()
+    void sum(double* data, int count);
+    void sum(float* data, int count);
+    void sum(int* data, int count);
+
+    [[nodiscard]] int getNumNodes() const { return numNodes; }
+    [[nodiscard]] int getNodeSize() const { return nodeSize; }
+    [[nodiscard]] long long getNetworkBytes() const { return networkBytes; }
+    void resetNetworkBytes() { networkBytes = 0; }
+};
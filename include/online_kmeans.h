@@ -0,0 +1,51 @@
+#pragma once
+
+#include "kmeans_model.h"
+#include "centroid_kdtree.h"
+#include <vector>
+#include <cstddef>
+
+// Online (mini-batch) k-means started from a trained model.
+// Every batch is assigned against the current centroids and then folded in:
+//   n_j <- decay^m * n_j + m_j,   c_j <- (decay^m * n_j_old * c_j + sum_j) / n_j
+// where m is the batch size and m_j / sum_j are the batch count / sum of cluster j.
+// decay is a per-point factor derived from a half-life, so old data fades at the same
+// rate whatever the batch sizes are. Counts start from the training counts of the model.
+// Points are assigned under the model's metric. COSINE centroids are normalized after every
+// update (spherical k-means); MANHATTAN centroids are not updated, there is no running median.
+class OnlineKMeans {
+private:
+    int k = 0;
+    int dim = 0;
+    DistanceMetric metric = DistanceMetric::SQUARED_EUCLIDEAN;
+    double decay = 1.0;                 // per point, 1.0 keeps everything
+    std::vector<double> centroids;      // k * dim
+    std::vector<double> counts;         // decayed point counts
+    std::vector<double> batchSums;      // scratch, k * dim
+    std::vector<double> batchCounts;    // scratch, k
+    long long pointsSeen = 0;
+    ModelMetadata metadata;
+    CentroidKDTree centroidTree;
+    bool useTree = false;
+
+public:
+    // Batches smaller than this are assigned on the calling thread
+    static constexpr size_t PARALLEL_BATCH_THRESHOLD = 4096;
+
+    // halfLife in points, 0 disables the decay
+    explicit OnlineKMeans(const KMeansModel& model, double halfLife = 0.0);
+
+    // Whether processBatch updates the centroids under this metric (everything but MANHATTAN)
+    [[nodiscard]] static bool updatesCentroids(DistanceMetric metric) { return metric != DistanceMetric::MANHATTAN; }
+
+    // Assigns n contiguous points (labels must hold n entries) and updates the centroids
+    void processBatch(const double* points, size_t n, int* labels);
+    // Current state as a model (copy), e.g. to publish it
+    [[nodiscard]] KMeansModel snapshot() const;
+
+    [[nodiscard]] int getK() const { return k; }
+    [[nodiscard]] int getDim() const { return dim; }
+    [[nodiscard]] DistanceMetric getMetric() const { return metric; }
+    [[nodiscard]] long long getPointsSeen() const { return pointsSeen; }
+    [[nodiscard]] const std::vector<double>& getCentroids() const { return centroids; }
+};
@@ -1,6 +1,15 @@
 #pragma once
 
 #include "utils.h"
+#include "kmeans_model.h"
+#include "centroid_kdtree.h"
+#include "cluster_metrics.h"
+#include "empty_cluster.h"
+#include "distance_metrics.h"
+#include "executor.h"
+#include "kmeans_workspace.h"
+#include "reproducible_sum.h"
+#include "sparse_dataset.h"
 #include <vector>
 
 class ParallelKMeans {
@@ -13,15 +22,97 @@ private:
     double totalUpdateTime = 0.0;
 
     std::vector<Point> centroids;
+    std::vector<Point> initialCentroids; // empty -> random initialization
+    KMeansResult result;            // metrics of the last run, filled during the passes
+    ModelMetadata trainingInfo;
+    int silhouetteSample = 0;       // 0 disables the sampled silhouette
+    CentroidKDTree centroidTree; // used instead of the brute-force scan for low dim / large k
+    EmptyClusterPolicy emptyPolicy = EmptyClusterPolicy::FARTHEST_POINT;
+    DistanceMetric metric = DistanceMetric::SQUARED_EUCLIDEAN;
+    ReseedTracker reseedTracker;
+    ExecutionBackend backend = ExecutionBackend::OPENMP;
+    Executor executor;
+    long long chunkSize = 1024;     // points per scheduled chunk, sized from L2 in run()
+    KMeansWorkspace workspace;      // per-run scratch, no allocations after the first iteration
+    long long steadyStateAllocations = 0;
+    bool verbose = true;            // progress messages on stdout
+    bool reorder = false;
+    double reorderThreshold = 0.05; // fraction of n, see setReorder()
+    std::vector<size_t> originalIndex; // position -> caller's index, empty while in the caller's order
+    long long movedPoints = 0;      // label changes in the last assignment pass
+    long long labelRuns = 0;        // runs of equal labels seen by the last accumulation pass
+    int reorderCount = 0;
+    bool normCache = true;
+    std::vector<double> centroidRows;  // flat copy of the centroids for the norm-based scan
+    std::vector<double> centroidNorms; // ||c_j||^2, refreshed whenever the centroids change
+    bool packed = false;
+    AlignedVector<double> coordBlock;  // n * dim copy of the coordinates in the current order, empty when not packed
+    bool reproducible = false;
+    ReproducibleSum coordSum;       // w * x terms of the cluster sums
+    ReproducibleSum weightSum;
+    ReproducibleSum sseSum;         // w * distance terms
+    std::vector<double> foldedSSE;  // k accumulators, the worker SSE merged before collapsing
 
     void initializeCentroids(const Dataset& data);
     void assignClusters(Dataset& data);
+    template <class Metric> void assignWith(Dataset& data);
     bool updateCentroids(const Dataset& data);
+    void refreshCentroidNorms();
+    // Parallel counting sort of the points by cluster, coordinates are copied in the new order
+    void reorderByCluster(Dataset& data);
+    void restoreOrder(Dataset& data);
+    void packCoords(const Dataset& data);
+    // Bounds of the reproducible sums from the largest coordinate and weight
+    void configureSums(const Dataset& data);
 
 public:
     ParallelKMeans(int k, int maxIter = 100, double threshold = 1e-4);
 
-    int run(Dataset& data);
+    KMeansResult run(Dataset& data);
+    // CSR input, O(nnz * k) per iteration. Labels go to data.labels, centroids stay dense
+    KMeansResult run(SparseDataset& data);
     [[nodiscard]] const std::vector<Point>& getCentroids() const { return centroids; }
+    // Sampled silhouette estimate after the run (O(sampleSize^2 * dim)), 0 disables it
+    void setSilhouetteSample(int sampleSize) { silhouetteSample = sampleSize; }
+    void setEmptyClusterPolicy(EmptyClusterPolicy policy) { emptyPolicy = policy; }
+    // COSINE keeps unit-length centroids (spherical k-means), MANHATTAN moves them to medians
+    void setDistanceMetric(DistanceMetric newMetric) { metric = newMetric; }
+    // Start from given centroids (e.g. a solution on a coreset) instead of random points
+    void setInitialCentroids(const std::vector<Point>& initial) { initialCentroids = initial; }
+    // THREAD_POOL balances uneven per-point cost (k-d tree pruning) by work stealing
+    void setExecutionBackend(ExecutionBackend newBackend) { backend = newBackend; }
+    [[nodiscard]] long long getStolenChunks() const { return executor.getStolenChunks(); }
+    // Groups the points by cluster once the labels are stable (fewer than movedFraction * n
+    // changed) and the order is not (more than movedFraction * n label runs), so the update pass
+    // streams through one cluster after another. Runs again when the order decays; the caller's
+    // order is restored before run() returns. Needs a second copy of the data while sorting
+    void setReorder(bool enabled, double movedFraction = 0.05) {
+        reorder = enabled;
+        reorderThreshold = movedFraction;
+    }
+    [[nodiscard]] int getReorderCount() const { return reorderCount; }
+    // Squared euclidean scans use ||x||^2 + ||c||^2 - 2 x.c with the points' norms (recomputed
+    // at the start of run()) and the centroid norms of the last update. Same labels either way
+    void setNormCache(bool enabled) { normCache = enabled; }
+    // Streams the passes from one contiguous, 64-byte aligned copy of the coordinates instead of
+    // the per-point vectors, which malloc places on 4 KB pages wherever it likes. The copy is a
+    // large block, so it sits on huge pages as set by AlignedMemory::setHugePages. The per-point
+    // vectors are kept (tree, reseeding and medians read them), so coordinate memory doubles:
+    // n * dim more doubles for the duration of run()
+    void setPackedCoords(bool enabled) { packed = enabled; }
+    // Bit-identical centroids, SSE and inertia for any thread count, backend and chunk placement:
+    // every sum is a ReproducibleSum accumulator (three doubles per value, one extra pass over the
+    // data per run for the bounds). Ties between reseeding candidates go to the lower index. Dense data only
+    void setReproducible(bool enabled) { reproducible = enabled; }
+    // Silences the progress messages, e.g. for the many small runs of BisectingKMeans
+    void setVerbose(bool enabled) { verbose = enabled; }
+    // Phase timings of the last run in seconds
+    [[nodiscard]] double getInitTime() const { return initTime; }
+    [[nodiscard]] double getAssignTime() const { return totalAssignTime; }
+    [[nodiscard]] double getUpdateTime() const { return totalUpdateTime; }
+    // Heap allocations after the first iteration of the last run (needs -DKMEANS_ALLOC_HOOK)
+    [[nodiscard]] long long getSteadyStateAllocations() const { return steadyStateAllocations; }
+
+    [[nodiscard]] KMeansModel getModel() const { return KMeansModel(centroids, result.clusterSizes, trainingInfo); }
 };
 
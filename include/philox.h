@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+
+// Philox4x32-10 counter-based generator (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3").
+// The output is a pure function of (counter, key), so any point can be generated independently
+// of the others: results do not depend on how the work is split between threads or ranks.
+struct Philox4x32 {
+    uint32_t v[4];
+
+    static Philox4x32 generate(uint64_t counterLo, uint64_t counterHi, uint64_t key) {
+        uint32_t c0 = static_cast<uint32_t>(counterLo), c1 = static_cast<uint32_t>(counterLo >> 32);
+        uint32_t c2 = static_cast<uint32_t>(counterHi), c3 = static_cast<uint32_t>(counterHi >> 32);
+        uint32_t k0 = static_cast<uint32_t>(key), k1 = static_cast<uint32_t>(key >> 32);
+
+        for (int round = 0; round < 10; ++round) {
+            uint64_t p0 = static_cast<uint64_t>(0xD2511F53u) * c0;
+            uint64_t p1 = static_cast<uint64_t>(0xCD9E8D57u) * c2;
+            uint32_t n0 = static_cast<uint32_t>(p1 >> 32) ^ c1 ^ k0;
+            uint32_t n2 = static_cast<uint32_t>(p0 >> 32) ^ c3 ^ k1;
+            c1 = static_cast<uint32_t>(p1);
+            c3 = static_cast<uint32_t>(p0);
+            c0 = n0;
+            c2 = n2;
+            k0 += 0x9E3779B9u;
+            k1 += 0xBB67AE85u;
+        }
+        return {{c0, c1, c2, c3}};
+    }
+
+    //Uniform double in (0, 1)
+    static double toUniform(uint32_t x) { return (static_cast<double>(x) + 0.5) * (1.0 / 4294967296.0); }
+
+    // Two standard normals from two uniforms (Box-Muller)
+    static void toNormal(uint32_t a, uint32_t b, double& z0, double& z1) {
+        double r = std::sqrt(-2.0 * std::log(toUniform(a)));
+        double theta = 6.283185307179586 * toUniform(b);
+        z0 = r * std::cos(theta);
+        z1 = r * std::sin(theta);
+    }
+};
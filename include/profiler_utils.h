@@ -4,7 +4,15 @@
 #else
 #include <ctime>
 #endif
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 #include <iostream>
+#include <vector>
+#include <omp.h>
 
 class ResourceProfiler {
 public:
@@ -22,4 +30,66 @@ public:
         return (double)clock() / CLOCKS_PER_SEC;
 #endif
     }
-};
\ No newline at end of file
+};
+
+// Data-TLB load misses of the OpenMP team (perf_event_open, user space only). Every thread of
+// the team opens its own counter, so the worker threads must already exist (they are kept
+// between parallel regions) and the backend must be OPENMP. available() is false where the
+// counters cannot be opened: other systems, perf_event_paranoid > 2, VMs without a virtual PMU.
+class TlbMissCounter {
+private:
+    std::vector<int> fds;
+
+public:
+    TlbMissCounter() {
+#ifdef __linux__
+        fds.assign(omp_get_max_threads(), -1);
+        #pragma omp parallel
+        {
+            perf_event_attr attr{};
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                          | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            fds[omp_get_thread_num()] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        }
+#endif
+    }
+    ~TlbMissCounter() {
+#ifdef __linux__
+        for (int fd : fds) if (fd >= 0) close(fd);
+#endif
+    }
+    TlbMissCounter(const TlbMissCounter&) = delete;
+    TlbMissCounter& operator=(const TlbMissCounter&) = delete;
+
+    [[nodiscard]] bool available() const {
+        if (fds.empty()) return false;
+        for (int fd : fds) if (fd < 0) return false;
+        return true;
+    }
+    void start() {
+#ifdef __linux__
+        for (int fd : fds) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+    // Misses since start() summed over the team, -1 when unavailable
+    long long stop() {
+        if (!available()) return -1;
+        long long total = 0;
+#ifdef __linux__
+        for (int fd : fds) {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            long long value = 0;
+            if (read(fd, &value, sizeof(value)) == sizeof(value)) total += value;
+        }
+#endif
+        return total;
+    }
+};
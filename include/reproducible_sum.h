@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cmath>
+
+// Order-independent summation by pre-rounding (Demmel & Nguyen, "Fast reproducible floating-point
+// summation"). Every term is split against FOLDS fixed boundaries into parts that lie on fixed
+// grids, and sums of grid values are exact as long as no more than the configured number of terms
+// reach one sum. So any order and grouping of the terms, and of partial sums (per thread, per
+// rank, by an Allreduce), gives the same bits. Each fold keeps about 52 - log2(terms) bits, three
+// folds are more accurate than plain double summation for any realistic n.
+// An accumulator is FOLDS doubles starting at zero; accumulators are added element-wise.
+class ReproducibleSum {
+public:
+    static constexpr int FOLDS = 3;
+
+private:
+    double boundary[FOLDS] = {0.0, 0.0, 0.0};   // 1.5 * 2^(e_f + L), grid of fold f is 2^(e_f + L - 52)
+
+public:
+    // Every term is at most maxAbs in magnitude and at most maxTerms terms reach one sum
+    void configure(double maxAbs, long long maxTerms) {
+        // 2^e > maxAbs; L bits of headroom so that maxTerms terms cannot leave the binade
+        int e = maxAbs > 0.0 ? std::ilogb(maxAbs) + 1 : -900;
+        const int headroom = static_cast<int>(std::ceil(std::log2(static_cast<double>(maxTerms > 1 ? maxTerms : 1)))) + 1;
+        for (int f = 0; f < FOLDS; ++f) {
+            boundary[f] = std::ldexp(1.5, e + headroom);
+            // The remainder of fold f is at most half its grid
+            e += headroom - 53;
+        }
+    }
+
+    void deposit(double* acc, double x) const {
+        for (int f = 0; f < FOLDS; ++f) {
+            const double q = (boundary[f] + x) - boundary[f];
+            acc[f] += q;
+            x -= q;
+        }
+    }
+
+    // Smallest fold first
+    static double value(const double* acc) {
+        double v = acc[FOLDS - 1];
+        for (int f = FOLDS - 2; f >= 0; --f) v += acc[f];
+        return v;
+    }
+};
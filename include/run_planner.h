@@ -0,0 +1,76 @@
+#pragma once
+
+#include "utils.h"
+#include "sums_exchange.h"
+#include "transport.h"
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Engines the planner can recommend
+enum class PlannedEngine {
+    OPENMP,         // ParallelKMeans (also on one thread, it is faster than KMeans there)
+    BISECTING,      // BisectingKMeans, approximate but far cheaper for very large k
+    DISTRIBUTED     // DistributedKMeans
+};
+
+// Estimate of a run from a sample, with the recommended setup
+struct RunPlan {
+    long long numPoints = 0;
+    int dim = 0;
+    int k = 0;
+    long long sampleSize = 0;
+    int sampleIterations = 0;
+    int quarterIterations = 0;          // same run on every fourth sample point
+    bool sampleConverged = false;       // both runs
+
+    // Measured on the sample, per point and pass, with all threads of this process
+    double assignSecondsPerPoint = 0.0;
+    double updateSecondsPerPoint = 0.0;
+    double threadSpeedup = 1.0;         // all threads vs one thread
+    double reduceSeconds = 0.0;         // one Allreduce of the sums row over all ranks, 0 on one rank
+
+    PlannedEngine engine = PlannedEngine::OPENMP;
+    int threads = 1;                    // per rank, 1 when more threads did not pay off
+    int ranks = 1;
+    CommCompression compression = CommCompression::NONE;   // precision of the sums exchange
+    int predictedIterations = 0;
+    double predictedSeconds = 0.0;      // main loop of the recommended setup (flat k-means for BISECTING)
+    std::string reason;
+
+    void print(std::ostream& out) const;
+};
+
+// Planning stage before a long run: the flat engine runs to convergence on a stratified sample
+// of the data, which gives the iteration count and the per-point cost of both passes on this
+// machine. One short single-thread run gives the thread scaling, a few timed Allreduces the
+// cost of the sums exchange. The cost is extrapolated linearly in n. Iteration counts grow with
+// the data (more border points keep the centroids moving), so a second run on a quarter of the
+// sample gives the growth per doubling of n, extrapolated in log n. Both are rough: the sample
+// fits in cache better than the full data, and the count varies with the initialization.
+// Rank counts assume that every rank brings its own cores (one rank per node).
+class RunPlanner {
+private:
+    int k;
+    int maxIter;
+    double threshold;
+    long long sampleSize = 0;       // 0 -> max(50000, 50 * k) points, at most n
+    uint64_t seed = 1;
+
+    // Picks the sample and measures on it (rank 0 only), fills the measured fields
+    void measure(const Dataset& data, RunPlan& plan) const;
+    void recommend(RunPlan& plan, int availableRanks) const;
+
+public:
+    // Very large k, where the bisecting engine is recommended over flat k-means
+    static constexpr int BISECTING_MIN_K = 1024;
+
+    RunPlanner(int k, int maxIter = 100, double threshold = 1e-4);
+
+    void setSampleSize(long long points) { sampleSize = points; }
+    void setSeed(uint64_t newSeed) { seed = newSeed; }
+
+    // Collective over the transport: the data is read on rank 0 only (as in DistributedKMeans::run),
+    // every rank returns the same plan
+    RunPlan plan(const Dataset& data, Transport& world = Transport::world()) const;
+};
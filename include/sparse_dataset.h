@@ -0,0 +1,66 @@
+#pragma once
+
+#include "utils.h"
+#include "empty_cluster.h"
+#include "distance_metrics.h"
+#include <cstdint>
+#include <vector>
+
+// Points in CSR form for high-dimensional data with few nonzeros (e.g. TF-IDF).
+// Row r owns colIdx/values in [rowPtr[r], rowPtr[r + 1]), columns sorted and unique.
+struct SparseDataset {
+    int dim = 0;
+    std::vector<long long> rowPtr{0};
+    std::vector<int> colIdx;
+    std::vector<double> values;
+    std::vector<double> weights;    // empty -> every row has weight 1
+    std::vector<double> normSq;     // ||x||^2 per row, filled by computeNorms() (the engines refresh it per run)
+    std::vector<int> labels;        // cluster of every row after a run
+
+    [[nodiscard]] long long numRows() const { return static_cast<long long>(rowPtr.size()) - 1; }
+    [[nodiscard]] long long nnz() const { return rowPtr.back(); }
+    [[nodiscard]] double weight(long long row) const { return weights.empty() ? 1.0 : weights[row]; }
+
+    void addRow(const int* cols, const double* vals, int count, double weight = 1.0);
+    void computeNorms();
+    // Writes row into a dense array of dim values (zeros elsewhere)
+    void densifyRow(long long row, double* out) const;
+};
+
+// Dense centroids for sparse data: row-major (k x dim) for the updates and transposed
+// (dim x k) for the assignment, so every nonzero x_d reads the k values c_jd contiguously.
+struct SparseCentroids {
+    int k = 0;
+    int dim = 0;
+    std::vector<double> rows;         // k * dim
+    std::vector<double> transposed;   // dim * k
+    std::vector<double> normSq;       // ||c_j||^2
+
+    void resize(int numClusters, int numDim);
+    // Rebuilds the transposed copy and the norms after rows changed
+    void refresh();
+    [[nodiscard]] std::vector<Point> toPoints() const;
+};
+
+// Lloyd steps on CSR data, O(nnz * k) per assignment instead of O(N * dim * k).
+// Shared by the OpenMP engine and the per-rank part of the MPI engine.
+class SparseKMeansOps {
+public:
+    // Given centroids if they match k/dim, otherwise k distinct random rows
+    static void initialize(const SparseDataset& data, const std::vector<Point>& initial, SparseCentroids& centroids);
+    // Sets data.labels, adds weighted distances to clusterSSE (k) and tracks reseeding
+    // candidates. ||x||^2 - 2 x.c + ||c||^2 (or 1 - x.c / ||x|| for COSINE with unit centroids)
+    // touches only the nonzeros of x. MANHATTAN is not supported on sparse data.
+    static void assign(SparseDataset& data, const SparseCentroids& centroids, double* clusterSSE,
+                       ReseedTracker& tracker, EmptyClusterPolicy policy,
+                       DistanceMetric metric = DistanceMetric::SQUARED_EUCLIDEAN);
+    // Weighted sums (k * dim), weights and counts (k) of every cluster. Rows are bucketed
+    // by cluster first, so each cluster's row is scatter-added by one thread (no per-thread
+    // k * dim buffers, which would not fit for large dim).
+    static void accumulate(const SparseDataset& data, int k, double* sums, double* clusterWeight, int* counts);
+    // Turns the sums (k * dim, in place) into means (unit length for COSINE) and returns the
+    // largest squared shift. Clusters without weight keep their old row and are listed in emptyClusters
+    static double finishUpdate(double* sums, const double* clusterWeight, const SparseCentroids& current,
+                               std::vector<int>& emptyClusters,
+                               DistanceMetric metric = DistanceMetric::SQUARED_EUCLIDEAN);
+};
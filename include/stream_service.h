@@ -0,0 +1,74 @@
+#pragma once
+
+#include "online_kmeans.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct StreamConfig {
+    std::string socketPath;             // empty: stdin -> stdout, otherwise a local Unix socket
+    double latencyTargetMs = 20.0;      // arrival of a point -> its label written
+    size_t maxQueuedPoints = 1 << 18;   // the reader stops reading above this (backpressure)
+    size_t minBatch = 1;
+    size_t maxBatch = 1 << 16;
+    size_t maxLineBytes = 1 << 20;      // longer lines are answered with -1, their rest is skipped
+    double halfLife = 0.0;              // online update half-life in points, 0 = no decay
+    double snapshotIntervalS = 10.0;    // 0 disables snapshots
+    std::string snapshotPath = "kmeans_online.bin";
+};
+
+// Long-running scoring/update loop. Input is one point per line (coordinates separated by
+// commas or spaces, empty lines are ignored), output is one label per line in the same
+// order (-1 for lines that do not hold dim finite numbers). A reader thread parses into a bounded queue; when the queue is full
+// it stops reading, so the pipe/socket fills up and the producer blocks. The main thread
+// takes batches sized from the measured per-point cost so that waiting plus processing
+// stays within the latency target, and periodically publishes model snapshots
+// (written to a temporary file and renamed, readers never see a partial model).
+class StreamService {
+private:
+    using Clock = std::chrono::steady_clock;
+
+    StreamConfig config;
+    OnlineKMeans model;
+    int dim;
+
+    // Bounded ring of parsed points
+    std::mutex queueMutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    std::vector<double> ring;               // maxQueuedPoints * dim
+    std::vector<char> ringValid;
+    std::vector<Clock::time_point> ringArrival;
+    size_t head = 0;
+    size_t queued = 0;
+    bool inputClosed = false;
+
+    // Batching state (main thread only)
+    double costPerPointS = 1e-6;            // running estimate of the processing cost
+    std::atomic<size_t> batchTarget{1};     // also read by the reader to decide when to wake us
+    Clock::time_point lastSnapshot;
+
+    // Statistics
+    long long pointsServed = 0;
+    long long invalidLines = 0;
+    long long batches = 0;
+    long long snapshots = 0;
+    double maxLatencyMs = 0.0;
+    double sumLatencyMs = 0.0;
+
+    void readerLoop(int inFd);
+    void push(const double* coords, bool valid);
+    bool serveConnection(int inFd, int outFd);
+    void publishSnapshot();
+
+public:
+    StreamService(const KMeansModel& trained, const StreamConfig& config);
+
+    // Serves stdin or, with a socket path, one client after another until SIGINT/SIGTERM.
+    // Returns 0 on a clean shutdown.
+    int run();
+    void printStats() const;
+};
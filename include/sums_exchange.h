@@ -0,0 +1,59 @@
+#pragma once
+
+#include "node_reducer.h"
+#include "transport.h"
+#include <vector>
+
+// How the MPI engine reduces the k * dim centroid sums every iteration
+enum class CommCompression {
+    NONE,              // full double Allreduce of the sums (and a centroid Bcast per iteration)
+    CHANGED_CLUSTERS,  // only the rows of clusters whose membership changed on some rank, exact
+    FLOAT32_DELTA      // float32 deltas against what the other ranks already know, with error feedback
+};
+
+// Reduces a row of [k * dim sums | tail] across the ranks. The tail (per-cluster SSE and
+// weights) is small and always reduced exactly in double; the sums are compressed.
+// Every buffer is sized in prepare(), so reduce() does not allocate.
+//
+// FLOAT32_DELTA error: each rank's own float rounding is fed back, but the float sum of the
+// P ranks' deltas rounds again and no rank knows that error. Per compressed reduction it is at
+// most (P - 1) * 2^-24 * sum_r |delta_r| per element (the depth of the tree instead of P - 1
+// with a NodeReducer), and it adds up in `global` until the next full reduction. Centroids
+// between exact passes, and the convergence test on them, are approximate by that much;
+// the engine stops only after an exact pass agrees.
+class SumsExchange {
+private:
+    CommCompression mode = CommCompression::NONE;
+    int k = 0;
+    int dim = 0;
+    int tail = 0;
+    bool primed = false;            // false until the first full reduction
+    long long bytes = 0;            // payload this rank contributed since prepare()
+    NodeReducer* reducer = nullptr; // two-level reduction when set, flat Allreduce otherwise
+
+    std::vector<double> known;      // CHANGED_CLUSTERS: local sums last sent, FLOAT32_DELTA: sum of sent deltas
+    std::vector<double> global;     // running global sums (k * dim)
+    std::vector<int> changed;       // per-cluster flags, OR-reduced
+    std::vector<double> packed;     // changed rows followed by the tail
+    std::vector<float> deltas;      // k * dim float32 deltas
+    std::vector<double> tailBuffer;
+
+    void reduceFull(const double* local, double* out, Transport& transport);
+    template <class T> void sum(T* data, int count, Transport& transport);
+
+public:
+    // nodeReducer (optional) must be prepared for (k * dim + tail) doubles
+    void prepare(CommCompression newMode, int numClusters, int numDim, int tailSize,
+                 NodeReducer* nodeReducer = nullptr);
+
+    // Collective. forceExact makes this call a full double reduction, which also resynchronizes
+    // the compressed state (FLOAT32_DELTA uses it to confirm convergence)
+    void reduce(const double* local, double* out, bool forceExact, Transport& transport);
+
+    // Sum of per-rank counts, through the same (flat or two-level) path
+    void reduceCounts(const int* local, int* out, int count, Transport& transport);
+
+    [[nodiscard]] CommCompression getMode() const { return mode; }
+    // Payload this rank sent; with a NodeReducer only what left the node counts
+    [[nodiscard]] long long bytesSent() const { return bytes; }
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent pool of worker threads with per-worker chunk queues and work stealing.
+// Threads are started once and sleep between jobs, so a parallel phase only costs a wake-up.
+// A job is a range split into chunks; each worker drains its own block of chunks front to
+// back and, once empty, steals single chunks from the back of the other queues.
+// The calling thread takes part as worker 0. Jobs must not be nested.
+class WorkStealingPool {
+private:
+    using RangeFn = void (*)(void* ctx, long long begin, long long end, int worker);
+
+    struct alignas(64) ChunkQueue {
+        std::mutex lock;
+        long long head = 0;  // next chunk for the owner
+        long long tail = 0;  // one past the last chunk, thieves take from here
+    };
+
+    int numWorkers;
+    std::vector<std::thread> threads;
+    std::unique_ptr<ChunkQueue[]> queues;
+
+    // Current job
+    RangeFn jobFn = nullptr;
+    void* jobCtx = nullptr;
+    long long jobSize = 0;
+    long long jobChunk = 1;
+
+    std::mutex wakeMutex;
+    std::condition_variable wakeCv;
+    unsigned long long epoch = 0;
+    bool stopping = false;
+
+    std::mutex doneMutex;
+    std::condition_variable doneCv;
+    std::atomic<int> busyWorkers{0};
+    std::atomic<long long> stolenChunks{0};
+
+    void workerLoop(int id);
+    void drain(int id);
+    bool nextChunk(int id, long long& chunkIdx);
+    void run(long long n, long long chunk, RangeFn fn, void* ctx);
+
+public:
+    // numThreads == 0 uses omp_get_max_threads(), to follow the same OMP_NUM_THREADS setting
+    explicit WorkStealingPool(int numThreads = 0);
+    ~WorkStealingPool();
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    [[nodiscard]] int size() const { return numWorkers; }
+    // Chunks taken from another worker's queue since the pool was created
+    [[nodiscard]] long long getStolenChunks() const { return stolenChunks.load(); }
+
+    // Calls fn(begin, end, worker) for every chunk of [0, n); worker is in [0, size())
+    template <typename Fn>
+    void parallelFor(long long n, long long chunk, Fn& fn) {
+        run(n, chunk, [](void* ctx, long long begin, long long end, int worker) {
+            (*static_cast<Fn*>(ctx))(begin, end, worker);
+        }, &fn);
+    }
+};
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Element types and reductions the distributed engine needs from its transport
+enum class CommDatatype { INT, LONG_LONG, FLOAT, DOUBLE, BYTE, DOUBLE_INT };
+enum class CommOp { SUM, MIN, MAX, MAXLOC };   // MAXLOC: DOUBLE_INT only, lowest rank wins ties
+
+// Layout of CommDatatype::DOUBLE_INT (same as MPI_DOUBLE_INT)
+struct DoubleInt {
+    double value;
+    int rank;
+};
+
+[[nodiscard]] size_t commDatatypeSize(CommDatatype type);
+
+template <class T> constexpr CommDatatype commDatatypeOf();
+template <> constexpr CommDatatype commDatatypeOf<int>() { return CommDatatype::INT; }
+template <> constexpr CommDatatype commDatatypeOf<long long>() { return CommDatatype::LONG_LONG; }
+template <> constexpr CommDatatype commDatatypeOf<float>() { return CommDatatype::FLOAT; }
+template <> constexpr CommDatatype commDatatypeOf<double>() { return CommDatatype::DOUBLE; }
+template <> constexpr CommDatatype commDatatypeOf<char>() { return CommDatatype::BYTE; }
+template <> constexpr CommDatatype commDatatypeOf<DoubleInt>() { return CommDatatype::DOUBLE_INT; }
+
+// Handle of a non-blocking collective
+using CommRequest = int;
+
+// One piece of a file written by several ranks
+struct FileBlock {
+    long long offset;
+    const void* data;
+    size_t bytes;
+};
+
+// Collectives of the distributed engine, with MPI semantics: every rank calls them in the
+// same order with matching counts. Counts are in elements of the given type.
+// MpiTransport runs on MPI_COMM_WORLD, LocalTransport simulates ranks as threads of one process.
+class Transport {
+public:
+    virtual ~Transport() = default;
+
+    [[nodiscard]] virtual int rank() const = 0;
+    [[nodiscard]] virtual int size() const = 0;
+    // Seconds, comparable between the ranks of one run
+    [[nodiscard]] virtual double wtime() const = 0;
+
+    virtual void barrier() = 0;
+    virtual void bcast(void* data, int count, CommDatatype type, int root) = 0;
+    // In place, the result is identical on every rank
+    virtual void allreduce(void* data, int count, CommDatatype type, CommOp op) = 0;
+    // Non-blocking reduction of send into recv (distinct buffers, neither may be touched until the
+    // request completes). Results are identical on every rank, requests complete in start order
+    virtual CommRequest iallreduce(const void* send, void* recv, int count, CommDatatype type, CommOp op) = 0;
+    // True once the request has completed, the handle is released then
+    virtual bool test(CommRequest request) = 0;
+    virtual void wait(CommRequest request) = 0;
+    // recv holds size() * count elements in rank order
+    virtual void allgather(const void* send, int count, CommDatatype type, void* recv) = 0;
+    // counts/displs (in elements) are only read on the root
+    virtual void gatherv(const void* send, int count, CommDatatype type,
+                         void* recv, const int* counts, const int* displs, int root) = 0;
+    // counts/displs (in elements) are only read on the root
+    virtual void scatterv(const void* send, const int* counts, const int* displs, CommDatatype type,
+                          void* recv, int count, int root) = 0;
+    // Every rank writes its blocks into one file, which is truncated first.
+    // Returns false on every rank if any rank failed
+    virtual bool writeShared(const std::string& filename, const std::vector<FileBlock>& blocks) = 0;
+
+    // MPI_COMM_WORLD when built with MPI, a single local rank otherwise
+    static Transport& world();
+};
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "aligned_memory.h"
 #include <vector>
 #include <cmath>
 #include <iostream>
@@ -8,14 +9,17 @@
 struct Point {
     std::vector<double> coords;
     int clusterId;
+    double weight; // how many original points this one stands for (pre-aggregated data, coresets)
+    double normSq; // cached ||coords||^2 (DataLoader::computeNorms), -1 if unknown; the engines refresh it per run
 
     //Default constructor
-    Point() : clusterId(-1){}
+    Point() : clusterId(-1), weight(1.0), normSq(-1.0){}
     //Data constructor
-    explicit Point(const std::vector<double>& c) : coords(c), clusterId(-1){}
+    explicit Point(const std::vector<double>& c, double w = 1.0) : coords(c), clusterId(-1), weight(w), normSq(-1.0){}
 };
 
-using Dataset = std::vector<Point>;
+// Point array on 64-byte aligned (and, when large, huge-page backed) storage
+using Dataset = AlignedVector<Point>;
 
 
 //Function for distance calculation
@@ -0,0 +1,103 @@
+#include "../include/aligned_memory.h"
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace {
+
+std::atomic<HugePages> hugePages{HugePages::TRANSPARENT};
+std::atomic<long long> explicitFallbacks{0};
+
+#ifdef __linux__
+size_t mappedSize(size_t bytes) {
+    return (bytes + AlignedMemory::HUGE_PAGE - 1) / AlignedMemory::HUGE_PAGE * AlignedMemory::HUGE_PAGE;
+}
+
+// Maps size + one huge page and trims both ends to a 2 MB aligned range
+void* mapAligned(size_t size) {
+    const size_t padded = size + AlignedMemory::HUGE_PAGE;
+    void* raw = mmap(nullptr, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) return nullptr;
+    const uintptr_t start = reinterpret_cast<uintptr_t>(raw);
+    const uintptr_t aligned = (start + AlignedMemory::HUGE_PAGE - 1) & ~(uintptr_t(AlignedMemory::HUGE_PAGE) - 1);
+    if (aligned > start) munmap(raw, aligned - start);
+    const size_t tail = start + padded - (aligned + size);
+    if (tail > 0) munmap(reinterpret_cast<void*>(aligned + size), tail);
+    return reinterpret_cast<void*>(aligned);
+}
+
+void* mapLarge(size_t bytes) {
+    const size_t size = mappedSize(bytes);
+    HugePages mode = hugePages.load(std::memory_order_relaxed);
+
+#ifdef MAP_HUGETLB
+    if (mode == HugePages::EXPLICIT) {
+        // Huge TLB mappings are 2 MB aligned by the kernel; fails when the pool is too small
+        void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) return p;
+    }
+#endif
+    if (mode == HugePages::EXPLICIT) {
+        explicitFallbacks.fetch_add(1, std::memory_order_relaxed);
+        mode = HugePages::TRANSPARENT;
+    }
+
+    void* p = mapAligned(size);
+    if (!p) return nullptr;
+    // Advice only, kernels without THP ignore or reject it
+#if defined(MADV_HUGEPAGE) && defined(MADV_NOHUGEPAGE)
+    madvise(p, size, mode == HugePages::TRANSPARENT ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+#endif
+    return p;
+}
+#endif
+
+}
+
+void AlignedMemory::setHugePages(HugePages mode) {
+    hugePages.store(mode, std::memory_order_relaxed);
+}
+
+HugePages AlignedMemory::getHugePages() {
+    return hugePages.load(std::memory_order_relaxed);
+}
+
+void* AlignedMemory::allocate(size_t bytes) {
+#ifdef __linux__
+    if (bytes >= LARGE_BLOCK) {
+        if (void* p = mapLarge(bytes)) return p;
+        throw std::bad_alloc();
+    }
+#endif
+    return ::operator new(bytes == 0 ? 1 : bytes, std::align_val_t(ALIGNMENT));
+}
+
+void AlignedMemory::release(void* p, size_t bytes) {
+    if (!p) return;
+#ifdef __linux__
+    if (bytes >= LARGE_BLOCK) {
+        munmap(p, mappedSize(bytes));
+        return;
+    }
+#endif
+    ::operator delete(p, std::align_val_t(ALIGNMENT));
+}
+
+long long AlignedMemory::getExplicitFallbacks() {
+    return explicitFallbacks.load(std::memory_order_relaxed);
+}
+
+long long AlignedMemory::residentHugePageBytes() {
+    std::ifstream rollup("/proc/self/smaps_rollup");
+    std::string key;
+    long long kb;
+    while (rollup >> key) {
+        if (key == "AnonHugePages:" && rollup >> kb) return kb * 1024;
+    }
+    return -1;
+}
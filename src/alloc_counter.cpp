@@ -0,0 +1,60 @@
+#include "../include/alloc_counter.h"
+
+#ifdef KMEANS_ALLOC_HOOK
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<long long> allocations{0};
+static thread_local long long threadAllocations = 0;
+
+static void* countedAlloc(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    threadAllocations++;
+    if (void* p = std::malloc(size == 0 ? 1 : size)) return p;
+    throw std::bad_alloc();
+}
+
+static void* countedAlignedAlloc(std::size_t size, std::align_val_t align) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    threadAllocations++;
+    std::size_t alignment = static_cast<std::size_t>(align);
+#ifdef _WIN32
+    if (void* p = _aligned_malloc(size == 0 ? 1 : size, alignment)) return p;
+#else
+    void* p = nullptr;
+    if (posix_memalign(&p, alignment < sizeof(void*) ? sizeof(void*) : alignment, size == 0 ? 1 : size) == 0) return p;
+#endif
+    throw std::bad_alloc();
+}
+
+static void alignedFree(void* p) {
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+
+void* operator new(std::size_t size) { return countedAlloc(size); }
+void* operator new[](std::size_t size) { return countedAlloc(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+void* operator new(std::size_t size, std::align_val_t align) { return countedAlignedAlloc(size, align); }
+void* operator new[](std::size_t size, std::align_val_t align) { return countedAlignedAlloc(size, align); }
+void operator delete(void* p, std::align_val_t) noexcept { alignedFree(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { alignedFree(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { alignedFree(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { alignedFree(p); }
+
+bool AllocCounter::enabled() { return true; }
+long long AllocCounter::count() { return allocations.load(std::memory_order_relaxed); }
+long long AllocCounter::threadCount() { return threadAllocations; }
+#else
+bool AllocCounter::enabled() { return false; }
+long long AllocCounter::count() { return 0; }
+long long AllocCounter::threadCount() { return 0; }
+#endif
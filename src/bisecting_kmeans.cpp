@@ -0,0 +1,290 @@
+#include "../include/bisecting_kmeans.h"
+#include "../include/parallel_kmeans.h"
+#include "../include/philox.h"
+#include "../include/distance_kernels.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <omp.h>
+
+namespace {
+
+// splitmix64 step, turns (parent key, side) into the key of the child
+uint64_t childKey(uint64_t parent, int side) {
+    uint64_t z = parent * 2 + 1 + side + 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+}
+
+BisectingKMeans::BisectingKMeans(int k, int maxIter, double threshold, unsigned int seed)
+    : k(k), maxIter(maxIter), threshold(threshold), seed(seed) {}
+
+void BisectingKMeans::meanOf(const Dataset& data, const std::vector<size_t>& indices, int node) {
+    double* c = nodeCentroids.data() + static_cast<size_t>(node) * dim;
+    std::fill(c, c + dim, 0.0);
+    double total = 0.0;
+    for (size_t i : indices) {
+        const double w = data[i].weight;
+        for (int d = 0; d < dim; ++d) c[d] += w * data[i].coords[d];
+        total += w;
+    }
+    if (total > 0.0) {
+        for (int d = 0; d < dim; ++d) c[d] /= total;
+    }
+
+    double sse = 0.0;
+    for (size_t i : indices) sse += data[i].weight * squaredDistance(data[i].coords.data(), c, dim);
+    nodes[node].size = static_cast<long long>(indices.size());
+    nodes[node].sse = sse;
+}
+
+bool BisectingKMeans::split(const Dataset& data, Task& task, Task& left, Task& right) {
+    const size_t m = task.indices.size();
+    if (task.budget < 2 || m < 2) return false;
+
+    Dataset subset(m);
+    for (size_t i = 0; i < m; ++i) subset[i] = data[task.indices[i]];
+
+    // D^2 pair seeding, the random stream depends only on the node path
+    auto draw = [&](uint64_t counter) {
+        return Philox4x32::toUniform(Philox4x32::generate(counter, 0, seed ^ task.key).v[0]);
+    };
+    size_t first = std::min(m - 1, static_cast<size_t>(draw(0) * m));
+    std::vector<double> weight(m);
+    double total = 0.0;
+    for (size_t i = 0; i < m; ++i) {
+        weight[i] = subset[i].weight * squaredDistance(subset[i].coords.data(), subset[first].coords.data(), dim);
+        total += weight[i];
+    }
+    // Every point equals the first one, nothing to split
+    if (total <= 0.0) return false;
+
+    double target = draw(1) * total;
+    size_t second = m - 1;
+    for (size_t i = 0; i < m; ++i) {
+        target -= weight[i];
+        if (target <= 0.0 && weight[i] > 0.0) {
+            second = i;
+            break;
+        }
+    }
+    if (weight[second] <= 0.0) return false;
+
+    ParallelKMeans engine(2, maxIter, threshold);
+    engine.setVerbose(false);
+    engine.setInitialCentroids({subset[first], subset[second]});
+    // Inside a task the worksharing loops of the engine collapse to the calling thread
+    KMeansResult part = engine.run(subset);
+    totalIterations += part.iterations;
+
+    left.indices.clear();
+    right.indices.clear();
+    for (size_t i = 0; i < m; ++i) {
+        (subset[i].clusterId == 0 ? left.indices : right.indices).push_back(task.indices[i]);
+    }
+    if (left.indices.empty() || right.indices.empty()) return false;
+
+    const std::vector<Point>& halves = engine.getCentroids();
+    Task* children[2] = {&left, &right};
+    for (int side = 0; side < 2; ++side) {
+        Task& child = *children[side];
+        child.node = nextNode++;
+        child.key = childKey(task.key, side);
+        std::copy(halves[side].coords.begin(), halves[side].coords.end(),
+                  nodeCentroids.begin() + static_cast<size_t>(child.node) * dim);
+        nodes[child.node].size = static_cast<long long>(child.indices.size());
+        nodes[child.node].sse = part.clusterSSE[side];
+    }
+    nodes[task.node].left = left.node;
+    nodes[task.node].right = right.node;
+
+    // Leaf budget in proportion to SSE, each child gets at least one leaf and at most one per point
+    const long long sizeL = nodes[left.node].size;
+    const long long sizeR = nodes[right.node].size;
+    const double sseL = nodes[left.node].sse;
+    const double sseR = nodes[right.node].sse;
+    double share = sseL + sseR > 0.0 ? sseL / (sseL + sseR)
+                                     : static_cast<double>(sizeL) / static_cast<double>(sizeL + sizeR);
+    long long budgetL = std::llround(share * task.budget);
+    budgetL = std::max<long long>(budgetL, std::max<long long>(1, task.budget - sizeR));
+    budgetL = std::min<long long>(budgetL, std::min<long long>(sizeL, task.budget - 1));
+    left.budget = static_cast<int>(budgetL);
+    right.budget = task.budget - left.budget;
+
+    task.indices.clear();
+    task.indices.shrink_to_fit();
+    return true;
+}
+
+void BisectingKMeans::makeLeaf(Dataset& data, const Task& task) {
+    // Node index for now, renumbered to cluster ids once the tree is complete
+    for (size_t i : task.indices) data[i].clusterId = task.node;
+    nodes[task.node].leaf = 0;
+}
+
+void BisectingKMeans::splitSubtree(Dataset& data, Task task) {
+    Task left, right;
+    if (!split(data, task, left, right)) {
+        makeLeaf(data, task);
+        return;
+    }
+
+    #pragma omp task default(shared) firstprivate(left)
+    splitSubtree(data, std::move(left));
+    splitSubtree(data, std::move(right));
+}
+
+int BisectingKMeans::numberLeaves(int root, int next) {
+    // Explicit stack, an unbalanced tree can be k levels deep
+    std::vector<int> stack = {root};
+    while (!stack.empty()) {
+        int node = stack.back();
+        stack.pop_back();
+        if (nodes[node].left < 0) {
+            nodes[node].leaf = next++;
+            continue;
+        }
+        stack.push_back(nodes[node].right);
+        stack.push_back(nodes[node].left);
+    }
+    return next;
+}
+
+KMeansResult BisectingKMeans::run(Dataset& data) {
+    result = KMeansResult();
+    centroids.clear();
+    if (data.empty() || k <= 0) {
+        std::cerr << "Invalid data or k parameter." << std::endl;
+        return result;
+    }
+    if (data.size() < static_cast<size_t>(k)) {
+        std::cerr << "Error: Number of clusters k (" << k << ") is larger than dataset size (" << data.size() << ")." << std::endl;
+        return result;
+    }
+
+    const size_t n = data.size();
+    dim = static_cast<int>(data[0].coords.size());
+    const size_t maxNodes = 2 * static_cast<size_t>(k) - 1;
+    nodes.assign(maxNodes, BisectingNode());
+    nodeCentroids.assign(maxNodes * dim, 0.0);
+    nextNode = 1;
+    totalIterations = 0;
+
+    Task root{0, std::vector<size_t>(n), k, seed};
+    for (size_t i = 0; i < n; ++i) root.indices[i] = i;
+    meanOf(data, root.indices, 0);
+
+    // Phase 1: nodes large enough to keep the whole team busy are split one at a time.
+    // Phase 2: the remaining subtrees are independent and run as tasks
+    const size_t cutoff = std::max<size_t>(2048, n / (4 * static_cast<size_t>(omp_get_max_threads())));
+    std::vector<Task> large = {std::move(root)};
+    std::vector<Task> small;
+    while (!large.empty()) {
+        Task task = std::move(large.back());
+        large.pop_back();
+        Task left, right;
+        if (!split(data, task, left, right)) {
+            makeLeaf(data, task);
+            continue;
+        }
+        for (Task* child : {&left, &right}) {
+            if (child->budget > 1 && child->indices.size() >= cutoff) large.push_back(std::move(*child));
+            else small.push_back(std::move(*child));
+        }
+    }
+
+    #pragma omp parallel
+    #pragma omp single
+    {
+        for (size_t t = 0; t < small.size(); ++t) {
+            #pragma omp task default(shared) firstprivate(t)
+            splitSubtree(data, std::move(small[t]));
+        }
+    }
+
+    const int numNodes = nextNode;
+    nodes.resize(numNodes);
+    nodeCentroids.resize(static_cast<size_t>(numNodes) * dim);
+    const int numLeaves = numberLeaves(0, 0);
+    if (numLeaves < k) {
+        std::cerr << "Warning: only " << numLeaves << " distinct clusters could be split out (k = " << k << ")." << std::endl;
+    }
+
+    centroids.resize(numLeaves);
+    std::vector<int> leafNode(numLeaves);
+    for (int node = 0; node < numNodes; ++node) {
+        if (nodes[node].left >= 0) {
+            nodes[node].leaf = -1;
+            continue;
+        }
+        leafNode[nodes[node].leaf] = node;
+    }
+    for (int j = 0; j < numLeaves; ++j) {
+        auto first = nodeCentroids.begin() + static_cast<size_t>(leafNode[j]) * dim;
+        centroids[j] = Point(std::vector<double>(first, first + dim));
+    }
+
+    // Node index -> cluster id, exact SSE and sizes against the leaf centroids
+    result.clusterSizes.assign(numLeaves, 0);
+    result.clusterSSE.assign(numLeaves, 0.0);
+    #pragma omp parallel
+    {
+        std::vector<long long> sizes(numLeaves, 0);
+        std::vector<double> sse(numLeaves, 0.0);
+
+        #pragma omp for schedule(static) nowait
+        for (long long i = 0; i < static_cast<long long>(n); ++i) {
+            int cluster = nodes[data[i].clusterId].leaf;
+            data[i].clusterId = cluster;
+            sizes[cluster]++;
+            sse[cluster] += data[i].weight * squaredDistance(data[i].coords.data(), centroids[cluster].coords.data(), dim);
+        }
+
+        #pragma omp critical
+        {
+            for (int j = 0; j < numLeaves; ++j) {
+                result.clusterSizes[j] += sizes[j];
+                result.clusterSSE[j] += sse[j];
+            }
+        }
+    }
+
+    for (int j = 0; j < numLeaves; ++j) {
+        nodes[leafNode[j]].sse = result.clusterSSE[j];
+        result.inertia += result.clusterSSE[j];
+    }
+    result.iterations = totalIterations;
+    result.converged = true;
+
+    trainingInfo = ModelMetadata();
+    trainingInfo.numPoints = static_cast<int64_t>(n);
+    trainingInfo.iterations = result.iterations;
+    trainingInfo.inertia = result.inertia;
+
+    return result;
+}
+
+int BisectingKMeans::nearestLeaf(const double* point, double* dist) const {
+    if (nodes.empty()) return -1;
+
+    int node = 0;
+    while (nodes[node].left >= 0) {
+        const BisectingNode& current = nodes[node];
+        double dl = squaredDistance(point, nodeCentroids.data() + static_cast<size_t>(current.left) * dim, dim);
+        double dr = squaredDistance(point, nodeCentroids.data() + static_cast<size_t>(current.right) * dim, dim);
+        node = dl <= dr ? current.left : current.right;
+    }
+    if (dist) *dist = squaredDistance(point, nodeCentroids.data() + static_cast<size_t>(node) * dim, dim);
+    return nodes[node].leaf;
+}
+
+void BisectingKMeans::predict(const double* points, size_t n, int* labels) const {
+    #pragma omp parallel for schedule(static) if (n >= KMeansModel::PARALLEL_BATCH_THRESHOLD)
+    for (long long i = 0; i < static_cast<long long>(n); ++i) {
+        labels[i] = nearestLeaf(points + static_cast<size_t>(i) * dim);
+    }
+}
@@ -0,0 +1,105 @@
+#include "../include/centroid_kdtree.h"
+#include "../include/distance_kernels.h"
+#include <algorithm>
+#include <limits>
+
+void CentroidKDTree::build(const double* centroids, int numCentroids, int numDim) {
+    k = numCentroids;
+    dim = numDim;
+    nodes.clear();
+    ids.resize(k);
+    for (int i = 0; i < k; ++i) ids[i] = i;
+    if (k == 0) return;
+
+    // Median splits on the dimension with the largest spread
+    points.assign(centroids, centroids + static_cast<size_t>(k) * dim);
+    buildNode(0, k);
+
+    // Store coordinates in tree order so leaf scans read contiguous memory
+    for (int i = 0; i < k; ++i) {
+        for (int d = 0; d < dim; ++d) {
+            points[static_cast<size_t>(i) * dim + d] = centroids[static_cast<size_t>(ids[i]) * dim + d];
+        }
+    }
+}
+
+void CentroidKDTree::build(const std::vector<Point>& centroids) {
+    int numCentroids = static_cast<int>(centroids.size());
+    int numDim = numCentroids > 0 ? static_cast<int>(centroids[0].coords.size()) : 0;
+
+    staging.resize(static_cast<size_t>(numCentroids) * numDim);
+    for (int j = 0; j < numCentroids; ++j) {
+        std::copy(centroids[j].coords.begin(), centroids[j].coords.end(), staging.begin() + static_cast<size_t>(j) * numDim);
+    }
+    build(staging.data(), numCentroids, numDim);
+}
+
+int CentroidKDTree::buildNode(int begin, int end) {
+    int nodeIdx = static_cast<int>(nodes.size());
+    nodes.push_back({-1, 0.0, -1, -1, begin, end});
+    if (end - begin <= LEAF_SIZE) return nodeIdx;
+
+    // points still holds the original order here, ids index into it
+    int splitDim = 0;
+    double bestSpread = -1.0;
+    for (int d = 0; d < dim; ++d) {
+        double lo = std::numeric_limits<double>::max();
+        double hi = std::numeric_limits<double>::lowest();
+        for (int i = begin; i < end; ++i) {
+            double v = points[static_cast<size_t>(ids[i]) * dim + d];
+            lo = std::min(lo, v);
+            hi = std::max(hi, v);
+        }
+        if (hi - lo > bestSpread) {
+            bestSpread = hi - lo;
+            splitDim = d;
+        }
+    }
+
+    int mid = begin + (end - begin) / 2;
+    std::nth_element(ids.begin() + begin, ids.begin() + mid, ids.begin() + end, [&](int a, int b) {
+        return points[static_cast<size_t>(a) * dim + splitDim] < points[static_cast<size_t>(b) * dim + splitDim];
+    });
+
+    double splitValue = points[static_cast<size_t>(ids[mid]) * dim + splitDim];
+    int left = buildNode(begin, mid);
+    int right = buildNode(mid, end);
+
+    nodes[nodeIdx].splitDim = splitDim;
+    nodes[nodeIdx].splitValue = splitValue;
+    nodes[nodeIdx].left = left;
+    nodes[nodeIdx].right = right;
+    return nodeIdx;
+}
+
+void CentroidKDTree::search(int nodeIdx, const double* point, double& bestDist, int& best) const {
+    const Node& node = nodes[nodeIdx];
+
+    if (node.splitDim < 0) {
+        for (int i = node.begin; i < node.end; ++i) {
+            double dist = squaredDistance(point, points.data() + static_cast<size_t>(i) * dim, dim);
+            if (dist < bestDist || (dist == bestDist && ids[i] < best)) {
+                bestDist = dist;
+                best = ids[i];
+            }
+        }
+        return;
+    }
+
+    double diff = point[node.splitDim] - node.splitValue;
+    int nearChild = diff < 0.0 ? node.left : node.right;
+    int farChild = diff < 0.0 ? node.right : node.left;
+
+    search(nearChild, point, bestDist, best);
+    // Bound: the far side is at least |diff| away along the split axis
+    if (diff * diff <= bestDist) {
+        search(farChild, point, bestDist, best);
+    }
+}
+
+int CentroidKDTree::nearest(const double* point, double& bestDist) const {
+    bestDist = std::numeric_limits<double>::max();
+    int best = -1;
+    if (k > 0) search(0, point, bestDist, best);
+    return best;
+}
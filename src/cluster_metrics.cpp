@@ -0,0 +1,72 @@
+#include "../include/cluster_metrics.h"
+#include "../include/distance_kernels.h"
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <omp.h>
+
+double ClusterMetrics::sampledSilhouette(const Dataset& data, int k, int sampleSize, unsigned int seed) {
+    if (data.empty() || sampleSize <= 1) return 0.0;
+
+    const size_t n = data.size();
+    const size_t s = std::min(n, static_cast<size_t>(sampleSize));
+    const int dim = static_cast<int>(data[0].coords.size());
+
+    std::random_device rd;
+    std::mt19937 gen(seed != 0 ? seed : rd());
+    std::vector<size_t> indices(n);
+    for (size_t i = 0; i < n; ++i) indices[i] = i;
+    for (size_t i = 0; i < s; ++i) {
+        std::uniform_int_distribution<size_t> pick(i, n - 1);
+        std::swap(indices[i], indices[pick(gen)]);
+    }
+
+    std::vector<double> flat(s * dim);
+    std::vector<int> labels(s);
+    for (size_t i = 0; i < s; ++i) {
+        const Point& p = data[indices[i]];
+        std::copy(p.coords.begin(), p.coords.end(), flat.begin() + i * dim);
+        labels[i] = p.clusterId;
+    }
+    return silhouette(flat, labels, dim, k);
+}
+
+double ClusterMetrics::silhouette(const std::vector<double>& flat, const std::vector<int>& labels, int dim, int k) {
+    const long long n = static_cast<long long>(labels.size());
+    if (n < 2) return 0.0;
+
+    std::vector<long long> sizes(k, 0);
+    for (int label : labels) {
+        if (label >= 0) sizes[label]++;
+    }
+
+    double total = 0.0;
+    #pragma omp parallel reduction(+:total)
+    {
+        std::vector<double> distSums(k);
+
+        #pragma omp for schedule(static)
+        for (long long i = 0; i < n; ++i) {
+            int own = labels[i];
+            if (own < 0 || sizes[own] < 2) continue; // singleton clusters score 0
+
+            std::fill(distSums.begin(), distSums.end(), 0.0);
+            for (long long j = 0; j < n; ++j) {
+                if (labels[j] < 0) continue;
+                distSums[labels[j]] += std::sqrt(squaredDistance(&flat[i * dim], &flat[j * dim], dim));
+            }
+
+            double a = distSums[own] / static_cast<double>(sizes[own] - 1);
+            double b = std::numeric_limits<double>::max();
+            for (int c = 0; c < k; ++c) {
+                if (c == own || sizes[c] == 0) continue;
+                b = std::min(b, distSums[c] / static_cast<double>(sizes[c]));
+            }
+            if (b == std::numeric_limits<double>::max()) continue; // only one cluster in the sample
+
+            double denom = std::max(a, b);
+            if (denom > 0.0) total += (b - a) / denom;
+        }
+    }
+    return total / static_cast<double>(n);
+}
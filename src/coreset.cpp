@@ -0,0 +1,80 @@
+#include "../include/coreset.h"
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <vector>
+#include <omp.h>
+
+Dataset Coreset::build(const Dataset& data, size_t m, uint64_t seed) {
+    if (data.empty() || m == 0) {
+        std::cerr << "Error: cannot build a coreset of " << m << " points from " << data.size() << " points." << std::endl;
+        return Dataset();
+    }
+
+    const long long n = static_cast<long long>(data.size());
+    const int dim = static_cast<int>(data[0].coords.size());
+
+    // Pass 1: weighted mean
+    std::vector<double> mean(dim, 0.0);
+    double totalWeight = 0.0;
+    #pragma omp parallel
+    {
+        std::vector<double> localMean(dim, 0.0);
+        double localWeight = 0.0;
+
+        #pragma omp for schedule(static) nowait
+        for (long long i = 0; i < n; ++i) {
+            const double w = data[i].weight;
+            localWeight += w;
+            for (int d = 0; d < dim; ++d) localMean[d] += w * data[i].coords[d];
+        }
+
+        #pragma omp critical
+        {
+            totalWeight += localWeight;
+            for (int d = 0; d < dim; ++d) mean[d] += localMean[d];
+        }
+    }
+    if (totalWeight <= 0.0) {
+        std::cerr << "Error: total point weight must be positive." << std::endl;
+        return Dataset();
+    }
+    for (int d = 0; d < dim; ++d) mean[d] /= totalWeight;
+
+    // Pass 2: weighted squared distances to the mean
+    std::vector<double> cost(n);
+    double totalCost = 0.0;
+    #pragma omp parallel for schedule(static) reduction(+:totalCost)
+    for (long long i = 0; i < n; ++i) {
+        double dist = 0.0;
+        for (int d = 0; d < dim; ++d) {
+            double diff = data[i].coords[d] - mean[d];
+            dist += diff * diff;
+        }
+        cost[i] = data[i].weight * dist;
+        totalCost += cost[i];
+    }
+
+    // Sampling distribution as a running sum (cost is reused for it), sampled by binary search
+    for (long long i = 0; i < n; ++i) {
+        // All points on the mean: the distance term degenerates to uniform sampling
+        double share = data[i].weight / totalWeight;
+        double q = 0.5 * share + 0.5 * (totalCost > 0.0 ? cost[i] / totalCost : share);
+        cost[i] = q + (i > 0 ? cost[i - 1] : 0.0);
+    }
+
+    std::random_device rd;
+    std::mt19937_64 gen(seed != 0 ? seed : (static_cast<uint64_t>(rd()) << 32 | rd()));
+    std::uniform_real_distribution<double> uniform(0.0, cost[n - 1]);
+
+    Dataset coreset(m);
+    for (size_t s = 0; s < m; ++s) {
+        long long i = std::upper_bound(cost.begin(), cost.end(), uniform(gen)) - cost.begin();
+        i = std::min(i, n - 1);
+        double q = cost[i] - (i > 0 ? cost[i - 1] : 0.0);
+
+        coreset[s].coords = data[i].coords;
+        coreset[s].weight = data[i].weight / (static_cast<double>(m) * q);
+    }
+    return coreset;
+}
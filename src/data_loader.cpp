@@ -1,32 +1,274 @@
 #include "../include/data_loader.h"
+#include "../include/philox.h"
 #include <random>
 #include <iostream>
 #include <iomanip>
 #include <fstream>
 #include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <cctype>
+#include <cstdlib>
+#include <omp.h>
 
-Dataset DataLoader::generateData(int numPoints, int dim, double minVal, double maxVal) {
-    std::cout << "Generating " << numPoints << " points in " << dim << " dimensions..." << std::endl;
-
-    Dataset data;
-    data.reserve(numPoints); //Memory reservation
+// Philox streams (high counter word): points, cluster centers, cluster transforms, sparse data
+static constexpr uint64_t STREAM_POINTS = 0;
+static constexpr uint64_t STREAM_CENTERS = 1;
+static constexpr uint64_t STREAM_TRANSFORMS = 2;
+static constexpr uint64_t STREAM_SPARSE = 3;
 
+static uint64_t resolveSeed(uint64_t seed) {
+    if (seed != 0) return seed;
     std::random_device rd;
-    std::mt19937 gen(rd()); // Mersenne Twister gen
-    std::uniform_real_distribution<> dis(minVal, maxVal); // Uniform Distribution
+    return (static_cast<uint64_t>(rd()) << 32) | rd();
+}
+
+static uint64_t counterHi(uint64_t block, uint64_t stream) {
+    return (block << 2) | stream;
+}
+
+//index-th standard normal of a stream (used for the small per-cluster tables)
+static double normalAt(uint64_t key, uint64_t stream, uint64_t index) {
+    Philox4x32 r = Philox4x32::generate(index / 4, counterHi(0, stream), key);
+    int pair = static_cast<int>(index % 4) / 2;
+    double z0, z1;
+    Philox4x32::toNormal(r.v[2 * pair], r.v[2 * pair + 1], z0, z1);
+    return index % 2 == 0 ? z0 : z1;
+}
+
+// Per-cluster centers (and linear maps for anisotropic blobs), derived from the seed only
+struct MixtureTables {
+    std::vector<double> centers;     // numClusters * dim
+    std::vector<double> transforms;  // numClusters * dim * dim, row-major
+};
+
+static MixtureTables buildMixture(const GeneratorSpec& spec, uint64_t key) {
+    MixtureTables tables;
+    if (spec.distribution == DataDistribution::UNIFORM) return tables;
+
+    const size_t dim = spec.dim;
+    tables.centers.resize(spec.numClusters * dim);
+    for (size_t i = 0; i < tables.centers.size(); ++i) {
+        Philox4x32 r = Philox4x32::generate(i / 4, counterHi(0, STREAM_CENTERS), key);
+        tables.centers[i] = spec.minVal + (spec.maxVal - spec.minVal) * Philox4x32::toUniform(r.v[i % 4]);
+    }
+
+    if (spec.distribution == DataDistribution::ANISOTROPIC_BLOBS) {
+        // Gaussian random matrix scaled so a coordinate has clusterStd spread on average
+        double scale = spec.clusterStd / std::sqrt(static_cast<double>(dim));
+        tables.transforms.resize(spec.numClusters * dim * dim);
+        for (size_t i = 0; i < tables.transforms.size(); ++i) {
+            tables.transforms[i] = scale * normalAt(key, STREAM_TRANSFORMS, i);
+        }
+    }
+    return tables;
+}
+
+// Generates one point, only depends on (spec, key, index)
+static void generatePoint(const GeneratorSpec& spec, const MixtureTables& tables, uint64_t key,
+                          uint64_t index, double* out, int* label, double* z) {
+    const int dim = spec.dim;
+
+    if (spec.distribution == DataDistribution::UNIFORM) {
+        for (int d = 0; d < dim; d += 4) {
+            Philox4x32 r = Philox4x32::generate(index, counterHi(d / 4, STREAM_POINTS), key);
+            for (int w = 0; w < 4 && d + w < dim; ++w) {
+                out[d + w] = spec.minVal + (spec.maxVal - spec.minVal) * Philox4x32::toUniform(r.v[w]);
+            }
+        }
+        if (label) *label = -1;
+        return;
+    }
 
-    for (int i = 0; i < numPoints; i++){
-        std::vector<double> coords(static_cast<size_t>(dim));
-        for (int d = 0; d < dim; d++) {
-            coords[d] = dis(gen);
+    // Block 0 picks the component, the following blocks give 4 normals each
+    Philox4x32 pick = Philox4x32::generate(index, counterHi(0, STREAM_POINTS), key);
+    int cluster = static_cast<int>(Philox4x32::toUniform(pick.v[0]) * spec.numClusters);
+    if (cluster >= spec.numClusters) cluster = spec.numClusters - 1;
+    if (label) *label = cluster;
+
+    for (int d = 0; d < dim; d += 4) {
+        Philox4x32 r = Philox4x32::generate(index, counterHi(1 + d / 4, STREAM_POINTS), key);
+        double n[4];
+        Philox4x32::toNormal(r.v[0], r.v[1], n[0], n[1]);
+        Philox4x32::toNormal(r.v[2], r.v[3], n[2], n[3]);
+        for (int w = 0; w < 4 && d + w < dim; ++w) z[d + w] = n[w];
+    }
+
+    const double* center = tables.centers.data() + static_cast<size_t>(cluster) * dim;
+    if (spec.distribution == DataDistribution::GAUSSIAN_MIXTURE) {
+        for (int d = 0; d < dim; ++d) out[d] = center[d] + spec.clusterStd * z[d];
+    } else {
+        const double* a = tables.transforms.data() + static_cast<size_t>(cluster) * dim * dim;
+        for (int d = 0; d < dim; ++d) {
+            double v = center[d];
+            for (int e = 0; e < dim; ++e) v += a[d * dim + e] * z[e];
+            out[d] = v;
+        }
+    }
+}
+
+void DataLoader::generateInto(const GeneratorSpec& spec, long long firstIndex, long long count,
+                              double* out, int* labels) {
+    const uint64_t key = resolveSeed(spec.seed);
+    const MixtureTables tables = buildMixture(spec, key);
+    const int dim = spec.dim;
+
+    #pragma omp parallel
+    {
+        std::vector<double> z(dim);
+
+        #pragma omp for schedule(static)
+        for (long long i = 0; i < count; ++i) {
+            generatePoint(spec, tables, key, static_cast<uint64_t>(firstIndex + i),
+                          out + i * dim, labels ? labels + i : nullptr, z.data());
         }
-        data.emplace_back(coords);
     }
+}
 
+Dataset DataLoader::generate(const GeneratorSpec& spec, long long numPoints, std::vector<int>* labels) {
+    std::cout << "Generating " << numPoints << " points in " << spec.dim << " dimensions..." << std::endl;
+
+    GeneratorSpec fixed = spec;
+    fixed.seed = resolveSeed(spec.seed);
+    const uint64_t key = fixed.seed;
+    const MixtureTables tables = buildMixture(fixed, key);
+    const int dim = spec.dim;
+
+    Dataset data(numPoints);
+    if (labels) labels->resize(numPoints);
+
+    // Every thread allocates and fills its own points (first touch stays on the thread's node)
+    #pragma omp parallel
+    {
+        std::vector<double> z(dim);
+
+        #pragma omp for schedule(static)
+        for (long long i = 0; i < numPoints; ++i) {
+            data[i].coords.resize(dim);
+            generatePoint(fixed, tables, key, static_cast<uint64_t>(i), data[i].coords.data(),
+                          labels ? &(*labels)[i] : nullptr, z.data());
+        }
+    }
+
+    computeNorms(data);
     std::cout << "Generation complete!" <<std::endl;
     return data;
 }
 
+Dataset DataLoader::generateData(int numPoints, int dim, double minVal, double maxVal, uint64_t seed) {
+    GeneratorSpec spec;
+    spec.distribution = DataDistribution::UNIFORM;
+    spec.dim = dim;
+    spec.minVal = minVal;
+    spec.maxVal = maxVal;
+    spec.seed = seed;
+    return generate(spec, numPoints);
+}
+
+void DataLoader::computeNorms(Dataset& data) {
+    #pragma omp parallel for schedule(static)
+    for (long long i = 0; i < static_cast<long long>(data.size()); ++i) {
+        Point& p = data[i];
+        const double* x = p.coords.data();
+        const int dim = static_cast<int>(p.coords.size());
+        double sum = 0.0;
+        #pragma omp simd reduction(+:sum)
+        for (int d = 0; d < dim; ++d) sum += x[d] * x[d];
+        p.normSq = sum;
+    }
+}
+
+std::vector<double> DataLoader::groundTruthCenters(const GeneratorSpec& spec) {
+    return buildMixture(spec, resolveSeed(spec.seed)).centers;
+}
+
+SparseDataset DataLoader::generateSparse(long long numPoints, int dim, double density, int numClusters,
+                                        uint64_t seed, std::vector<int>* labels) {
+    std::cout << "Generating " << numPoints << " sparse points in " << dim << " dimensions (density "
+              << density << ")..." << std::endl;
+
+    const uint64_t key = resolveSeed(seed);
+    const int perRow = std::max(1, static_cast<int>(std::lround(density * dim)));
+    // Every cluster is a "topic": most nonzeros of its points fall into its own set of hot dims
+    const int topicSize = std::min(dim, std::max(16, 4 * perRow));
+    const double topicShare = 0.7;
+
+    // Block 0 of the stream holds the topic tables, the points use blocks >= 1
+    std::vector<int> topics(static_cast<size_t>(numClusters) * topicSize);
+    const uint64_t topicBlocks = (topicSize + 3) / 4;
+    for (int c = 0; c < numClusters; ++c) {
+        for (int t = 0; t < topicSize; ++t) {
+            Philox4x32 r = Philox4x32::generate(c * topicBlocks + t / 4, counterHi(0, STREAM_SPARSE), key);
+            topics[static_cast<size_t>(c) * topicSize + t] = std::min(dim - 1, static_cast<int>(Philox4x32::toUniform(r.v[t % 4]) * dim));
+        }
+    }
+
+    SparseDataset data;
+    data.dim = dim;
+    data.rowPtr.assign(numPoints + 1, 0);
+    if (labels) labels->resize(numPoints);
+
+    // Fixed-stride scratch first (duplicates still in), then compacted once the row sizes are known
+    std::vector<int> cols(static_cast<size_t>(numPoints) * perRow);
+    std::vector<double> vals(cols.size());
+
+    #pragma omp parallel
+    {
+        std::vector<std::pair<int, double>> row(perRow);
+
+        #pragma omp for schedule(static)
+        for (long long i = 0; i < numPoints; ++i) {
+            Philox4x32 pick = Philox4x32::generate(i, counterHi(1, STREAM_SPARSE), key);
+            int cluster = std::min(numClusters - 1, static_cast<int>(Philox4x32::toUniform(pick.v[0]) * numClusters));
+            if (labels) (*labels)[i] = cluster;
+            const int* topic = topics.data() + static_cast<size_t>(cluster) * topicSize;
+
+            // Two words per nonzero: which dim, and its value
+            for (int j = 0; j < perRow; ++j) {
+                Philox4x32 r = Philox4x32::generate(i, counterHi(2 + j / 2, STREAM_SPARSE), key);
+                double u = Philox4x32::toUniform(r.v[2 * (j % 2)]);
+                int col = u < topicShare
+                        ? topic[std::min(topicSize - 1, static_cast<int>(u / topicShare * topicSize))]
+                        : std::min(dim - 1, static_cast<int>((u - topicShare) / (1.0 - topicShare) * dim));
+                row[j] = {col, 0.5 + Philox4x32::toUniform(r.v[2 * (j % 2) + 1])};
+            }
+
+            // Sorted unique columns (repeated dims add up), then unit length like TF-IDF rows
+            std::sort(row.begin(), row.end());
+            int count = 0;
+            double norm = 0.0;
+            for (int j = 0; j < perRow; ++j) {
+                if (count > 0 && row[count - 1].first == row[j].first) row[count - 1].second += row[j].second;
+                else row[count++] = row[j];
+            }
+            for (int j = 0; j < count; ++j) norm += row[j].second * row[j].second;
+            norm = std::sqrt(norm);
+
+            int* outCols = cols.data() + static_cast<size_t>(i) * perRow;
+            double* outVals = vals.data() + static_cast<size_t>(i) * perRow;
+            for (int j = 0; j < count; ++j) {
+                outCols[j] = row[j].first;
+                outVals[j] = row[j].second / norm;
+            }
+            data.rowPtr[i + 1] = count;
+        }
+    }
+
+    for (long long i = 0; i < numPoints; ++i) data.rowPtr[i + 1] += data.rowPtr[i];
+    data.colIdx.resize(data.nnz());
+    data.values.resize(data.nnz());
+
+    #pragma omp parallel for schedule(static)
+    for (long long i = 0; i < numPoints; ++i) {
+        long long count = data.rowPtr[i + 1] - data.rowPtr[i];
+        std::copy(cols.begin() + i * perRow, cols.begin() + i * perRow + count, data.colIdx.begin() + data.rowPtr[i]);
+        std::copy(vals.begin() + i * perRow, vals.begin() + i * perRow + count, data.values.begin() + data.rowPtr[i]);
+    }
+
+    std::cout << "Generation complete! (" << data.nnz() << " nonzeros)" << std::endl;
+    return data;
+}
+
 void DataLoader::printData(const Dataset& data, int numLines) {
     int limit = std::min((int)data.size(), numLines);
     std::cout << "--- Data Sample (First " << limit << " points) ---" << std::endl;
@@ -40,8 +282,60 @@ void DataLoader::printData(const Dataset& data, int numLines) {
     std::cout << "-------------------------------------------" << std::endl;
 }
 
-//Placeholder for CSV Dataloader
+// Numbers of one line, separated by commas, semicolons or whitespace. False if anything else is in it
+static bool parseRow(const std::string& line, std::vector<double>& values) {
+    values.clear();
+    const char* p = line.c_str();
+    while (*p) {
+        if (*p == ',' || *p == ';' || std::isspace(static_cast<unsigned char>(*p))) {
+            ++p;
+            continue;
+        }
+        char* end = nullptr;
+        double v = std::strtod(p, &end);
+        if (end == p) return false;
+        values.push_back(v);
+        p = end;
+    }
+    return true;
+}
+
 Dataset DataLoader::loadFromCSV(const std::string& filename) {
-    std::cout << "[DataLoader] Loading from CSV is not fully implemented yet." << std::endl;
-    return Dataset();
+    std::ifstream file(filename);
+    if (!file) {
+        std::cerr << "Error: cannot open " << filename << std::endl;
+        return Dataset();
+    }
+    std::cout << "Loading " << filename << "..." << std::endl;
+
+    Dataset data;
+    std::string line;
+    std::vector<double> values;
+    size_t dim = 0;
+    long long lineNumber = 0;
+    bool headerSkipped = false;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        if (line.empty() || line[0] == '#') continue;
+        if (!parseRow(line, values)) {
+            if (data.empty() && !headerSkipped) {
+                headerSkipped = true;
+                continue;
+            }
+            std::cerr << "Error: " << filename << ":" << lineNumber << " is not a row of numbers." << std::endl;
+            return Dataset();
+        }
+        if (values.empty()) continue;
+        if (dim == 0) dim = values.size();
+        if (values.size() != dim) {
+            std::cerr << "Error: " << filename << ":" << lineNumber << " has " << values.size()
+                      << " values, expected " << dim << "." << std::endl;
+            return Dataset();
+        }
+        data.emplace_back(values);
+    }
+
+    computeNorms(data);
+    std::cout << "Loaded " << data.size() << " points, dim " << dim << std::endl;
+    return data;
 }
@@ -0,0 +1,90 @@
+#include "../include/distance_metrics.h"
+#include <algorithm>
+#include <omp.h>
+
+const char* metricName(DistanceMetric metric) {
+    switch (metric) {
+        case DistanceMetric::COSINE: return "cosine";
+        case DistanceMetric::MANHATTAN: return "manhattan";
+        default: return "squared-euclidean";
+    }
+}
+
+double maxDistance(DistanceMetric metric, double maxAbs, int dim) {
+    switch (metric) {
+        case DistanceMetric::COSINE: return 2.0;
+        case DistanceMetric::MANHATTAN: return 2.0 * maxAbs * dim;
+        default: return 4.0 * maxAbs * maxAbs * dim;
+    }
+}
+
+void CentroidUpdate::normalize(double* centroid, int dim) {
+    double normSq = 0.0;
+    #pragma omp simd reduction(+:normSq)
+    for (int d = 0; d < dim; ++d) normSq += centroid[d] * centroid[d];
+    if (normSq <= 0.0) return;
+
+    const double scale = 1.0 / std::sqrt(normSq);
+    for (int d = 0; d < dim; ++d) centroid[d] *= scale;
+}
+
+double CentroidUpdate::weightedMedian(std::vector<std::pair<double, double>>& values) {
+    std::sort(values.begin(), values.end());
+    double total = 0.0;
+    for (const auto& v : values) total += v.second;
+
+    double running = 0.0;
+    for (const auto& v : values) {
+        running += v.second;
+        if (running >= 0.5 * total) return v.first;
+    }
+    return values.back().first;
+}
+
+void CentroidUpdate::medians(const Dataset& data, int k, std::vector<Point>& out) {
+    const long long n = static_cast<long long>(data.size());
+    const int dim = static_cast<int>(data[0].coords.size());
+    const bool weighted = std::any_of(data.begin(), data.end(), [](const Point& p) { return p.weight != 1.0; });
+
+    // Counting sort of the point indices by cluster
+    std::vector<long long> start(k + 1, 0);
+    for (long long i = 0; i < n; ++i) {
+        if (data[i].clusterId >= 0) start[data[i].clusterId + 1]++;
+    }
+    for (int j = 0; j < k; ++j) start[j + 1] += start[j];
+    std::vector<long long> order(start[k]);
+    std::vector<long long> next(start.begin(), start.end() - 1);
+    for (long long i = 0; i < n; ++i) {
+        if (data[i].clusterId >= 0) order[next[data[i].clusterId]++] = i;
+    }
+
+    // One (cluster, dim) column per task, selection is O(members) without weights
+    #pragma omp parallel
+    {
+        std::vector<double> column;
+        std::vector<std::pair<double, double>> weightedColumn;
+
+        #pragma omp for collapse(2) schedule(dynamic, 4)
+        for (int j = 0; j < k; ++j) {
+            for (int d = 0; d < dim; ++d) {
+                const long long members = start[j + 1] - start[j];
+                if (members == 0) continue;
+
+                if (weighted) {
+                    weightedColumn.clear();
+                    for (long long m = start[j]; m < start[j + 1]; ++m) {
+                        const Point& p = data[order[m]];
+                        weightedColumn.emplace_back(p.coords[d], p.weight);
+                    }
+                    out[j].coords[d] = weightedMedian(weightedColumn);
+                } else {
+                    column.clear();
+                    for (long long m = start[j]; m < start[j + 1]; ++m) column.push_back(data[order[m]].coords[d]);
+                    auto mid = column.begin() + (members - 1) / 2;
+                    std::nth_element(column.begin(), mid, column.end());
+                    out[j].coords[d] = *mid;
+                }
+            }
+        }
+    }
+}
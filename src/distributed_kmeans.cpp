@@ -1,17 +1,20 @@
 #include "../include/distributed_kmeans.h"
+#include "../include/alloc_counter.h"
 #include <iostream>
 #include <vector>
 #include <limits>
 #include <random>
 #include <algorithm>
+#include <climits>
+#include <cmath>
 #include <iomanip>
 #include <fstream>
 
 
-DistributedKMeans::DistributedKMeans(int k, int maxIter, double threshold)
-        : k(k), maxIter(maxIter), threshold(threshold) {
-    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
-    MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+DistributedKMeans::DistributedKMeans(int k, int maxIter, double threshold, Transport& transport)
+        : k(k), maxIter(maxIter), threshold(threshold), comm(&transport) {
+    world_rank = comm->rank();
+    world_size = comm->size();
 }
 
 DistributedKMeans::~DistributedKMeans() {}
@@ -40,6 +43,15 @@ void DistributedKMeans::initializeCentroids(const Dataset& data) {
     if (world_rank == 0) {
         std::cout << "[MPI Rank 0] Initializing centroids..." << std::endl;
         centroids.clear();
+        if (!initialCentroids.empty()) {
+            if (initialCentroids.size() == static_cast<size_t>(k)
+                && initialCentroids[0].coords.size() == data[0].coords.size()) {
+                centroids = initialCentroids;
+                return;
+            }
+            std::cerr << "Warning: initial centroids do not match k/dim, using random initialization." << std::endl;
+        }
+
         std::vector<size_t> indices(data.size());
         for (size_t i = 0; i < indices.size(); ++i) indices[i] = i;
 
@@ -53,29 +65,358 @@ void DistributedKMeans::initializeCentroids(const Dataset& data) {
     }
 }
 
-int DistributedKMeans::run(Dataset& data) {
+double DistributedKMeans::sampledSilhouette(const Dataset& local_data, int n_points, int dim) {
+    // Each rank contributes a share of the sample proportional to its part of the data
+    int local_n = static_cast<int>(local_data.size());
+    int local_s = n_points > 0 ? static_cast<int>(static_cast<long long>(silhouetteSample) * local_n / n_points) : 0;
+    local_s = std::min(local_s, local_n);
+
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::vector<int> indices(local_n);
+    for (int i = 0; i < local_n; ++i) indices[i] = i;
+
+    std::vector<double> local_flat(static_cast<size_t>(local_s) * dim);
+    std::vector<int> local_labels(local_s);
+    for (int i = 0; i < local_s; ++i) {
+        std::uniform_int_distribution<int> pick(i, local_n - 1);
+        std::swap(indices[i], indices[pick(gen)]);
+        const Point& p = local_data[indices[i]];
+        std::copy(p.coords.begin(), p.coords.end(), local_flat.begin() + static_cast<size_t>(i) * dim);
+        local_labels[i] = p.clusterId;
+    }
+
+    std::vector<int> sample_counts(world_size), sample_displs(world_size);
+    comm->allgather(&local_s, 1, CommDatatype::INT, sample_counts.data());
+
+    int total_s = 0;
+    std::vector<int> coord_counts(world_size), coord_displs(world_size);
+    if (world_rank == 0) {
+        for (int i = 0; i < world_size; ++i) {
+            sample_displs[i] = total_s;
+            coord_counts[i] = sample_counts[i] * dim;
+            coord_displs[i] = total_s * dim;
+            total_s += sample_counts[i];
+        }
+    }
+
+    std::vector<double> flat(static_cast<size_t>(total_s) * dim);
+    std::vector<int> labels(total_s);
+    comm->gatherv(local_labels.data(), local_s, CommDatatype::INT,
+                  labels.data(), sample_counts.data(), sample_displs.data(), 0);
+    comm->gatherv(local_flat.data(), local_s * dim, CommDatatype::DOUBLE,
+                  flat.data(), coord_counts.data(), coord_displs.data(), 0);
+
+    double silhouette = 0.0;
+    if (world_rank == 0) silhouette = ClusterMetrics::silhouette(flat, labels, dim, k);
+    comm->bcast(&silhouette, 1, CommDatatype::DOUBLE, 0);
+    return silhouette;
+}
+
+int DistributedKMeans::reseedEmptyClusters(const Dataset& local_data, const std::vector<int>& emptyClusters,
+                                           const std::vector<double>& clusterSSE, int dim,
+                                           std::vector<double>& flat_centroids, double& maxShift) {
+    const int numEmpty = static_cast<int>(emptyClusters.size());
+    std::vector<double> seeds(static_cast<size_t>(numEmpty) * dim, 0.0);
+    std::vector<int> found(numEmpty, 0);
+
+    if (emptyPolicy == EmptyClusterPolicy::FARTHEST_POINT) {
+        // Every rank shares its best local candidates (distance followed by coordinates)
+        const int m = std::min(numEmpty, ReseedTracker::MAX_CANDIDATES);
+        const int stride = dim + 1;
+        std::vector<ReseedCandidate> local = reseedTracker.sortedCandidates();
+        std::vector<double> send(static_cast<size_t>(m) * stride, -1.0);
+        for (int c = 0; c < m && c < static_cast<int>(local.size()); ++c) {
+            send[c * stride] = local[c].dist;
+            const auto& coords = local_data[local[c].index].coords;
+            std::copy(coords.begin(), coords.end(), send.begin() + c * stride + 1);
+        }
+
+        std::vector<double> recv(static_cast<size_t>(world_size) * m * stride);
+        comm->allgather(send.data(), m * stride, CommDatatype::DOUBLE, recv.data());
+
+        // Farthest first, rank order breaks ties so every rank picks the same points
+        std::vector<int> order(world_size * m);
+        for (int i = 0; i < static_cast<int>(order.size()); ++i) order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return recv[a * stride] > recv[b * stride]; });
+
+        for (int e = 0; e < numEmpty && e < static_cast<int>(order.size()); ++e) {
+            const double* candidate = recv.data() + static_cast<size_t>(order[e]) * stride;
+            if (candidate[0] <= 0.0) break;
+            std::copy(candidate + 1, candidate + stride, seeds.begin() + static_cast<size_t>(e) * dim);
+            found[e] = 1;
+        }
+    } else if (emptyPolicy == EmptyClusterPolicy::LARGEST_SSE) {
+        // Find which rank holds the farthest member of every cluster
+        const auto& clusterFar = reseedTracker.clusterFarthest();
+        std::vector<DoubleInt> farthest(k);
+        for (int i = 0; i < k; ++i) farthest[i] = {clusterFar[i].dist, world_rank};
+        comm->allreduce(farthest.data(), k, CommDatatype::DOUBLE_INT, CommOp::MAXLOC);
+
+        // Donors by decreasing global SSE, only the owning rank fills in the coordinates
+        std::vector<int> donors(k);
+        for (int i = 0; i < k; ++i) donors[i] = i;
+        std::sort(donors.begin(), donors.end(), [&](int a, int b) { return clusterSSE[a] > clusterSSE[b]; });
+
+        int next = 0;
+        for (int e = 0; e < numEmpty; ++e) {
+            while (next < k && farthest[donors[next]].value <= 0.0) next++;
+            if (next == k) break;
+
+            int donor = donors[next++];
+            if (farthest[donor].rank == world_rank) {
+                const auto& coords = local_data[clusterFar[donor].index].coords;
+                std::copy(coords.begin(), coords.end(), seeds.begin() + static_cast<size_t>(e) * dim);
+            }
+            found[e] = 1;
+        }
+        comm->allreduce(seeds.data(), numEmpty * dim, CommDatatype::DOUBLE, CommOp::SUM);
+    }
+
+    int reseeded = 0;
+    for (int e = 0; e < numEmpty; ++e) {
+        if (!found[e]) continue;
+
+        int cluster = emptyClusters[e];
+        const double* seed = seeds.data() + static_cast<size_t>(e) * dim;
+        double shift = 0.0;
+        for (int d = 0; d < dim; ++d) {
+            double diff = centroids[cluster].coords[d] - seed[d];
+            shift += diff * diff;
+            centroids[cluster].coords[d] = seed[d];
+            flat_centroids[cluster * dim + d] = seed[d];
+        }
+        maxShift = std::max(maxShift, shift);
+        reseeded++;
+    }
+    return reseeded;
+}
+
+void DistributedKMeans::gatherLabels(std::vector<int>& labels, std::vector<double>* distances) {
+    std::vector<int> local_labels;
+    std::vector<double> local_distances;
+    LabelWriter::extract(localData, centroids, local_labels, distances ? &local_distances : nullptr, metric);
+
+    int local_n = static_cast<int>(local_labels.size());
+    std::vector<int> counts(world_size), displs(world_size);
+    comm->allgather(&local_n, 1, CommDatatype::INT, counts.data());
+
+    if (world_rank == 0) {
+        for (int i = 1; i < world_size; ++i) displs[i] = displs[i - 1] + counts[i - 1];
+        labels.resize(totalPoints);
+        if (distances) distances->resize(totalPoints);
+    }
+
+    comm->gatherv(local_labels.data(), local_n, CommDatatype::INT,
+                  labels.data(), counts.data(), displs.data(), 0);
+    if (distances) {
+        comm->gatherv(local_distances.data(), local_n, CommDatatype::DOUBLE,
+                  distances->data(), counts.data(), displs.data(), 0);
+    }
+}
+
+bool DistributedKMeans::writeCollective(const std::string& filename, LabelFormat format,
+                                        const std::vector<int>& labels, const std::vector<double>* distances) {
+    std::vector<FileBlock> blocks;
+    LabelFileHeader h;
+    std::string text;
+
+    if (format == LabelFormat::BINARY) {
+        // Fixed-size records: every rank knows its offsets without communication
+        h = LabelWriter::makeHeader(totalPoints, 0, distances != nullptr);
+        if (world_rank == 0) blocks.push_back({0, &h, sizeof(h)});
+        long long labelsAt = static_cast<long long>(sizeof(h)) + static_cast<long long>(localOffset) * sizeof(int32_t);
+        blocks.push_back({labelsAt, labels.data(), labels.size() * sizeof(int32_t)});
+        if (distances) {
+            long long distancesAt = static_cast<long long>(h.distancesOffset) + static_cast<long long>(localOffset) * sizeof(double);
+            blocks.push_back({distancesAt, distances->data(), distances->size() * sizeof(double)});
+        }
+    } else {
+        // Variable-length rows: offsets come from the block sizes of the lower ranks
+        text = LabelWriter::formatCSV(labels.data(), distances ? distances->data() : nullptr,
+                                      labels.size(), localOffset, world_rank == 0);
+        long long size = static_cast<long long>(text.size());
+        std::vector<long long> sizes(world_size);
+        comm->allgather(&size, 1, CommDatatype::LONG_LONG, sizes.data());
+        long long offset = 0;
+        for (int r = 0; r < world_rank; ++r) offset += sizes[r];
+        blocks.push_back({offset, text.data(), text.size()});
+    }
+
+    if (!comm->writeShared(filename, blocks)) {
+        std::cerr << "[Rank " << world_rank << "] Error: failed to write label file " << filename << "." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool DistributedKMeans::writeLabels(const std::string& filename, LabelFormat format, LabelOutputMode mode,
+                                    bool withDistances) {
+    bool ok = true;
+    if (mode == LabelOutputMode::GATHER) {
+        std::vector<int> labels;
+        std::vector<double> distances;
+        gatherLabels(labels, withDistances ? &distances : nullptr);
+        if (world_rank == 0) {
+            ok = LabelWriter::write(filename, format, labels.data(), withDistances ? distances.data() : nullptr,
+                                    labels.size());
+        }
+    } else {
+        std::vector<int> labels;
+        std::vector<double> distances;
+        LabelWriter::extract(localData, centroids, labels, withDistances ? &distances : nullptr, metric);
+        if (mode == LabelOutputMode::SHARDED) {
+            ok = LabelWriter::write(filename + ".rank" + std::to_string(world_rank), format, labels.data(),
+                                    withDistances ? distances.data() : nullptr, labels.size(), localOffset);
+        } else {
+            ok = writeCollective(filename, format, labels, withDistances ? &distances : nullptr);
+        }
+    }
+
+    int allOk = ok ? 1 : 0;
+    comm->allreduce(&allOk, 1, CommDatatype::INT, CommOp::MIN);
+    return allOk == 1;
+}
+
+void DistributedKMeans::combineMedians(const Dataset& local_data, int dim, std::vector<double>& medians) {
+    // Local medians start from the current centroids, so clusters without local points stay defined
+    std::vector<Point> local = centroids;
+    if (!local_data.empty()) CentroidUpdate::medians(local_data, k, local);
+
+    // Every rank sends its k * dim medians followed by its k local cluster weights
+    const int stride = k * dim + k;
+    std::vector<double> send(stride);
+    for (int j = 0; j < k; ++j) std::copy(local[j].coords.begin(), local[j].coords.end(), send.begin() + j * dim);
+    const int folds = workspace.sumFolds();
+    for (int j = 0; j < k; ++j) {
+        const double* weight = workspace.weights(0) + j * folds;
+        send[k * dim + j] = folds > 1 ? ReproducibleSum::value(weight) : weight[0];
+    }
+    std::vector<double> recv(static_cast<size_t>(world_size) * stride);
+    comm->allgather(send.data(), stride, CommDatatype::DOUBLE, recv.data());
+
+    medians.resize(static_cast<size_t>(k) * dim);
+    std::vector<std::pair<double, double>> values;
+    for (int j = 0; j < k; ++j) {
+        for (int d = 0; d < dim; ++d) {
+            values.clear();
+            for (int r = 0; r < world_size; ++r) {
+                const double* row = recv.data() + static_cast<size_t>(r) * stride;
+                if (row[k * dim + j] > 0.0) values.emplace_back(row[j * dim + d], row[k * dim + j]);
+            }
+            medians[j * dim + d] = values.empty() ? centroids[j].coords[d] : CentroidUpdate::weightedMedian(values);
+        }
+    }
+}
+
+// Assignment and local sums over this rank's points, compiled once per metric
+template <class Metric>
+void DistributedKMeans::assignLocal(Dataset& local_data, const double* flat_centroids, const double* centroid_norms, int dim) {
+    double* local_sums = workspace.sums(0);
+    double* local_sse = workspace.sse(0);
+    double* local_weight = workspace.weights(0);
+    int* local_counts = workspace.workerCounts(0);
+
+    bool useTree = Metric::supportsKDTree && CentroidKDTree::isBeneficial(k, dim);
+    if (useTree) centroidTree.build(flat_centroids, k, dim);
+    const bool useNorms = !useTree && Metric::id == DistanceMetric::SQUARED_EUCLIDEAN;
+
+    reseedTracker.reset(emptyPolicy, k);
+
+    for (int idx = 0; idx < static_cast<int>(local_data.size()); ++idx) {
+        Point& p = local_data[idx];
+        double minDist = std::numeric_limits<double>::max();
+        int bestCluster = -1;
+
+        if (useTree) {
+            bestCluster = centroidTree.nearest(p.coords.data(), minDist);
+        } else if (useNorms) {
+            bestCluster = nearestCentroidByNorms(p.coords.data(), p.normSq, flat_centroids, centroid_norms, k, dim, minDist);
+        } else {
+            for (int j = 0; j < k; ++j) {
+                // Inlined kernel of the metric
+                double dist = Metric::distance(p.coords.data(), flat_centroids + j * dim, dim);
+
+                if (dist < minDist) {
+                    minDist = dist;
+                    bestCluster = j;
+                }
+            }
+        }
+        p.clusterId = bestCluster;
+
+        local_counts[bestCluster]++;
+        reseedTracker.observe(minDist, idx, bestCluster);
+        if (reproducible) {
+            constexpr int F = ReproducibleSum::FOLDS;
+            weightSum.deposit(local_weight + bestCluster * F, p.weight);
+            sseSum.deposit(local_sse + bestCluster * F, p.weight * minDist);
+            double* row = local_sums + static_cast<size_t>(bestCluster) * dim * F;
+            for (int d = 0; d < dim; ++d) coordSum.deposit(row + d * F, p.weight * p.coords[d]);
+            continue;
+        }
+        local_weight[bestCluster] += p.weight;
+        local_sse[bestCluster] += p.weight * minDist;
+        for (int d = 0; d < dim; ++d) {
+            local_sums[bestCluster * dim + d] += p.weight * p.coords[d];
+        }
+    }
+}
+
+void DistributedKMeans::configureSums(const Dataset& local_data, int n_points, int dim) {
+    // Rank 0 adds the initial centroids, which may lie outside the data
+    double bounds[2] = {0.0, 0.0};  // largest |coordinate|, largest weight
+    for (const auto& p : local_data) {
+        for (double x : p.coords) bounds[0] = std::max(bounds[0], std::abs(x));
+        bounds[1] = std::max(bounds[1], std::abs(p.weight));
+    }
+    if (world_rank == 0) {
+        for (const auto& c : centroids) {
+            for (double x : c.coords) bounds[0] = std::max(bounds[0], std::abs(x));
+        }
+    }
+    comm->allreduce(bounds, 2, CommDatatype::DOUBLE, CommOp::MAX);
+
+    coordSum.configure(bounds[1] * bounds[0], n_points);
+    weightSum.configure(bounds[1], n_points);
+    sseSum.configure(bounds[1] * maxDistance(metric, bounds[0], dim), n_points);
+}
+
+KMeansResult DistributedKMeans::run(Dataset& data) {
     logs.clear();
+    result = KMeansResult();
 
     int n_points = 0;
     int dim = 0;
+    int weighted = 0; // weights are only scattered when some point is not 1.0
 
     // Data setup
-    double t_start = MPI_Wtime();
+    double t_start = comm->wtime();
 
     if (world_rank == 0) {
         if (!data.empty()) {
             n_points = static_cast<int>(data.size());
             dim = static_cast<int>(data[0].coords.size());
+            for (const auto& p : data) {
+                if (p.weight != 1.0) {
+                    weighted = 1;
+                    break;
+                }
+            }
             initializeCentroids(data);
+            if (metric == DistanceMetric::COSINE) {
+                for (auto& c : centroids) CentroidUpdate::normalize(c.coords.data(), dim);
+            }
         }
     }
-    // addLog(t_start, MPI_Wtime(), COMP, "InitLocal");
+    // addLog(t_start, comm->wtime(), COMP, "InitLocal");
 
     // Metadata transmission
-    double t_comm = MPI_Wtime();
-    MPI_Bcast(&n_points, 1, MPI_INT, 0, MPI_COMM_WORLD);
-    MPI_Bcast(&dim, 1, MPI_INT, 0, MPI_COMM_WORLD);
-    addLog(t_comm, MPI_Wtime(), COMM, "MetaBcast");
+    double t_comm = comm->wtime();
+    comm->bcast(&n_points, 1, CommDatatype::INT, 0);
+    comm->bcast(&dim, 1, CommDatatype::INT, 0);
+    comm->bcast(&weighted, 1, CommDatatype::INT, 0);
+    addLog(t_comm, comm->wtime(), COMM, "MetaBcast");
 
     std::vector<int> send_counts(world_size);
     std::vector<int> displs(world_size);
@@ -89,6 +430,8 @@ int DistributedKMeans::run(Dataset& data) {
     }
 
     int local_n = send_counts[world_rank];
+    localOffset = displs[world_rank];
+    totalPoints = n_points;
 
     // Prepare the buffers
     std::vector<double> global_flat_data;
@@ -111,30 +454,42 @@ int DistributedKMeans::run(Dataset& data) {
     }
 
     // Sending data
-    t_comm = MPI_Wtime();
+    t_comm = comm->wtime();
 
     double* sendbuf = (world_rank == 0) ? global_flat_data.data() : nullptr;
-    MPI_Scatterv(
-            sendbuf, send_counts_doubles.data(), displs_doubles.data(), MPI_DOUBLE,
-            local_flat_data.data(), local_n * dim, MPI_DOUBLE,
-            0, MPI_COMM_WORLD
-    );
-    addLog(t_comm, MPI_Wtime(), COMM, "ScatterData");
+    comm->scatterv(sendbuf, send_counts_doubles.data(), displs_doubles.data(), CommDatatype::DOUBLE,
+                   local_flat_data.data(), local_n * dim, 0);
+    std::vector<double> local_weights;
+    if (weighted) {
+        std::vector<double> global_weights;
+        if (world_rank == 0) {
+            global_weights.resize(n_points);
+            for (int i = 0; i < n_points; ++i) global_weights[i] = data[i].weight;
+        }
+        local_weights.resize(local_n);
+        comm->scatterv(world_rank == 0 ? global_weights.data() : nullptr, send_counts.data(), displs.data(), CommDatatype::DOUBLE,
+                   local_weights.data(), local_n, 0);
+    }
+    addLog(t_comm, comm->wtime(), COMM, "ScatterData");
 
     // Creating Point objects
-    double t_comp = MPI_Wtime();
-    Dataset local_data(local_n);
+    double t_comp = comm->wtime();
+    // Kept after the run, labels are written from here
+    Dataset& local_data = localData;
+    local_data.assign(local_n, Point());
     for (int i = 0; i < local_n; ++i) {
         std::vector<double> coords(dim);
         for (int d = 0; d < dim; ++d) {
             coords[d] = local_flat_data[i * dim + d];
         }
-        local_data[i] = Point(coords);
+        local_data[i] = Point(coords, weighted ? local_weights[i] : 1.0);
+        local_data[i].normSq = dotProduct(coords.data(), coords.data(), dim);
     }
-    addLog(t_comp, MPI_Wtime(), COMP, "RebuildData");
+    addLog(t_comp, comm->wtime(), COMP, "RebuildData");
 
     //Main loop setup
     std::vector<double> flat_centroids(k * dim);
+    std::vector<double> centroid_norms(k);     // ||c_j||^2 for the squared euclidean scan
     if (world_rank == 0) {
         for (int i = 0; i < k; ++i) {
             for (int d = 0; d < dim; ++d) {
@@ -146,17 +501,57 @@ int DistributedKMeans::run(Dataset& data) {
         for(int i=0; i<k; ++i) centroids[i].coords.resize(dim);
     }
 
+    // Reproducible sums need the exact exchange, the accumulators reduce like any other doubles
+    const CommCompression sumsCompression = reproducible ? CommCompression::NONE : compression;
+    const int folds = reproducible ? ReproducibleSum::FOLDS : 1;
+    if (world_rank == 0 && reproducible) {
+        if (compression != CommCompression::NONE) std::cerr << "Warning: compression is not used with reproducible sums." << std::endl;
+        if (metric == DistanceMetric::MANHATTAN) std::cerr << "Warning: k-medians results still depend on the number of ranks." << std::endl;
+    }
+    if (reproducible) configureSums(local_data, n_points, dim);
+
+    // All per-iteration buffers are sized here, once
+    workspace.prepare(1, k, dim, emptyPolicy, folds);
+    if (hierarchical) nodeReducer.prepare(*comm, workspace.rowSize() * sizeof(double), ranksPerNode);
+    exchange.prepare(sumsCompression, k, dim * folds, 2 * k * folds, hierarchical ? &nodeReducer : nullptr);
+    commBytes = 0;
+    std::vector<double> medians;    // k-medians only
+    logs.reserve(logs.size() + 4 * static_cast<size_t>(maxIter) + 8);
+
     int iter = 0;
     bool converged = false;
+    bool confirming = false;        // FLOAT32_DELTA: exact pass after approximate convergence
+    long long allocsAfterFirst = 0;
+    reductionWait = 0.0;
+
+    const bool stale = staleness > 0 && metric != DistanceMetric::MANHATTAN && !reproducible;
+    if (world_rank == 0 && staleness > 0) {
+        if (reproducible) std::cerr << "Warning: reproducible sums need the synchronous loop, staleness ignored." << std::endl;
+        else if (!stale) std::cerr << "Warning: k-medians needs the synchronous loop, staleness ignored." << std::endl;
+        else if (compression != CommCompression::NONE || hierarchical) {
+            std::cerr << "Warning: compression and hierarchical reductions are not used in stale-synchronous mode." << std::endl;
+        }
+    }
+    if (stale) iter = runStaleSynchronous(local_data, flat_centroids, centroid_norms, dim, converged, allocsAfterFirst);
 
     // Main loop
-    while (iter < maxIter && !converged) {
+    while (!stale && iter < maxIter && !converged) {
+        // The first iteration may still grow buffers, everything after it must not allocate
+        if (iter == 1) allocsAfterFirst = AllocCounter::threadCount();
+        // With compression every rank applies the same update to the same reduced sums,
+        // so the centroids only come from rank 0 once
+        const bool broadcast = sumsCompression == CommCompression::NONE || iter == 0;
+        const bool exactPass = sumsCompression == CommCompression::FLOAT32_DELTA && (confirming || iter == maxIter - 1);
+
         // Bcast Centroids (COMM)
-        t_comm = MPI_Wtime();
-        MPI_Bcast(flat_centroids.data(), k * dim, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-        addLog(t_comm, MPI_Wtime(), COMM, "BcastCentr");
+        t_comm = comm->wtime();
+        if (broadcast) {
+            comm->bcast(flat_centroids.data(), k * dim, CommDatatype::DOUBLE, 0);
+            commBytes += static_cast<long long>(k) * dim * sizeof(double);
+        }
+        addLog(t_comm, comm->wtime(), COMM, "BcastCentr");
 
-        if (world_rank != 0) {
+        if (broadcast && world_rank != 0) {
             for (int i = 0; i < k; ++i) {
                 for (int d = 0; d < dim; ++d) {
                     centroids[i].coords[d] = flat_centroids[i * dim + d];
@@ -165,81 +560,463 @@ int DistributedKMeans::run(Dataset& data) {
         }
 
         // Local computing
-        t_comp = MPI_Wtime();
-        std::vector<double> local_sums(k * dim, 0.0);
-        std::vector<int> local_counts(k, 0);
-
-        for (auto& p : local_data) {
-            double minDist = std::numeric_limits<double>::max();
-            int bestCluster = -1;
+        t_comp = comm->wtime();
+        // Centroids are final here on every rank (broadcast, or updated in place from the same sums)
+        if (metric == DistanceMetric::SQUARED_EUCLIDEAN) rowNorms(flat_centroids.data(), k, dim, centroid_norms.data());
+        // Per-cluster SSE and weight ride at the end of the sums row, so they share the existing Allreduce
+        workspace.resetSums();
+        workspace.resetAssignment(emptyPolicy);
+        withMetric(metric, [&](auto policy) {
+            assignLocal<decltype(policy)>(local_data, flat_centroids.data(), centroid_norms.data(), dim);
+        });
+        addLog(t_comp, comm->wtime(), COMP, "CalcLocal"); // Zielony pasek na wykresie
 
-            for (int j = 0; j < k; ++j) {
-                // Inline distance calculation for speed
-                double dist = 0.0;
-                for(int d=0; d<dim; ++d) {
-                    double diff = p.coords[d] - centroids[j].coords[d];
-                    dist += diff * diff;
-                }
+        // Global reduction
+        t_comm = comm->wtime();
+        std::vector<double>& global_sums = workspace.reducedRow;
+        std::vector<int>& global_counts = workspace.reducedCounts;
+
+        exchange.reduce(workspace.sums(0), global_sums.data(), exactPass, *comm);
+        exchange.reduceCounts(workspace.workerCounts(0), global_counts.data(), k, *comm);
+        workspace.collapseReduced();
+        reductionWait += comm->wtime() - t_comm;
+        addLog(t_comm, comm->wtime(), COMM, "AllReduce"); // Czerwony pasek
+
+        // Update, written in place into the broadcast buffer and the centroid points
+        t_comp = comm->wtime();
+        if (metric == DistanceMetric::MANHATTAN) combineMedians(local_data, dim, medians);
+        double maxShift = 0.0;
+        const double* global_weight = global_sums.data() + k * dim + k;
+        std::vector<int>& emptyClusters = workspace.emptyClusters;
+        emptyClusters.clear();
+        for (int i = 0; i < k; ++i) {
+            if (global_weight[i] <= 0.0) {
+                emptyClusters.push_back(i);
+                continue;
+            }
 
-                if (dist < minDist) {
-                    minDist = dist;
-                    bestCluster = j;
-                }
+            double* updated = flat_centroids.data() + i * dim;
+            for (int d = 0; d < dim; ++d) {
+                updated[d] = metric == DistanceMetric::MANHATTAN ? medians[i * dim + d]
+                                                                  : global_sums[i * dim + d] / global_weight[i];
             }
-            p.clusterId = bestCluster;
+            if (metric == DistanceMetric::COSINE) CentroidUpdate::normalize(updated, dim);
 
-            local_counts[bestCluster]++;
+            double shift = 0.0;
             for (int d = 0; d < dim; ++d) {
-                local_sums[bestCluster * dim + d] += p.coords[d];
+                double diff = centroids[i].coords[d] - updated[d];
+                shift += diff * diff;
+                centroids[i].coords[d] = updated[d];
+            }
+            if (shift > maxShift) maxShift = shift;
+        }
+        result.clusterSizes.assign(global_counts.begin(), global_counts.end());
+        result.clusterSSE.assign(global_sums.begin() + k * dim, global_sums.begin() + k * dim + k);
+
+        // Same empty list on every rank (global counts), so all ranks enter the collectives together
+        if (!emptyClusters.empty() && reseedTracker.active()) {
+            result.reseededClusters += reseedEmptyClusters(local_data, emptyClusters, result.clusterSSE, dim, flat_centroids, maxShift);
+            if (metric == DistanceMetric::COSINE) {
+                for (int i : emptyClusters) {
+                    CentroidUpdate::normalize(flat_centroids.data() + i * dim, dim);
+                    std::copy(flat_centroids.begin() + i * dim, flat_centroids.begin() + (i + 1) * dim, centroids[i].coords.begin());
+                }
             }
         }
-        addLog(t_comp, MPI_Wtime(), COMP, "CalcLocal"); // Zielony pasek na wykresie
 
-        // Global reduction
-        t_comm = MPI_Wtime();
-        std::vector<double> global_sums(k * dim);
-        std::vector<int> global_counts(k);
+        if (maxShift < threshold * threshold) {
+            // Float32 sums are approximate, one exact pass has to agree before stopping
+            if (sumsCompression == CommCompression::FLOAT32_DELTA && !exactPass) confirming = true;
+            else converged = true;
+        } else {
+            confirming = false;
+        }
+        addLog(t_comp, comm->wtime(), COMP, "Update");
 
-        MPI_Allreduce(local_sums.data(), global_sums.data(), k * dim, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
-        MPI_Allreduce(local_counts.data(), global_counts.data(), k, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
-        addLog(t_comm, MPI_Wtime(), COMM, "AllReduce"); // Czerwony pasek
+        iter++;
+    }
+    steadyStateAllocations = iter > 1 ? AllocCounter::threadCount() - allocsAfterFirst : 0;
+    commBytes += exchange.bytesSent();
+
+    result.iterations = iter;
+    result.converged = converged;
+    result.inertia = 0.0;
+    for (double s : result.clusterSSE) result.inertia += s;
+    if (silhouetteSample > 0) {
+        result.silhouette = sampledSilhouette(local_data, n_points, dim);
+    }
 
-        // Update
-        t_comp = MPI_Wtime();
-        double maxShift = 0.0;
-        for (int i = 0; i < k; ++i) {
-            if (global_counts[i] == 0) continue;
+    trainingInfo = ModelMetadata();
+    trainingInfo.numPoints = n_points;
+    trainingInfo.iterations = iter;
+    trainingInfo.inertia = result.inertia;
+    trainingInfo.metric = metric;
 
-            Point newCentroid;
-            newCentroid.coords.resize(dim);
+    // Save logs
+    saveLogsToCSV();
+    return result;
+}
 
-            for (int d = 0; d < dim; ++d) {
-                newCentroid.coords[d] = global_sums[i * dim + d] / global_counts[i];
-            }
+int DistributedKMeans::runStaleSynchronous(Dataset& local_data, std::vector<double>& flat_centroids,
+                                           std::vector<double>& centroid_norms, int dim, bool& converged,
+                                           long long& allocsAfterFirst) {
+    // One message per iteration: the sums row, the counts as doubles (exact below 2^53) and per rank
+    // the version of the centroids it used (number of results applied). A slot is reused only
+    // after its reduction has been applied, which the staleness bound guarantees
+    const int rowSize = workspace.rowSize();
+    const int messageSize = rowSize + k + world_size;
+    const int slots = staleness + 1;
+    const size_t centroidSize = static_cast<size_t>(k) * dim;
+    std::vector<double> outgoing(static_cast<size_t>(slots) * messageSize, 0.0);
+    std::vector<double> incoming(outgoing.size());
+    std::vector<CommRequest> requests(slots);
+    // The last staleness + 2 versions, iteration r used one of versions r - staleness .. r
+    std::vector<double> history((staleness + 2) * centroidSize);
+
+    double t_comm = comm->wtime();
+    comm->bcast(flat_centroids.data(), k * dim, CommDatatype::DOUBLE, 0);
+    commBytes += static_cast<long long>(centroidSize * sizeof(double));
+    if (world_rank != 0) {
+        for (int i = 0; i < k; ++i) std::copy(flat_centroids.begin() + i * dim, flat_centroids.begin() + (i + 1) * dim, centroids[i].coords.begin());
+    }
+    std::copy(flat_centroids.begin(), flat_centroids.end(), history.begin());
+    addLog(t_comm, comm->wtime(), COMM, "BcastCentr");
+
+    long long started = 0;
+    long long applied = 0;          // also the version of flat_centroids
+    int stopAfter = maxIter;
+    int syncFrom = maxIter;         // first iteration that waits for the previous result
+    double bestShift = std::numeric_limits<double>::max();
+    int sinceBest = 0;
+    converged = false;
+    result.clusterSizes.assign(k, 0);
+
+    // Results are applied in order, so every rank moves through the same versions of the centroids
+    // and takes the same decisions (they depend on r and the reduced message only)
+    auto apply = [&](long long r) {
+        const double* sums = incoming.data() + static_cast<size_t>(r % slots) * messageSize;
+        const double* weight = sums + k * dim + k;
+        for (int i = 0; i < k; ++i) {
+            if (weight[i] <= 0.0) continue;
+            double* updated = flat_centroids.data() + i * dim;
+            for (int d = 0; d < dim; ++d) updated[d] = sums[i * dim + d] / weight[i];
+            if (metric == DistanceMetric::COSINE) CentroidUpdate::normalize(updated, dim);
+            std::copy(updated, updated + dim, centroids[i].coords.begin());
+        }
+        for (int i = 0; i < k; ++i) result.clusterSizes[i] = static_cast<int>(sums[rowSize + i]);
+        result.clusterSSE.assign(sums + k * dim, sums + k * dim + k);
 
-            // Simple distance check
-            double shift = 0.0;
-            for(int d=0; d<dim; ++d) {
-                double diff = centroids[i].coords[d] - newCentroid.coords[d];
-                shift += diff * diff;
+        // Shift against every version the ranks computed this result from: below the threshold
+        // the result reproduces its own inputs, as in the synchronous loop
+        double maxShift = 0.0;
+        const double* versions = sums + rowSize + k;
+        for (int rank = 0; rank < world_size; ++rank) {
+            const long long version = static_cast<long long>(versions[rank]);
+            const double* used = history.data() + static_cast<size_t>(version % (staleness + 2)) * centroidSize;
+            for (int i = 0; i < k; ++i) {
+                maxShift = std::max(maxShift, squaredDistance(used + i * dim, flat_centroids.data() + i * dim, dim));
             }
-            if (shift > maxShift) maxShift = shift;
+        }
+        std::copy(flat_centroids.begin(), flat_centroids.end(),
+                  history.begin() + static_cast<size_t>((r + 1) % (staleness + 2)) * centroidSize);
+
+        // Every rank has seen reduction r by iteration r + 1 + lag at the latest
+        const int lag = r >= syncFrom ? 0 : staleness;
+        if (!converged && maxShift < threshold * threshold) {
+            converged = true;
+            stopAfter = static_cast<int>(std::min<long long>(stopAfter, r + 1 + lag));
+        }
+
+        // Ranks on different versions keep moving border points back and forth, so the shifts of a
+        // stale run level off, possibly above a tight threshold. Once they stop improving the run
+        // finishes bulk synchronously
+        if (maxShift < bestShift) {
+            bestShift = maxShift;
+            sinceBest = 0;
+        } else if (++sinceBest >= 2 * (staleness + 1) && syncFrom == maxIter) {
+            syncFrom = static_cast<int>(std::min<long long>(maxIter, r + 1 + staleness));
+        }
+    };
+
+    int iter = 0;
+    for (; iter < stopAfter; ++iter) {
+        if (iter == 1) allocsAfterFirst = AllocCounter::threadCount();
+
+        // Bounded staleness: the reduction of iteration iter - 1 - lag has to be in,
+        // anything newer that already arrived is used too
+        const int lag = iter >= syncFrom ? 0 : staleness;
+        t_comm = comm->wtime();
+        while (applied < started && applied <= iter - 1 - lag) {
+            comm->wait(requests[applied % slots]);
+            apply(applied++);
+        }
+        while (applied < started && comm->test(requests[applied % slots])) apply(applied++);
+        reductionWait += comm->wtime() - t_comm;
+        addLog(t_comm, comm->wtime(), COMM, "WaitStale");
+        if (iter >= stopAfter) break;
+
+        double t_comp = comm->wtime();
+        if (metric == DistanceMetric::SQUARED_EUCLIDEAN) rowNorms(flat_centroids.data(), k, dim, centroid_norms.data());
+        workspace.resetSums();
+        workspace.resetAssignment(emptyPolicy);
+        withMetric(metric, [&](auto policy) {
+            assignLocal<decltype(policy)>(local_data, flat_centroids.data(), centroid_norms.data(), dim);
+        });
+        double* message = outgoing.data() + static_cast<size_t>(iter % slots) * messageSize;
+        std::copy(workspace.sums(0), workspace.sums(0) + rowSize, message);
+        const int* counts = workspace.workerCounts(0);
+        for (int i = 0; i < k; ++i) message[rowSize + i] = counts[i];
+        message[rowSize + k + world_rank] = static_cast<double>(applied);
+        addLog(t_comp, comm->wtime(), COMP, "CalcLocal");
+
+        t_comm = comm->wtime();
+        requests[iter % slots] = comm->iallreduce(message, incoming.data() + static_cast<size_t>(iter % slots) * messageSize,
+                                                  messageSize, CommDatatype::DOUBLE, CommOp::SUM);
+        started++;
+        commBytes += static_cast<long long>(messageSize) * sizeof(double);
+        addLog(t_comm, comm->wtime(), COMM, "Iallreduce");
+    }
+
+    // Every rank started the same reductions, the last one gives the final centroids
+    t_comm = comm->wtime();
+    while (applied < started) {
+        comm->wait(requests[applied % slots]);
+        apply(applied++);
+    }
+    reductionWait += comm->wtime() - t_comm;
+    addLog(t_comm, comm->wtime(), COMM, "WaitStale");
+    return iter;
+}
+
+int DistributedKMeans::reseedSparse(const SparseDataset& local_data, const std::vector<int>& emptyClusters, int dim,
+                                    double* rows, double& maxShift) {
+    const int numEmpty = static_cast<int>(emptyClusters.size());
+    const int m = std::min(numEmpty, ReseedTracker::MAX_CANDIDATES);
+
+    // Only (distance, global row) travels, the owner of a chosen row densifies it
+    std::vector<ReseedCandidate> local = reseedTracker.sortedCandidates();
+    std::vector<double> send(2 * static_cast<size_t>(m), -1.0);
+    for (int c = 0; c < m && c < static_cast<int>(local.size()); ++c) {
+        send[2 * c] = local[c].dist;
+        send[2 * c + 1] = static_cast<double>(localOffset + local[c].index);
+    }
+    std::vector<double> recv(2 * static_cast<size_t>(world_size) * m);
+    comm->allgather(send.data(), 2 * m, CommDatatype::DOUBLE, recv.data());
+
+    std::vector<int> order(world_size * m);
+    for (int i = 0; i < static_cast<int>(order.size()); ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return recv[2 * a] > recv[2 * b]; });
+
+    std::vector<double> seeds(static_cast<size_t>(numEmpty) * dim, 0.0);
+    int found = 0;
+    for (; found < numEmpty && found < static_cast<int>(order.size()); ++found) {
+        const double* candidate = recv.data() + 2 * static_cast<size_t>(order[found]);
+        if (candidate[0] <= 0.0) break;
+        long long row = static_cast<long long>(candidate[1]) - localOffset;
+        if (row >= 0 && row < local_data.numRows()) {
+            local_data.densifyRow(row, seeds.data() + static_cast<size_t>(found) * dim);
+        }
+    }
+    comm->allreduce(seeds.data(), found * dim, CommDatatype::DOUBLE, CommOp::SUM);
+
+    for (int e = 0; e < found; ++e) {
+        double* centroid = rows + static_cast<size_t>(emptyClusters[e]) * dim;
+        const double* seed = seeds.data() + static_cast<size_t>(e) * dim;
+        double shift = 0.0;
+        for (int d = 0; d < dim; ++d) {
+            double diff = centroid[d] - seed[d];
+            shift += diff * diff;
+            centroid[d] = seed[d];
+        }
+        maxShift = std::max(maxShift, shift);
+    }
+    return found;
+}
 
-            centroids[i] = newCentroid;
-            for(int d=0; d<dim; ++d) {
-                flat_centroids[i * dim + d] = newCentroid.coords[d];
+KMeansResult DistributedKMeans::run(SparseDataset& data) {
+    logs.clear();
+    result = KMeansResult();
+
+    long long shape[2] = {0, 0};    // rows, nonzeros
+    int dim = 0;
+    int weighted = 0;
+
+    if (world_rank == 0) {
+        shape[0] = data.numRows();
+        shape[1] = data.nnz();
+        dim = data.dim;
+        weighted = data.weights.empty() ? 0 : 1;
+    }
+
+    double t_comm = comm->wtime();
+    comm->bcast(shape, 2, CommDatatype::LONG_LONG, 0);
+    comm->bcast(&dim, 1, CommDatatype::INT, 0);
+    comm->bcast(&weighted, 1, CommDatatype::INT, 0);
+    addLog(t_comm, comm->wtime(), COMM, "MetaBcast");
+    const long long n_points = shape[0];
+
+    if (n_points <= 0 || dim <= 0 || k <= 0 || n_points < k) {
+        if (world_rank == 0) std::cerr << "Invalid sparse data or k parameter." << std::endl;
+        return result;
+    }
+    // Scatterv counts and displacements are int
+    if (n_points > INT_MAX || shape[1] > INT_MAX) {
+        if (world_rank == 0) {
+            std::cerr << "Error: sparse input with " << n_points << " rows and " << shape[1]
+                      << " nonzeros exceeds the " << INT_MAX << " elements a scatter can address." << std::endl;
+        }
+        return result;
+    }
+    DistanceMetric sparseMetric = metric;
+    if (metric == DistanceMetric::MANHATTAN) {
+        if (world_rank == 0) std::cerr << "Warning: manhattan distance is not supported on sparse data, using squared euclidean." << std::endl;
+        sparseMetric = DistanceMetric::SQUARED_EUCLIDEAN;
+    }
+
+    // Same row split as the dense path, the nonzero counts follow from rowPtr
+    std::vector<int> send_counts(world_size), displs(world_size);
+    std::vector<int> nnz_counts(world_size), nnz_displs(world_size);
+    for (int i = 0; i < world_size; ++i) {
+        send_counts[i] = static_cast<int>(n_points / world_size + (i < n_points % world_size ? 1 : 0));
+        displs[i] = (i == 0) ? 0 : displs[i - 1] + send_counts[i - 1];
+    }
+    std::vector<int> row_lengths;
+    if (world_rank == 0) {
+        row_lengths.resize(n_points);
+        for (long long r = 0; r < n_points; ++r) row_lengths[r] = static_cast<int>(data.rowPtr[r + 1] - data.rowPtr[r]);
+        for (int i = 0; i < world_size; ++i) {
+            nnz_displs[i] = static_cast<int>(data.rowPtr[displs[i]]);
+            nnz_counts[i] = static_cast<int>(data.rowPtr[displs[i] + send_counts[i]] - data.rowPtr[displs[i]]);
+        }
+    }
+
+    const int local_n = send_counts[world_rank];
+    localOffset = displs[world_rank];
+    totalPoints = static_cast<int>(n_points);
+
+    t_comm = comm->wtime();
+    SparseDataset local;
+    local.dim = dim;
+    std::vector<int> local_lengths(local_n);
+    comm->scatterv(row_lengths.data(), send_counts.data(), displs.data(), CommDatatype::INT,
+                   local_lengths.data(), local_n, 0);
+    local.rowPtr.assign(local_n + 1, 0);
+    for (int r = 0; r < local_n; ++r) local.rowPtr[r + 1] = local.rowPtr[r] + local_lengths[r];
+
+    const int local_nnz = static_cast<int>(local.rowPtr[local_n]);
+    local.colIdx.resize(local_nnz);
+    local.values.resize(local_nnz);
+    comm->scatterv(world_rank == 0 ? data.colIdx.data() : nullptr, nnz_counts.data(), nnz_displs.data(), CommDatatype::INT,
+                   local.colIdx.data(), local_nnz, 0);
+    comm->scatterv(world_rank == 0 ? data.values.data() : nullptr, nnz_counts.data(), nnz_displs.data(), CommDatatype::DOUBLE,
+                   local.values.data(), local_nnz, 0);
+    if (weighted) {
+        local.weights.resize(local_n);
+        comm->scatterv(world_rank == 0 ? data.weights.data() : nullptr, send_counts.data(), displs.data(), CommDatatype::DOUBLE,
+                   local.weights.data(), local_n, 0);
+    }
+    addLog(t_comm, comm->wtime(), COMM, "ScatterData");
+
+    double t_comp = comm->wtime();
+    local.computeNorms();
+    SparseCentroids current;
+    current.resize(k, dim);
+    if (world_rank == 0) {
+        std::cout << "[MPI Rank 0] Initializing centroids (sparse)..." << std::endl;
+        if (reproducible) std::cerr << "Warning: reproducible sums are not implemented for sparse data." << std::endl;
+        SparseKMeansOps::initialize(data, initialCentroids, current);
+        if (sparseMetric == DistanceMetric::COSINE) {
+            for (int j = 0; j < k; ++j) CentroidUpdate::normalize(current.rows.data() + static_cast<size_t>(j) * dim, dim);
+        }
+    }
+    addLog(t_comp, comm->wtime(), COMP, "RebuildData");
+
+    // Every rank applies the same update to the same reduced sums, so the centroids are
+    // broadcast once instead of every iteration (k * dim is large for sparse data)
+    t_comm = comm->wtime();
+    comm->bcast(current.rows.data(), k * dim, CommDatatype::DOUBLE, 0);
+    current.refresh();
+    addLog(t_comm, comm->wtime(), COMM, "BcastCentr");
+
+    // Sums | SSE | weights in one row, reduced by a single Allreduce like the dense path
+    const size_t rowSize = static_cast<size_t>(k) * dim + 2 * static_cast<size_t>(k);
+    std::vector<double> local_row(rowSize), global_row(rowSize);
+    std::vector<int> local_counts(k), global_counts(k);
+    std::vector<int> emptyClusters;
+    if (hierarchical) nodeReducer.prepare(*comm, rowSize * sizeof(double), ranksPerNode);
+    exchange.prepare(compression, k, dim, 2 * k, hierarchical ? &nodeReducer : nullptr);
+    commBytes = static_cast<long long>(k) * dim * sizeof(double);   // the one centroid Bcast
+    // LARGEST_SSE needs the farthest member of a donor cluster on its owning rank, not worth it here
+    const EmptyClusterPolicy policy = emptyPolicy == EmptyClusterPolicy::KEEP
+            ? EmptyClusterPolicy::KEEP : EmptyClusterPolicy::FARTHEST_POINT;
+
+    int iter = 0;
+    bool converged = false;
+    bool confirming = false;
+
+    while (iter < maxIter && !converged) {
+        t_comp = comm->wtime();
+        double* local_sse = local_row.data() + static_cast<size_t>(k) * dim;
+        double* local_weight = local_sse + k;
+        std::fill(local_sse, local_sse + k, 0.0);
+        reseedTracker.reset(policy, k);
+        SparseKMeansOps::assign(local, current, local_sse, reseedTracker, policy, sparseMetric);
+        SparseKMeansOps::accumulate(local, k, local_row.data(), local_weight, local_counts.data());
+        addLog(t_comp, comm->wtime(), COMP, "CalcLocal");
+
+        t_comm = comm->wtime();
+        const bool exactPass = compression == CommCompression::FLOAT32_DELTA && (confirming || iter == maxIter - 1);
+        exchange.reduce(local_row.data(), global_row.data(), exactPass, *comm);
+        exchange.reduceCounts(local_counts.data(), global_counts.data(), k, *comm);
+        addLog(t_comm, comm->wtime(), COMM, "AllReduce");
+
+        t_comp = comm->wtime();
+        const double* global_sse = global_row.data() + static_cast<size_t>(k) * dim;
+        double maxShift = SparseKMeansOps::finishUpdate(global_row.data(), global_sse + k, current, emptyClusters, sparseMetric);
+        result.clusterSizes.assign(global_counts.begin(), global_counts.end());
+        result.clusterSSE.assign(global_sse, global_sse + k);
+
+        // Global counts -> same empty list everywhere, all ranks enter the collectives together
+        if (!emptyClusters.empty() && reseedTracker.active()) {
+            result.reseededClusters += reseedSparse(local, emptyClusters, dim, global_row.data(), maxShift);
+            if (sparseMetric == DistanceMetric::COSINE) {
+                for (int j : emptyClusters) CentroidUpdate::normalize(global_row.data() + static_cast<size_t>(j) * dim, dim);
             }
         }
 
+        std::copy(global_row.begin(), global_row.begin() + static_cast<size_t>(k) * dim, current.rows.begin());
+        current.refresh();
         if (maxShift < threshold * threshold) {
-            converged = true;
+            if (compression == CommCompression::FLOAT32_DELTA && !exactPass) confirming = true;
+            else converged = true;
+        } else {
+            confirming = false;
         }
-        addLog(t_comp, MPI_Wtime(), COMP, "Update");
+        addLog(t_comp, comm->wtime(), COMP, "Update");
 
         iter++;
     }
 
-    // Save logs
+    // Labels back to rank 0 in global order
+    t_comm = comm->wtime();
+    if (world_rank == 0) data.labels.resize(n_points);
+    comm->gatherv(local.labels.data(), local_n, CommDatatype::INT,
+                  world_rank == 0 ? data.labels.data() : nullptr, send_counts.data(), displs.data(), 0);
+    addLog(t_comm, comm->wtime(), COMM, "GatherLabels");
+
+    commBytes += exchange.bytesSent();
+    centroids = current.toPoints();
+    result.iterations = iter;
+    result.converged = converged;
+    result.inertia = 0.0;
+    for (double s : result.clusterSSE) result.inertia += s;
+
+    trainingInfo = ModelMetadata();
+    trainingInfo.numPoints = n_points;
+    trainingInfo.iterations = iter;
+    trainingInfo.inertia = result.inertia;
+    trainingInfo.metric = sparseMetric;
+
     saveLogsToCSV();
-    return iter;
-}
\ No newline at end of file
+    return result;
+}
@@ -0,0 +1,55 @@
+#include "../include/empty_cluster.h"
+#include <numeric>
+
+void ReseedTracker::reset(EmptyClusterPolicy newPolicy, int k) {
+    policy = newPolicy;
+    top.clear();
+    farthest.clear();
+
+    if (policy == EmptyClusterPolicy::FARTHEST_POINT) {
+        capacity = static_cast<size_t>(std::min(k, MAX_CANDIDATES));
+        top.reserve(capacity);
+    } else if (policy == EmptyClusterPolicy::LARGEST_SSE) {
+        farthest.assign(k, {-1.0, -1, -1});
+    }
+}
+
+void ReseedTracker::merge(const ReseedTracker& other) {
+    for (const auto& c : other.top) observe(c.dist, c.index, c.cluster);
+    for (const auto& c : other.farthest) {
+        if (c.index >= 0) observe(c.dist, c.index, c.cluster);
+    }
+}
+
+std::vector<ReseedCandidate> ReseedTracker::sortedCandidates() const {
+    std::vector<ReseedCandidate> sorted = top;
+    std::sort(sorted.begin(), sorted.end(), ahead);
+    return sorted;
+}
+
+std::vector<std::pair<int, int>> ReseedTracker::choose(const std::vector<int>& emptyClusters,
+                                                       const std::vector<double>& clusterSSE) const {
+    std::vector<std::pair<int, int>> moves;
+
+    if (policy == EmptyClusterPolicy::FARTHEST_POINT) {
+        std::vector<ReseedCandidate> sorted = sortedCandidates();
+        for (size_t e = 0; e < emptyClusters.size() && e < sorted.size(); ++e) {
+            if (sorted[e].dist <= 0.0) break; // remaining points sit on their centroids
+            moves.emplace_back(emptyClusters[e], sorted[e].index);
+        }
+    } else if (policy == EmptyClusterPolicy::LARGEST_SSE) {
+        // Donor clusters by decreasing SSE, each donates its farthest member once
+        std::vector<int> donors(farthest.size());
+        std::iota(donors.begin(), donors.end(), 0);
+        std::sort(donors.begin(), donors.end(), [&](int a, int b) { return clusterSSE[a] > clusterSSE[b]; });
+
+        size_t next = 0;
+        for (int cluster : emptyClusters) {
+            while (next < donors.size() && farthest[donors[next]].dist <= 0.0) next++;
+            if (next == donors.size()) break;
+            moves.emplace_back(cluster, farthest[donors[next]].index);
+            next++;
+        }
+    }
+    return moves;
+}
@@ -0,0 +1,30 @@
+#include "../include/executor.h"
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+void Executor::configure(ExecutionBackend newBackend) {
+    backend = newBackend;
+    if (backend != ExecutionBackend::THREAD_POOL) {
+        pool.reset();
+        return;
+    }
+    if (!pool || pool->size() != omp_get_max_threads()) {
+        pool = std::make_unique<WorkStealingPool>();
+    }
+}
+
+int Executor::numWorkers() const {
+    if (backend == ExecutionBackend::THREAD_POOL && pool) return pool->size();
+    return omp_get_max_threads();
+}
+
+long long Executor::chunkForL2(size_t bytesPerItem) {
+    long l2Bytes = 256 * 1024;
+#if !defined(_WIN32) && defined(_SC_LEVEL2_CACHE_SIZE)
+    long detected = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    if (detected > 0) l2Bytes = detected;
+#endif
+    long long items = static_cast<long long>(l2Bytes / 2) / static_cast<long long>(std::max<size_t>(bytesPerItem, 1));
+    return std::max(64LL, items);
+}
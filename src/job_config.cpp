@@ -0,0 +1,329 @@
+#include "../include/job_config.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+
+namespace {
+
+// Handled by main() before the ranks are launched
+const char* const TRANSPORT_OPTIONS[] = {"ranks", "latency-us", "bandwidth-gbs", "jitter-us"};
+
+std::string trim(const std::string& s) {
+    const size_t first = s.find_first_not_of(" \t\r");
+    if (first == std::string::npos) return "";
+    const size_t last = s.find_last_not_of(" \t\r");
+    return s.substr(first, last - first + 1);
+}
+
+bool parseLong(const std::string& text, long long minValue, long long& out) {
+    if (text.empty()) return false;
+    char* end = nullptr;
+    errno = 0;
+    // 1e6 style counts are accepted when they are whole numbers
+    const double value = std::strtod(text.c_str(), &end);
+    // Range first, the cast is undefined outside [LLONG_MIN, LLONG_MAX] (NaN fails both tests)
+    if (*end != '\0' || errno != 0 || !(value >= static_cast<double>(LLONG_MIN) && value < static_cast<double>(LLONG_MAX))) {
+        return false;
+    }
+    if (value != static_cast<double>(static_cast<long long>(value))) return false;
+    out = static_cast<long long>(value);
+    return out >= minValue;
+}
+
+bool parseInt(const std::string& text, int minValue, int& out) {
+    long long value;
+    if (!parseLong(text, minValue, value) || value > 2147483647LL) return false;
+    out = static_cast<int>(value);
+    return true;
+}
+
+bool parseDouble(const std::string& text, double& out) {
+    if (text.empty()) return false;
+    char* end = nullptr;
+    errno = 0;
+    out = std::strtod(text.c_str(), &end);
+    return *end == '\0' && errno != ERANGE && std::isfinite(out);
+}
+
+bool parseBool(const std::string& text, bool& out) {
+    if (text == "1" || text == "on" || text == "true" || text == "yes") out = true;
+    else if (text == "0" || text == "off" || text == "false" || text == "no") out = false;
+    else return false;
+    return true;
+}
+
+bool isSwitch(const std::string& key) {
+    return key == "profile" || key == "quiet" || key == "distances" || key == "reorder" || key == "norm-cache"
+           || key == "packed" || key == "reproducible";
+}
+
+// "8,16,32"
+template <class T>
+bool parseList(const std::string& text, long long minValue, std::vector<T>& out) {
+    std::vector<T> values;
+    size_t start = 0;
+    while (start <= text.size()) {
+        size_t comma = text.find(',', start);
+        if (comma == std::string::npos) comma = text.size();
+        long long value;
+        if (!parseLong(trim(text.substr(start, comma - start)), minValue, value)) return false;
+        values.push_back(static_cast<T>(value));
+        start = comma + 1;
+    }
+    out = values;
+    return !out.empty();
+}
+
+}
+
+const char* JobConfig::engineName(JobEngine engine) {
+    switch (engine) {
+        case JobEngine::SEQUENTIAL: return "seq";
+        case JobEngine::OPENMP: return "omp";
+        case JobEngine::BISECTING: return "bisect";
+        case JobEngine::DISTRIBUTED: return "mpi";
+        case JobEngine::PLANNED: return "plan";
+    }
+    return "?";
+}
+
+bool JobConfig::set(const std::string& key, const std::string& rawValue, std::string& error) {
+    const std::string value = trim(rawValue);
+    bool ok = true;
+
+    if (key == "input") {
+        input = value;
+    } else if (key == "generate") {
+        if (value == "uniform") generator.distribution = DataDistribution::UNIFORM;
+        else if (value == "gaussian") generator.distribution = DataDistribution::GAUSSIAN_MIXTURE;
+        else if (value == "anisotropic") generator.distribution = DataDistribution::ANISOTROPIC_BLOBS;
+        else ok = false;
+    } else if (key == "points") {
+        ok = parseLong(value, 1, numPoints);
+    } else if (key == "dim") {
+        ok = parseInt(value, 1, generator.dim);
+    } else if (key == "clusters") {
+        ok = parseInt(value, 1, generator.numClusters);
+    } else if (key == "spread") {
+        ok = parseDouble(value, generator.clusterStd) && generator.clusterStd >= 0.0;
+    } else if (key == "min") {
+        ok = parseDouble(value, generator.minVal);
+    } else if (key == "max") {
+        ok = parseDouble(value, generator.maxVal);
+    } else if (key == "data-seed") {
+        long long seed;
+        ok = parseLong(value, 0, seed);
+        generator.seed = static_cast<uint64_t>(seed);
+    } else if (key == "engine") {
+        if (value == "seq") engine = JobEngine::SEQUENTIAL;
+        else if (value == "omp") engine = JobEngine::OPENMP;
+        else if (value == "bisect") engine = JobEngine::BISECTING;
+        else if (value == "mpi") engine = JobEngine::DISTRIBUTED;
+        else if (value == "plan") engine = JobEngine::PLANNED;
+        else ok = false;
+    } else if (key == "k") {
+        ok = parseList(value, 1, ks);
+    } else if (key == "seed") {
+        ok = parseList(value, 0, seeds);
+    } else if (key == "max-iter") {
+        ok = parseInt(value, 1, maxIter);
+    } else if (key == "tol") {
+        ok = parseDouble(value, threshold) && threshold >= 0.0;
+    } else if (key == "repeat") {
+        ok = parseInt(value, 1, repeat);
+    } else if (key == "threads") {
+        ok = parseInt(value, 0, threads);
+    } else if (key == "backend") {
+        if (value == "openmp") backend = ExecutionBackend::OPENMP;
+        else if (value == "pool") backend = ExecutionBackend::THREAD_POOL;
+        else ok = false;
+    } else if (key == "metric") {
+        if (value == "euclidean") metric = DistanceMetric::SQUARED_EUCLIDEAN;
+        else if (value == "cosine") metric = DistanceMetric::COSINE;
+        else if (value == "manhattan") metric = DistanceMetric::MANHATTAN;
+        else ok = false;
+    } else if (key == "empty") {
+        if (value == "keep") emptyPolicy = EmptyClusterPolicy::KEEP;
+        else if (value == "farthest") emptyPolicy = EmptyClusterPolicy::FARTHEST_POINT;
+        else if (value == "largest-sse") emptyPolicy = EmptyClusterPolicy::LARGEST_SSE;
+        else ok = false;
+    } else if (key == "precision") {
+        // The engines compute in double, only the sums exchange between ranks can be narrowed
+        if (value == "double") compression = CommCompression::NONE;
+        else if (value == "float32") compression = CommCompression::FLOAT32_DELTA;
+        else ok = false;
+    } else if (key == "compression") {
+        if (value == "none") compression = CommCompression::NONE;
+        else if (value == "changed") compression = CommCompression::CHANGED_CLUSTERS;
+        else if (value == "float32") compression = CommCompression::FLOAT32_DELTA;
+        else ok = false;
+    } else if (key == "staleness") {
+        ok = parseInt(value, 0, staleness);
+    } else if (key == "norm-cache") {
+        ok = parseBool(value, normCache);
+    } else if (key == "reorder") {
+        ok = parseBool(value, reorder);
+    } else if (key == "packed") {
+        ok = parseBool(value, packedCoords);
+    } else if (key == "reproducible") {
+        ok = parseBool(value, reproducible);
+    } else if (key == "huge-pages") {
+        if (value == "off") hugePages = HugePages::NONE;
+        else if (value == "transparent") hugePages = HugePages::TRANSPARENT;
+        else if (value == "explicit") hugePages = HugePages::EXPLICIT;
+        else ok = false;
+    } else if (key == "silhouette") {
+        ok = parseInt(value, 0, silhouetteSample);
+    } else if (key == "model") {
+        modelPath = value;
+    } else if (key == "labels") {
+        labelsPath = value;
+    } else if (key == "labels-format") {
+        if (value == "csv") labelFormat = LabelFormat::CSV;
+        else if (value == "binary") labelFormat = LabelFormat::BINARY;
+        else ok = false;
+    } else if (key == "labels-mode") {
+        if (value == "gather") labelMode = LabelOutputMode::GATHER;
+        else if (value == "sharded") labelMode = LabelOutputMode::SHARDED;
+        else if (value == "collective") labelMode = LabelOutputMode::COLLECTIVE;
+        else ok = false;
+    } else if (key == "distances") {
+        ok = parseBool(value, labelDistances);
+    } else if (key == "summary") {
+        summaryPath = value;
+    } else if (key == "profile") {
+        ok = parseBool(value, profile);
+    } else if (key == "quiet") {
+        ok = parseBool(value, quiet);
+    } else if (key == "config") {
+        return loadFile(value, error);
+    } else {
+        error = "unknown option '" + key + "'";
+        return false;
+    }
+
+    if (!ok) error = "invalid value '" + value + "' for '" + key + "'";
+    return ok;
+}
+
+bool JobConfig::loadFile(const std::string& filename, std::string& error) {
+    // Same file under another name (./a.cfg, a symlink) is still the same file
+    std::error_code ec;
+    std::string path = std::filesystem::weakly_canonical(filename, ec).string();
+    if (ec) path = filename;
+    if (std::find(openConfigs.begin(), openConfigs.end(), path) != openConfigs.end()) {
+        error = "config file " + filename + " includes itself";
+        return false;
+    }
+    if (openConfigs.size() >= MAX_CONFIG_DEPTH) {
+        error = "config files nested more than " + std::to_string(MAX_CONFIG_DEPTH) + " deep at " + filename;
+        return false;
+    }
+    openConfigs.push_back(path);
+    const bool ok = readFile(filename, error);
+    openConfigs.pop_back();
+    return ok;
+}
+
+bool JobConfig::readFile(const std::string& filename, std::string& error) {
+    std::ifstream file(filename);
+    if (!file) {
+        error = "cannot open config file " + filename;
+        return false;
+    }
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        const size_t comment = line.find('#');
+        if (comment != std::string::npos) line.erase(comment);
+        line = trim(line);
+        if (line.empty()) continue;
+
+        const size_t equals = line.find('=');
+        if (equals == std::string::npos || !set(trim(line.substr(0, equals)), line.substr(equals + 1), error)) {
+            if (equals == std::string::npos) error = "expected 'key = value'";
+            error = filename + ":" + std::to_string(lineNumber) + ": " + error;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool JobConfig::parseArgs(int argc, char* argv[], int first, std::string& error) {
+    for (int i = first; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.size() < 3 || arg.compare(0, 2, "--") != 0) {
+            error = "unexpected argument '" + arg + "'";
+            return false;
+        }
+        std::string key = arg.substr(2);
+        std::string value;
+        const size_t equals = key.find('=');
+        if (equals != std::string::npos) {
+            value = key.substr(equals + 1);
+            key.erase(equals);
+        } else if (isSwitch(key) && (i + 1 == argc || std::string(argv[i + 1]).compare(0, 2, "--") == 0)) {
+            value = "on";   // switches may be given without a value
+        } else if (i + 1 < argc) {
+            value = argv[++i];
+        } else {
+            error = "missing value for --" + key;
+            return false;
+        }
+
+        if (std::find(std::begin(TRANSPORT_OPTIONS), std::end(TRANSPORT_OPTIONS), key) != std::end(TRANSPORT_OPTIONS)) continue;
+        if (!set(key, value, error)) return false;
+    }
+    return true;
+}
+
+bool JobConfig::validate(std::string& error) const {
+    // The planner may pick the bisecting engine as well
+    if (metric != DistanceMetric::SQUARED_EUCLIDEAN && (engine == JobEngine::BISECTING || engine == JobEngine::PLANNED)) {
+        error = std::string("the ") + engineName(engine) + " engine supports the euclidean metric only";
+        return false;
+    }
+    if (input.empty() && generator.maxVal < generator.minVal) {
+        error = "min is above max";
+        return false;
+    }
+    return true;
+}
+
+void JobConfig::print(std::ostream& out) const {
+    out << "Job: engine " << engineName(engine) << ", k";
+    for (size_t i = 0; i < ks.size(); ++i) out << (i ? "," : " ") << ks[i];
+    out << ", seed";
+    for (size_t i = 0; i < seeds.size(); ++i) out << (i ? "," : " ") << seeds[i];
+    out << ", max-iter " << maxIter << ", tol " << threshold;
+    if (repeat > 1) out << ", repeat " << repeat;
+    out << std::endl;
+    if (!input.empty()) out << "  Input: " << input << std::endl;
+    else out << "  Input: generated, " << numPoints << " points, dim " << generator.dim << std::endl;
+}
+
+void JobConfig::printUsage(std::ostream& out) {
+    out << "Usage: kmeans_hpc --run [--config FILE] [--key value ...]\n"
+           "  (--seq, --omp and --mpi take the same options, with that engine preset)\n"
+           "Data:     --input FILE.csv | --generate uniform|gaussian|anisotropic --points N --dim D\n"
+           "          --clusters C --spread S --min A --max B --data-seed S\n"
+           "Engine:   --engine seq|omp|bisect|mpi|plan --k K[,K...] --seed S[,S...] --max-iter N --tol T\n"
+           "          --repeat R --threads T --backend openmp|pool --metric euclidean|cosine|manhattan\n"
+           "          --empty keep|farthest|largest-sse --precision double|float32\n"
+           "          --compression none|changed|float32 --staleness S --norm-cache on|off --reorder on|off\n"
+           "          --packed on|off --huge-pages off|transparent|explicit --reproducible on|off\n"
+           "          --silhouette SAMPLE\n"
+           "Outputs:  --model FILE --labels FILE --labels-format csv|binary --labels-mode gather|sharded|collective\n"
+           "          --distances on|off --summary FILE.csv --profile on|off --quiet on|off\n"
+           "--packed on keeps an aligned copy of the coordinates next to the points: 2x coordinate memory.\n"
+           "Paths may hold {k}, {seed} and {repeat}. Config files take the same keys as 'key = value' lines.\n"
+           "Simulated ranks: --ranks N [--latency-us L --bandwidth-gbs B --jitter-us J]\n"
+           "Fixed demos (own data and sizes, no job options): --test --old --compare --empirical --scale --predict\n"
+           "          --kdtree --multi --pool --coreset --reorder --norms --hugepages --repro --bisect --hier --plan\n"
+           "          --stale --compress --metrics --sparse --labels --allocs, and --serve MODEL" << std::endl;
+}
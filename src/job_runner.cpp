@@ -0,0 +1,281 @@
+#include "../include/job_runner.h"
+#include "../include/bisecting_kmeans.h"
+#include "../include/distributed_kmeans.h"
+#include "../include/kmeans.h"
+#include "../include/label_writer.h"
+#include "../include/parallel_kmeans.h"
+#include "../include/profiler_utils.h"
+#include "../include/run_planner.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <omp.h>
+
+JobRunner::JobRunner(const JobConfig& config, Transport& world) : config(config), world(world) {}
+
+bool JobRunner::loadData() {
+    if (!config.input.empty()) {
+        data = DataLoader::loadFromCSV(config.input);
+    } else {
+        // A fixed data seed keeps the data of a sweep the same between invocations
+        data = DataLoader::generate(config.generator, config.numPoints);
+    }
+    if (data.empty()) {
+        std::cerr << "Error: no data to cluster." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+std::vector<Point> JobRunner::initialCentroids(int k, uint64_t seed) const {
+    if (seed == 0 || data.size() < static_cast<size_t>(k)) return {};
+    std::vector<size_t> indices(data.size());
+    std::iota(indices.begin(), indices.end(), 0);
+    std::mt19937_64 rng(seed);
+    std::vector<Point> initial;
+    for (int i = 0; i < k; ++i) {
+        std::uniform_int_distribution<size_t> pick(i, indices.size() - 1);
+        std::swap(indices[i], indices[pick(rng)]);
+        initial.emplace_back(data[indices[i]].coords);
+    }
+    return initial;
+}
+
+std::string JobRunner::expandPath(std::string path, int k, uint64_t seed, int repeatIndex) {
+    const std::pair<std::string, std::string> fields[] = {
+        {"{k}", std::to_string(k)}, {"{seed}", std::to_string(seed)}, {"{repeat}", std::to_string(repeatIndex + 1)}};
+    for (const auto& field : fields) {
+        for (size_t at = path.find(field.first); at != std::string::npos; at = path.find(field.first, at)) {
+            path.replace(at, field.first.size(), field.second);
+            at += field.second.size();
+        }
+    }
+    return path;
+}
+
+bool JobRunner::writeLabels(const std::string& path, const std::vector<Point>& centroids) const {
+    std::vector<int> labels;
+    std::vector<double> distances;
+    LabelWriter::extract(data, centroids, labels, config.labelDistances ? &distances : nullptr, config.metric);
+    return LabelWriter::write(path, config.labelFormat, labels.data(),
+                              config.labelDistances ? distances.data() : nullptr, labels.size());
+}
+
+bool JobRunner::appendSummary(JobEngine engine, int k, uint64_t seed, int repeatIndex, int threads,
+                              const KMeansResult& result, double wall, double cpu) const {
+    bool fresh;
+    {
+        std::ifstream existing(config.summaryPath);
+        fresh = !existing || existing.peek() == std::ifstream::traits_type::eof();
+    }
+    std::ofstream file(config.summaryPath, std::ios::app);
+    if (!file) {
+        std::cerr << "Error: cannot write " << config.summaryPath << std::endl;
+        return false;
+    }
+    if (fresh) file << "engine,points,dim,k,seed,repeat,threads,ranks,iterations,converged,inertia,wall_s,cpu_s\n";
+    file << JobConfig::engineName(engine) << ',' << numPoints << ',' << dim << ',' << k << ',' << seed << ','
+         << repeatIndex + 1 << ',' << threads << ',' << (engine == JobEngine::DISTRIBUTED ? world.size() : 1) << ','
+         << result.iterations << ',' << (result.converged ? 1 : 0) << ',' << std::setprecision(17) << result.inertia
+         << ',' << std::setprecision(6) << wall << ',' << cpu << '\n';
+    return static_cast<bool>(file);
+}
+
+bool JobRunner::runOnce(int k, uint64_t seed, int repeatIndex) {
+    const int rank = world.rank();
+    JobEngine engine = config.engine;
+    CommCompression compression = config.compression;
+    const int allThreads = omp_get_max_threads();
+    int threads = allThreads;
+
+    if (engine == JobEngine::PLANNED) {
+        RunPlanner planner(k, config.maxIter, config.threshold);
+        if (seed != 0) planner.setSeed(seed);
+        RunPlan plan = planner.plan(data, world);
+        if (plan.numPoints == 0) return true;
+        if (rank == 0 && !config.quiet) plan.print(std::cout);
+        switch (plan.engine) {
+            case PlannedEngine::OPENMP: engine = JobEngine::OPENMP; break;
+            case PlannedEngine::BISECTING: engine = JobEngine::BISECTING; break;
+            case PlannedEngine::DISTRIBUTED: engine = JobEngine::DISTRIBUTED; break;
+        }
+        threads = plan.threads;
+        compression = plan.compression;
+    }
+
+    const std::vector<Point> initial = rank == 0 ? initialCentroids(k, seed) : std::vector<Point>();
+    const std::string modelPath = expandPath(config.modelPath, k, seed, repeatIndex);
+    const std::string labelsPath = expandPath(config.labelsPath, k, seed, repeatIndex);
+
+    KMeansResult result;
+    KMeansModel model;
+    std::vector<Point> centroids;
+    double phaseTimes[3] = {0.0, 0.0, 0.0};     // init, assign, update (OpenMP engine)
+    long long commBytes = 0;
+    double reductionWait = 0.0;
+    bool outputsOk = true;
+
+    world.barrier();
+    const double startWall = world.wtime();
+    const double startCpu = ResourceProfiler::getCPUTime();
+
+    switch (engine) {
+        case JobEngine::SEQUENTIAL:
+            if (rank == 0) {
+                KMeans kmeans(k, config.maxIter, config.threshold);
+                kmeans.setDistanceMetric(config.metric);
+                kmeans.setEmptyClusterPolicy(config.emptyPolicy);
+                kmeans.setSilhouetteSample(config.silhouetteSample);
+                if (!initial.empty()) kmeans.setInitialCentroids(initial);
+                result = kmeans.run(data);
+                model = kmeans.getModel();
+                centroids = kmeans.getCentroids();
+            }
+            break;
+        case JobEngine::OPENMP:
+        case JobEngine::PLANNED:
+            if (rank == 0) {
+                omp_set_num_threads(threads);
+                ParallelKMeans kmeans(k, config.maxIter, config.threshold);
+                kmeans.setVerbose(!config.quiet);
+                kmeans.setDistanceMetric(config.metric);
+                kmeans.setEmptyClusterPolicy(config.emptyPolicy);
+                kmeans.setSilhouetteSample(config.silhouetteSample);
+                kmeans.setExecutionBackend(config.backend);
+                kmeans.setReorder(config.reorder);
+                kmeans.setNormCache(config.normCache);
+                kmeans.setPackedCoords(config.packedCoords);
+                kmeans.setReproducible(config.reproducible);
+                if (!initial.empty()) kmeans.setInitialCentroids(initial);
+                result = kmeans.run(data);
+                omp_set_num_threads(allThreads);
+                model = kmeans.getModel();
+                centroids = kmeans.getCentroids();
+                phaseTimes[0] = kmeans.getInitTime();
+                phaseTimes[1] = kmeans.getAssignTime();
+                phaseTimes[2] = kmeans.getUpdateTime();
+            }
+            break;
+        case JobEngine::BISECTING:
+            if (rank == 0) {
+                const unsigned int treeSeed = seed != 0 ? static_cast<unsigned int>(seed) : std::random_device()();
+                BisectingKMeans kmeans(k, config.maxIter, config.threshold, treeSeed);
+                result = kmeans.run(data);
+                model = kmeans.getModel();
+                centroids = kmeans.getCentroids();
+            }
+            break;
+        case JobEngine::DISTRIBUTED: {
+            DistributedKMeans kmeans(k, config.maxIter, config.threshold, world);
+            kmeans.setDistanceMetric(config.metric);
+            kmeans.setEmptyClusterPolicy(config.emptyPolicy);
+            kmeans.setSilhouetteSample(config.silhouetteSample);
+            kmeans.setCommCompression(compression);
+            kmeans.setStaleness(config.staleness);
+            kmeans.setReproducible(config.reproducible);
+            if (!initial.empty()) kmeans.setInitialCentroids(initial);
+            result = kmeans.run(data);
+            model = kmeans.getModel();
+            commBytes = kmeans.getCommunicatedBytes();
+            reductionWait = kmeans.getReductionWaitTime();
+            // Labels live on the ranks, so they are written here while the engine still holds them
+            if (!labelsPath.empty()) {
+                outputsOk = kmeans.writeLabels(labelsPath, config.labelFormat, config.labelMode, config.labelDistances);
+            }
+            break;
+        }
+    }
+
+    double cpu = ResourceProfiler::getCPUTime() - startCpu;
+    world.barrier();
+    const double wall = world.wtime() - startWall;
+
+    // Runs that stopped before the loop (k above n) report no sizes
+    bool ran = !result.clusterSizes.empty();
+    int ranFlag = ran ? 1 : 0;
+    world.bcast(&ranFlag, 1, CommDatatype::INT, 0);
+    if (ranFlag == 0) return false;
+
+    const bool distributed = engine == JobEngine::DISTRIBUTED;
+    if (distributed) {
+        world.allreduce(&cpu, 1, CommDatatype::DOUBLE, CommOp::SUM);
+        world.allreduce(&commBytes, 1, CommDatatype::LONG_LONG, CommOp::SUM);
+        world.allreduce(&reductionWait, 1, CommDatatype::DOUBLE, CommOp::MAX);
+    }
+
+    if (rank == 0) {
+        const int usedThreads = engine == JobEngine::OPENMP ? threads : allThreads;
+        const int cores = distributed ? world.size() : 1;
+        std::cout << "Run " << (repeatIndex + 1) << "/" << config.repeat << " [" << JobConfig::engineName(engine)
+                  << ", k=" << k << ", seed=" << seed << "]"
+                  << " | Wall: " << std::fixed << std::setprecision(4) << wall << "s"
+                  << " | CPU: " << cpu << "s"
+                  << " | Load: " << std::setprecision(1) << cpu / (wall * cores) * 100.0 << "%"
+                  << " (" << result.iterations << " iters" << (result.converged ? "" : ", not converged")
+                  << ", inertia " << std::setprecision(6) << std::scientific << result.inertia << ")"
+                  << std::defaultfloat << std::endl;
+
+        if (config.profile) {
+            std::cout << std::fixed << std::setprecision(4);
+            if (engine == JobEngine::OPENMP) {
+                std::cout << "  Phases: init " << phaseTimes[0] << "s, assign " << phaseTimes[1] << "s, update "
+                          << phaseTimes[2] << "s on " << usedThreads << " threads" << std::endl;
+            }
+            if (distributed) {
+                std::cout << "  Exchange: " << commBytes << " bytes over " << world.size() << " ranks, "
+                          << "reduction wait " << reductionWait << "s (slowest rank)" << std::endl;
+            }
+            std::cout << "  Empty clusters reseeded: " << result.reseededClusters;
+            if (config.silhouetteSample > 0) std::cout << ", silhouette " << std::setprecision(3) << result.silhouette;
+            std::cout << std::defaultfloat << std::endl;
+        }
+
+        if (!modelPath.empty() && !model.save(modelPath)) outputsOk = false;
+        if (!labelsPath.empty() && !distributed && !writeLabels(labelsPath, centroids)) {
+            std::cerr << "Error: cannot write " << labelsPath << std::endl;
+            outputsOk = false;
+        }
+        if (!config.summaryPath.empty()
+            && !appendSummary(engine, k, seed, repeatIndex, usedThreads, result, wall, cpu)) {
+            outputsOk = false;
+        }
+    }
+    return outputsOk;
+}
+
+int JobRunner::run() {
+    const int rank = world.rank();
+    if (config.threads > 0) omp_set_num_threads(config.threads);
+    AlignedMemory::setHugePages(config.hugePages);
+
+    long long shape[2] = {0, 0};
+    if (rank == 0) {
+        if (!config.quiet) config.print(std::cout);
+        if (loadData()) {
+            shape[0] = static_cast<long long>(data.size());
+            shape[1] = static_cast<long long>(data[0].coords.size());
+        }
+    }
+    world.bcast(shape, 2, CommDatatype::LONG_LONG, 0);
+    numPoints = shape[0];
+    dim = static_cast<int>(shape[1]);
+    if (numPoints == 0) return 1;
+
+    int failed = 0;
+    for (int k : config.ks) {
+        if (k > numPoints) {
+            if (rank == 0) std::cerr << "Error: k=" << k << " is larger than the dataset (" << numPoints << " points)." << std::endl;
+            failed = 1;
+            continue;
+        }
+        for (uint64_t seed : config.seeds) {
+            for (int r = 0; r < config.repeat; ++r) {
+                if (!runOnce(k, seed, r)) failed = 1;
+            }
+        }
+    }
+    return failed;
+}
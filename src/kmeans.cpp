@@ -1,4 +1,5 @@
 #include "../include/kmeans.h"
+#include "../include/alloc_counter.h"
 #include <chrono>
 #include <limits>
 #include <random>
@@ -17,6 +18,15 @@ void KMeans::initializeCentroids(const Dataset &data) {
         return;
     }
 
+    if (!initialCentroids.empty()) {
+        if (initialCentroids.size() == static_cast<size_t>(k)
+            && initialCentroids[0].coords.size() == data[0].coords.size()) {
+            centroids = initialCentroids;
+            return;
+        }
+        std::cerr << "Warning: initial centroids do not match k/dim, using random initialization." << std::endl;
+    }
+
     std::vector<size_t> indices(data.size());
     for (size_t i = 0; i < indices.size(); i++) indices[i] = i;
 
@@ -31,53 +41,92 @@ void KMeans::initializeCentroids(const Dataset &data) {
 }
 //Assign every point to the nearest centroid
 void KMeans::assignClusters(Dataset& data) {
-    for (auto& point : data) {
+    // One dispatch per pass, the loop below is compiled for the metric
+    withMetric(metric, [&](auto policy) { assignWith<decltype(policy)>(data); });
+}
+
+template <class Metric>
+void KMeans::assignWith(Dataset& data) {
+    // Per-cluster SSE comes for free from the distances the assignment already computes
+    result.clusterSSE.assign(k, 0.0);
+    // Reseeding candidates for empty clusters are tracked in the same pass
+    reseedTracker.reset(emptyPolicy, k);
+    const int dim = static_cast<int>(data[0].coords.size());
+
+    if (Metric::supportsKDTree && CentroidKDTree::isBeneficial(k, dim)) {
+        centroidTree.build(centroids);
+        for (int i = 0; i < static_cast<int>(data.size()); ++i) {
+            double dist;
+            data[i].clusterId = centroidTree.nearest(data[i].coords.data(), dist);
+            result.clusterSSE[data[i].clusterId] += data[i].weight * dist;
+            reseedTracker.observe(dist, i, data[i].clusterId);
+        }
+        return;
+    }
+
+    for (int p = 0; p < static_cast<int>(data.size()); ++p) {
+        Point& point = data[p];
         double minDist = std::numeric_limits<double>::max();
         int bestCluster = -1;
 
         for (int i = 0; i < k; ++i) {
-            double dist = distanceSquared(point, centroids[i]);
+            double dist = Metric::distance(point.coords.data(), centroids[i].coords.data(), dim);
             if (dist < minDist) {
                 minDist = dist;
                 bestCluster = i;
             }
         }
         point.clusterId = bestCluster;
+        result.clusterSSE[bestCluster] += point.weight * minDist;
+        reseedTracker.observe(minDist, p, bestCluster);
     }
 }
 //Returns true if the algorithm has reached convergence.
 bool KMeans::updateCentroids(const Dataset& data) {
-    std::vector<Point> newCentroids(k);
-    std::vector<int> counts(k, 0);
+    // New centroids go into the back buffer, sums and counts come from the workspace
+    std::vector<Point>& newCentroids = workspace.nextCentroids;
+    workspace.resetSums();
+    int* counts = workspace.workerCounts(0);
+    double* clusterWeight = workspace.weights(0);
 
     // Initialize new centroids with zeros
     size_t dim = data[0].coords.size();
     for (int i = 0; i < k; ++i) {
-        newCentroids[i].coords.resize(dim, 0.0);
+        std::fill(newCentroids[i].coords.begin(), newCentroids[i].coords.end(), 0.0);
     }
 
-    // Summing the coords of points in every cluster
+    // Summing the (weighted) coords of points in every cluster
     for (const auto& point : data) {
         int clusterId = point.clusterId;
         if (clusterId == -1) continue;
 
         counts[clusterId]++;
+        clusterWeight[clusterId] += point.weight;
         for (size_t d = 0; d < dim; ++d) {
-            newCentroids[clusterId].coords[d] += point.coords[d];
+            newCentroids[clusterId].coords[d] += point.weight * point.coords[d];
         }
     }
 
-    // Division by the number of points
+    // k-medians replaces the means by per-dimension medians
+    if (metric == DistanceMetric::MANHATTAN) CentroidUpdate::medians(data, k, newCentroids);
+
+    // Division by the total weight (the number of points for unweighted data)
     double maxShift = 0.0;
+    std::vector<int>& emptyClusters = workspace.emptyClusters;
+    emptyClusters.clear();
     for (int i = 0; i < k; ++i) {
-        if (counts[i] == 0) {
-            newCentroids[i] = centroids[i];
+        if (clusterWeight[i] <= 0.0) {
+            newCentroids[i].coords = centroids[i].coords;
+            emptyClusters.push_back(i);
             continue;
         }
 
-        for (size_t d = 0; d < dim; ++d) {
-            newCentroids[i].coords[d] /= static_cast<double>(counts[i]);
+        if (metric != DistanceMetric::MANHATTAN) {
+            for (size_t d = 0; d < dim; ++d) {
+                newCentroids[i].coords[d] /= clusterWeight[i];
+            }
         }
+        if (metric == DistanceMetric::COSINE) CentroidUpdate::normalize(newCentroids[i].coords.data(), static_cast<int>(dim));
 
         //Check how far the centroid has shifted
         double shift = distanceSquared(centroids[i], newCentroids[i]);
@@ -86,20 +135,33 @@ bool KMeans::updateCentroids(const Dataset& data) {
         }
     }
 
-    centroids = newCentroids;
+    // Move dead centroids onto the candidates found during the assignment pass
+    if (!emptyClusters.empty() && reseedTracker.active()) {
+        for (const auto& move : reseedTracker.choose(emptyClusters, result.clusterSSE)) {
+            const Point& seed = data[move.second];
+            maxShift = std::max(maxShift, distanceSquared(centroids[move.first], seed));
+            newCentroids[move.first].coords = seed.coords;
+            if (metric == DistanceMetric::COSINE) CentroidUpdate::normalize(newCentroids[move.first].coords.data(), static_cast<int>(dim));
+            result.reseededClusters++;
+        }
+    }
+
+    workspace.swapCentroids(centroids);
+    result.clusterSizes.assign(counts, counts + k);
 
     // Check the convergence (squared th, because of the squared value of distance)
     return maxShift < (threshold * threshold);
 }
 
-int KMeans::run(Dataset& data) {
+KMeansResult KMeans::run(Dataset& data) {
+    result = KMeansResult();
     if (data.empty() || k <= 0) {
         std::cerr << "Invalid data or k parameter." << std::endl;
-        return 0;
+        return result;
     }
     if (data.size() < static_cast<size_t>(k)) {
         std::cerr << "Error: Number of clusters k (" << k << ") is larger than dataset size (" << data.size() << ")." << std::endl;
-        return 0;
+        return result;
     }
 
     initTime = 0.0;
@@ -109,6 +171,10 @@ int KMeans::run(Dataset& data) {
     auto startInit = std::chrono::high_resolution_clock::now();
 
     initializeCentroids(data);
+    if (metric == DistanceMetric::COSINE) {
+        for (auto& c : centroids) CentroidUpdate::normalize(c.coords.data(), static_cast<int>(c.coords.size()));
+    }
+    workspace.prepare(1, k, static_cast<int>(data[0].coords.size()), emptyPolicy);
 
     auto endInit = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> diffInit = endInit - startInit;
@@ -116,8 +182,11 @@ int KMeans::run(Dataset& data) {
 
     int iter = 0;
     bool converged = false;
+    long long allocsAfterFirst = 0;
 
     while (iter < maxIter && !converged) {
+        // The first iteration may still grow buffers, everything after it must not allocate
+        if (iter == 1) allocsAfterFirst = AllocCounter::count();
 
         auto startAssign = std::chrono::high_resolution_clock::now();
         assignClusters(data);
@@ -133,6 +202,21 @@ int KMeans::run(Dataset& data) {
 
         iter++;
     }
+    steadyStateAllocations = iter > 1 ? AllocCounter::count() - allocsAfterFirst : 0;
+
+    result.iterations = iter;
+    result.converged = converged;
+    result.inertia = 0.0;
+    for (double s : result.clusterSSE) result.inertia += s;
+    if (silhouetteSample > 0) {
+        result.silhouette = ClusterMetrics::sampledSilhouette(data, k, silhouetteSample);
+    }
+
+    trainingInfo = ModelMetadata();
+    trainingInfo.numPoints = static_cast<int64_t>(data.size());
+    trainingInfo.iterations = iter;
+    trainingInfo.inertia = result.inertia;
+    trainingInfo.metric = metric;
 
     double totalTotalTime = initTime + totalAssignTime + totalUpdateTime;
 
@@ -141,6 +225,7 @@ int KMeans::run(Dataset& data) {
     std::cout << "========================================" << std::endl;
     std::cout << "Total Iterations: " << iter << std::endl;
     std::cout << "Total Wall Time:  " << totalTotalTime << " s" << std::endl;
+    std::cout << "Inertia (SSE):    " << result.inertia << std::endl;
     std::cout << "----------------------------------------" << std::endl;
     std::cout << "1. Initialization:      " << initTime << " s ("
               << (initTime / totalTotalTime) * 100.0 << "%)" << std::endl;
@@ -152,5 +237,5 @@ int KMeans::run(Dataset& data) {
               << (totalUpdateTime / totalTotalTime) * 100.0 << "%)" << std::endl;
     std::cout << "========================================\n" << std::endl;
 
-    return iter;
+    return result;
 }
\ No newline at end of file
@@ -0,0 +1,249 @@
+#include "../include/kmeans_model.h"
+#include "../include/distance_kernels.h"
+#include <omp.h>
+#include <cstring>
+#include <ctime>
+#include <new>
+#include <fstream>
+#include <iostream>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char MODEL_MAGIC[8] = {'K', 'M', 'H', 'P', 'C', 'M', 'D', 'L'};
+static constexpr size_t SECTION_ALIGN = 64;
+
+static size_t alignUp(size_t value) {
+    return (value + SECTION_ALIGN - 1) / SECTION_ALIGN * SECTION_ALIGN;
+}
+
+static std::shared_ptr<void> allocateAligned(size_t size) {
+    void* raw = ::operator new(size, std::align_val_t(SECTION_ALIGN));
+    std::memset(raw, 0, size);
+    return std::shared_ptr<void>(raw, [](void* p) { ::operator delete(p, std::align_val_t(SECTION_ALIGN)); });
+}
+
+// count elements of elemSize bytes at offset lie inside fileSize bytes, without overflowing
+static bool sectionFits(uint64_t offset, uint64_t count, uint64_t elemSize, uint64_t fileSize) {
+    return offset <= fileSize && count <= (fileSize - offset) / elemSize;
+}
+
+//Checks that a header describes a complete model that fits into `size` bytes
+static bool validateHeader(const ModelFileHeader* h, size_t size, const std::string& filename) {
+    if (size < sizeof(ModelFileHeader) || std::memcmp(h->magic, MODEL_MAGIC, sizeof(MODEL_MAGIC)) != 0) {
+        std::cerr << "Error: " << filename << " is not a k-means model file." << std::endl;
+        return false;
+    }
+    if (h->version != MODEL_FILE_VERSION || h->dtype != MODEL_DTYPE_FLOAT64) {
+        std::cerr << "Error: unsupported model version " << h->version << " / dtype " << h->dtype << "." << std::endl;
+        return false;
+    }
+    if (h->metric < 0 || h->metric > static_cast<int32_t>(DistanceMetric::MANHATTAN)) {
+        std::cerr << "Error: unknown distance metric " << h->metric << " in " << filename << "." << std::endl;
+        return false;
+    }
+    uint64_t k = h->k > 0 ? static_cast<uint64_t>(h->k) : 0;
+    uint64_t dim = h->dim > 0 ? static_cast<uint64_t>(h->dim) : 0;
+    bool aligned = h->centroidsOffset % sizeof(double) == 0 && h->normsOffset % sizeof(double) == 0
+                   && h->countsOffset % sizeof(int64_t) == 0;
+    if (k == 0 || dim == 0 || !aligned || h->fileSize > size
+        || h->centroidsOffset < sizeof(ModelFileHeader)
+        || !sectionFits(h->centroidsOffset, k * dim, sizeof(double), h->fileSize)
+        || !sectionFits(h->normsOffset, k, sizeof(double), h->fileSize)
+        || !sectionFits(h->countsOffset, k, sizeof(int64_t), h->fileSize)) {
+        std::cerr << "Error: model file " << filename << " is truncated or corrupted." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+KMeansModel::KMeansModel(const std::vector<Point>& trainedCentroids,
+                         const std::vector<long long>& clusterCounts,
+                         const ModelMetadata& metadata) {
+    const int numCentroids = static_cast<int>(trainedCentroids.size());
+    const int numDim = numCentroids > 0 ? static_cast<int>(trainedCentroids[0].coords.size()) : 0;
+    if (numCentroids == 0) return;
+
+    // Build the buffer exactly as it will be stored on disk
+    size_t centroidsOffset = alignUp(sizeof(ModelFileHeader));
+    size_t normsOffset = alignUp(centroidsOffset + static_cast<size_t>(numCentroids) * numDim * sizeof(double));
+    size_t countsOffset = alignUp(normsOffset + static_cast<size_t>(numCentroids) * sizeof(double));
+    size_t fileSize = alignUp(countsOffset + static_cast<size_t>(numCentroids) * sizeof(int64_t));
+
+    std::shared_ptr<void> buffer = allocateAligned(fileSize);
+    char* base = static_cast<char*>(buffer.get());
+
+    auto* h = reinterpret_cast<ModelFileHeader*>(base);
+    std::memcpy(h->magic, MODEL_MAGIC, sizeof(MODEL_MAGIC));
+    h->version = MODEL_FILE_VERSION;
+    h->dtype = MODEL_DTYPE_FLOAT64;
+    h->k = numCentroids;
+    h->dim = numDim;
+    h->numPoints = metadata.numPoints;
+    h->iterations = metadata.iterations;
+    h->metric = static_cast<int32_t>(metadata.metric);
+    h->inertia = metadata.inertia;
+    h->trainedAt = metadata.trainedAt != 0 ? metadata.trainedAt : static_cast<int64_t>(std::time(nullptr));
+    h->centroidsOffset = centroidsOffset;
+    h->normsOffset = normsOffset;
+    h->countsOffset = countsOffset;
+    h->fileSize = fileSize;
+
+    auto* c = reinterpret_cast<double*>(base + centroidsOffset);
+    auto* n = reinterpret_cast<double*>(base + normsOffset);
+    auto* cnt = reinterpret_cast<int64_t*>(base + countsOffset);
+    for (int j = 0; j < numCentroids; ++j) {
+        double norm = 0.0;
+        for (int d = 0; d < numDim; ++d) {
+            double v = trainedCentroids[j].coords[d];
+            c[static_cast<size_t>(j) * numDim + d] = v;
+            norm += v * v;
+        }
+        n[j] = norm;
+        cnt[j] = j < static_cast<int>(clusterCounts.size()) ? clusterCounts[j] : 0;
+    }
+
+    attach(std::move(buffer));
+}
+
+void KMeansModel::attach(std::shared_ptr<const void> buffer) {
+    backing = std::move(buffer);
+    const char* base = static_cast<const char*>(backing.get());
+
+    header = reinterpret_cast<const ModelFileHeader*>(base);
+    k = header->k;
+    dim = header->dim;
+    centroids = reinterpret_cast<const double*>(base + header->centroidsOffset);
+    norms = reinterpret_cast<const double*>(base + header->normsOffset);
+    counts = reinterpret_cast<const int64_t*>(base + header->countsOffset);
+    metric = static_cast<DistanceMetric>(header->metric);
+
+    useTree = metric == DistanceMetric::SQUARED_EUCLIDEAN && CentroidKDTree::isBeneficial(k, dim);
+    if (useTree) centroidTree.build(centroids, k, dim);
+}
+
+bool KMeansModel::save(const std::string& filename) const {
+    if (empty()) {
+        std::cerr << "Error: cannot save an empty model." << std::endl;
+        return false;
+    }
+
+    std::ofstream file(filename, std::ios::binary);
+    file.write(static_cast<const char*>(backing.get()), static_cast<std::streamsize>(header->fileSize));
+    if (!file) {
+        std::cerr << "Error: failed to write model file " << filename << "." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool KMeansModel::load(const std::string& filename) {
+    std::shared_ptr<const void> buffer;
+    size_t size = 0;
+
+#ifdef _WIN32
+    // No mmap here, a single read into an aligned block keeps the same in-place layout
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    if (!file) {
+        std::cerr << "Error: cannot open model file " << filename << "." << std::endl;
+        return false;
+    }
+    size = static_cast<size_t>(file.tellg());
+    std::shared_ptr<void> block = allocateAligned(alignUp(size == 0 ? 1 : size));
+    file.seekg(0);
+    file.read(static_cast<char*>(block.get()), static_cast<std::streamsize>(size));
+    if (!file || static_cast<size_t>(file.gcount()) != size) {
+        std::cerr << "Error: model file " << filename << " is truncated or corrupted." << std::endl;
+        return false;
+    }
+    buffer = block;
+#else
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Error: cannot open model file " << filename << "." << std::endl;
+        return false;
+    }
+    struct stat st {};
+    if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(ModelFileHeader))) {
+        close(fd);
+        std::cerr << "Error: model file " << filename << " is truncated or corrupted." << std::endl;
+        return false;
+    }
+    size = static_cast<size_t>(st.st_size);
+    void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        std::cerr << "Error: mmap of model file " << filename << " failed." << std::endl;
+        return false;
+    }
+    buffer = std::shared_ptr<const void>(addr, [size](const void* p) { munmap(const_cast<void*>(p), size); });
+#endif
+
+    if (!validateHeader(static_cast<const ModelFileHeader*>(buffer.get()), size, filename)) return false;
+
+    attach(std::move(buffer));
+    return true;
+}
+
+ModelMetadata KMeansModel::getMetadata() const {
+    ModelMetadata metadata;
+    if (header) {
+        metadata.numPoints = header->numPoints;
+        metadata.iterations = header->iterations;
+        metadata.inertia = header->inertia;
+        metadata.trainedAt = header->trainedAt;
+        metadata.metric = metric;
+    }
+    return metadata;
+}
+
+int KMeansModel::nearest(const double* point, double& dist) const {
+    if (useTree) return centroidTree.nearest(point, dist);
+    switch (metric) {
+        case DistanceMetric::COSINE: return nearestCentroidWith<CosineMetric>(point, centroids, k, dim, dist);
+        case DistanceMetric::MANHATTAN: return nearestCentroidWith<ManhattanMetric>(point, centroids, k, dim, dist);
+        default: return nearestCentroid(point, centroids, k, dim, dist);
+    }
+}
+
+int KMeansModel::predictOne(const double* point, double* distance) const {
+    double dist;
+    int label = nearest(point, dist);
+    if (distance) *distance = dist;
+    return label;
+}
+
+void KMeansModel::predict(const double* points, size_t n, int* labels, double* distances) const {
+    const long long count = static_cast<long long>(n);
+
+    // Small batches: the fork/join cost of a parallel region dominates, stay on this thread
+    if (n < PARALLEL_BATCH_THRESHOLD) {
+        for (long long i = 0; i < count; ++i) {
+            double dist;
+            labels[i] = nearest(points + i * dim, dist);
+            if (distances) distances[i] = dist;
+        }
+        return;
+    }
+
+    // Throughput path
+    #pragma omp parallel for schedule(static)
+    for (long long i = 0; i < count; ++i) {
+        double dist;
+        labels[i] = nearest(points + i * dim, dist);
+        if (distances) distances[i] = dist;
+    }
+}
+
+void KMeansModel::assign(Dataset& data) const {
+    const int n = static_cast<int>(data.size());
+
+    #pragma omp parallel for schedule(static) if(data.size() >= PARALLEL_BATCH_THRESHOLD)
+    for (int i = 0; i < n; ++i) {
+        double dist;
+        data[i].clusterId = nearest(data[i].coords.data(), dist);
+    }
+}
@@ -0,0 +1,56 @@
+#include "../include/kmeans_workspace.h"
+#include "../include/reproducible_sum.h"
+#include <algorithm>
+
+void KMeansWorkspace::prepare(int numWorkers, int numClusters, int numDim, EmptyClusterPolicy policy, int sumFolds) {
+    k = numClusters;
+    dim = numDim;
+    workers = numWorkers;
+    folds = sumFolds;
+
+    rows.assign(workers * rowStride(), 0.0);
+    counts.assign(workers * countStride(), 0);
+    reducedRow.assign(rowSize(), 0.0);
+    reducedCounts.assign(k, 0);
+
+    nextCentroids.resize(k);
+    for (auto& c : nextCentroids) c.coords.resize(dim, 0.0);
+
+    trackers.resize(workers);
+    for (auto& tracker : trackers) tracker.reset(policy, k);
+    emptyClusters.clear();
+    emptyClusters.reserve(k);
+}
+
+void KMeansWorkspace::resetAssignment(EmptyClusterPolicy policy) {
+    for (int w = 0; w < workers; ++w) {
+        std::fill(sse(w), sse(w) + static_cast<size_t>(folds) * k, 0.0);
+        trackers[w].reset(policy, k);
+    }
+}
+
+void KMeansWorkspace::resetSums() {
+    for (int w = 0; w < workers; ++w) {
+        std::fill(sums(w), sums(w) + static_cast<size_t>(folds) * k * dim, 0.0);
+        std::fill(weights(w), weights(w) + static_cast<size_t>(folds) * k, 0.0);
+    }
+    std::fill(counts.begin(), counts.end(), 0);
+}
+
+void KMeansWorkspace::reduceWorkers() {
+    std::fill(reducedRow.begin(), reducedRow.end(), 0.0);
+    std::fill(reducedCounts.begin(), reducedCounts.end(), 0);
+    for (int w = 0; w < workers; ++w) {
+        const double* row = sums(w);
+        for (int i = 0; i < rowSize(); ++i) reducedRow[i] += row[i];
+        const int* c = workerCounts(w);
+        for (int i = 0; i < k; ++i) reducedCounts[i] += c[i];
+    }
+}
+
+void KMeansWorkspace::collapseReduced() {
+    if (folds == 1) return;
+    // Value i reads folds [i * folds, (i + 1) * folds), never below i
+    const int values = k * dim + 2 * k;
+    for (int i = 0; i < values; ++i) reducedRow[i] = ReproducibleSum::value(reducedRow.data() + static_cast<size_t>(i) * folds);
+}
@@ -0,0 +1,115 @@
+#include "../include/label_writer.h"
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <omp.h>
+
+static const char LABEL_MAGIC[8] = {'K', 'M', 'L', 'A', 'B', 'E', 'L', 'S'};
+
+LabelFileHeader LabelWriter::makeHeader(long long n, long long firstIndex, bool withDistances) {
+    LabelFileHeader h {};
+    std::memcpy(h.magic, LABEL_MAGIC, sizeof(LABEL_MAGIC));
+    h.version = LABEL_FILE_VERSION;
+    h.flags = withDistances ? LABEL_FLAG_DISTANCES : 0;
+    h.numPoints = n;
+    h.firstIndex = firstIndex;
+    if (withDistances) {
+        uint64_t labelsEnd = sizeof(LabelFileHeader) + static_cast<uint64_t>(n) * sizeof(int32_t);
+        h.distancesOffset = (labelsEnd + 7) / 8 * 8;
+    }
+    return h;
+}
+
+std::string LabelWriter::formatCSV(const int* labels, const double* distances, size_t n,
+                                   long long firstIndex, bool withHeader) {
+    const long long count = static_cast<long long>(n);
+    std::vector<std::string> blocks(omp_get_max_threads());
+
+    #pragma omp parallel
+    {
+        std::string& out = blocks[omp_get_thread_num()];
+        // Widest fields: 20 digits + sign for the index, 11 for the label, 24 for a double
+        char row[96];
+
+        #pragma omp for schedule(static)
+        for (long long i = 0; i < count; ++i) {
+            char* p = std::to_chars(row, row + 24, firstIndex + i).ptr;
+            *p++ = ',';
+            p = std::to_chars(p, p + 12, labels[i]).ptr;
+            if (distances) {
+                *p++ = ',';
+                p = std::to_chars(p, p + 32, distances[i]).ptr; // shortest round-trip form
+            }
+            *p++ = '\n';
+            out.append(row, p);
+        }
+    }
+
+    std::string text = withHeader ? (distances ? "index,label,distance\n" : "index,label\n") : "";
+    size_t total = text.size();
+    for (const auto& b : blocks) total += b.size();
+    text.reserve(total);
+    for (const auto& b : blocks) text += b;
+    return text;
+}
+
+bool LabelWriter::write(const std::string& filename, LabelFormat format, const int* labels,
+                        const double* distances, size_t n, long long firstIndex) {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file) {
+        std::cerr << "Error: cannot open label file " << filename << "." << std::endl;
+        return false;
+    }
+
+    if (format == LabelFormat::CSV) {
+        std::string text = formatCSV(labels, distances, n, firstIndex, true);
+        file.write(text.data(), static_cast<std::streamsize>(text.size()));
+    } else {
+        LabelFileHeader h = makeHeader(static_cast<long long>(n), firstIndex, distances != nullptr);
+        file.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        file.write(reinterpret_cast<const char*>(labels), static_cast<std::streamsize>(n * sizeof(int32_t)));
+        if (distances) {
+            static const char zeros[8] = {};
+            size_t pad = h.distancesOffset - (sizeof(h) + n * sizeof(int32_t));
+            file.write(zeros, static_cast<std::streamsize>(pad));
+            file.write(reinterpret_cast<const char*>(distances), static_cast<std::streamsize>(n * sizeof(double)));
+        }
+    }
+
+    if (!file) {
+        std::cerr << "Error: failed to write label file " << filename << "." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+std::future<bool> LabelWriter::writeAsync(std::string filename, LabelFormat format, std::vector<int> labels,
+                                          std::vector<double> distances, long long firstIndex) {
+    return std::async(std::launch::async,
+                      [filename = std::move(filename), format, labels = std::move(labels),
+                       distances = std::move(distances), firstIndex]() {
+        return write(filename, format, labels.data(), distances.empty() ? nullptr : distances.data(),
+                     labels.size(), firstIndex);
+    });
+}
+
+void LabelWriter::extract(const Dataset& data, const std::vector<Point>& centroids,
+                          std::vector<int>& labels, std::vector<double>* distances, DistanceMetric metric) {
+    const long long n = static_cast<long long>(data.size());
+    labels.resize(n);
+    if (distances) distances->resize(n);
+
+    withMetric(metric, [&](auto policy) {
+        using Metric = decltype(policy);
+        #pragma omp parallel for schedule(static)
+        for (long long i = 0; i < n; ++i) {
+            int label = data[i].clusterId;
+            labels[i] = label;
+            if (distances) {
+                (*distances)[i] = label >= 0 ? Metric::distance(data[i].coords.data(), centroids[label].coords.data(),
+                                                                static_cast<int>(data[i].coords.size())) : 0.0;
+            }
+        }
+    });
+}
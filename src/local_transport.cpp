@@ -0,0 +1,268 @@
+#include "../include/local_transport.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <thread>
+#include <omp.h>
+
+namespace {
+
+template <class T>
+void combine(T* acc, const T* in, int count, CommOp op) {
+    for (int i = 0; i < count; ++i) {
+        switch (op) {
+            case CommOp::SUM: acc[i] += in[i]; break;
+            case CommOp::MIN: acc[i] = std::min(acc[i], in[i]); break;
+            case CommOp::MAX: acc[i] = std::max(acc[i], in[i]); break;
+            case CommOp::MAXLOC: break;
+        }
+    }
+}
+
+void combineMaxLoc(DoubleInt* acc, const DoubleInt* in, int count) {
+    for (int i = 0; i < count; ++i) {
+        if (in[i].value > acc[i].value || (in[i].value == acc[i].value && in[i].rank < acc[i].rank)) acc[i] = in[i];
+    }
+}
+
+double steadySeconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void sleepUs(double us) {
+    if (us > 0.0) std::this_thread::sleep_for(std::chrono::duration<double, std::micro>(us));
+}
+
+void combine(void* acc, const void* in, int count, CommDatatype type, CommOp op) {
+    switch (type) {
+        case CommDatatype::INT: combine(static_cast<int*>(acc), static_cast<const int*>(in), count, op); break;
+        case CommDatatype::LONG_LONG: combine(static_cast<long long*>(acc), static_cast<const long long*>(in), count, op); break;
+        case CommDatatype::FLOAT: combine(static_cast<float*>(acc), static_cast<const float*>(in), count, op); break;
+        case CommDatatype::DOUBLE: combine(static_cast<double*>(acc), static_cast<const double*>(in), count, op); break;
+        case CommDatatype::BYTE: combine(static_cast<char*>(acc), static_cast<const char*>(in), count, op); break;
+        case CommDatatype::DOUBLE_INT:
+            combineMaxLoc(static_cast<DoubleInt*>(acc), static_cast<const DoubleInt*>(in), count);
+            break;
+    }
+}
+
+}
+
+LocalCluster::LocalCluster(int numRanks, const LocalLatency& cost)
+    : size(numRanks), latency(cost), published(numRanks, nullptr), publishedCounts(numRanks, nullptr),
+      publishedDispls(numRanks, nullptr), failed(numRanks, 0) {}
+
+void LocalCluster::barrier() {
+    std::unique_lock<std::mutex> lock(mutex);
+    const long long current = generation;
+    if (++arrived == size) {
+        arrived = 0;
+        generation++;
+        released.notify_all();
+        return;
+    }
+    released.wait(lock, [&] { return generation != current; });
+}
+
+void LocalCluster::startReduction(long long sequence, int rank, const void* data, int count, CommDatatype type,
+                                  CommOp op, double readyAt) {
+    const size_t bytes = static_cast<size_t>(count) * commDatatypeSize(type);
+    std::lock_guard<std::mutex> lock(mutex);
+    PendingReduction& reduction = pending[sequence];
+    if (reduction.contributions.empty()) reduction.contributions.resize(size);
+    const char* bytesIn = static_cast<const char*>(data);
+    reduction.contributions[rank].assign(bytesIn, bytesIn + bytes);
+    reduction.readyAt = std::max(reduction.readyAt, readyAt);
+    if (++reduction.arrived < size) return;
+
+    reduction.result = std::move(reduction.contributions[0]);
+    for (int r = 1; r < size; ++r) combine(reduction.result.data(), reduction.contributions[r].data(), count, type, op);
+    reduction.contributions.clear();
+    reduction.done = true;
+    reduced.notify_all();
+}
+
+bool LocalCluster::collectReduction(long long sequence, void* recv, bool blocking) {
+    std::unique_lock<std::mutex> lock(mutex);
+    PendingReduction* reduction = &pending[sequence];
+    if (!blocking && (!reduction->done || steadySeconds() < reduction->readyAt)) return false;
+    reduced.wait(lock, [&] { return reduction->done; });
+    const double remaining = reduction->readyAt - steadySeconds();
+    if (remaining > 0.0) {
+        // The entry stays until this rank has collected it, so the pointer survives the sleep
+        lock.unlock();
+        sleepUs(remaining * 1e6);
+        lock.lock();
+    }
+    std::memcpy(recv, reduction->result.data(), reduction->result.size());
+    if (++reduction->collected == size) pending.erase(sequence);
+    return true;
+}
+
+LocalTransport::LocalTransport(std::shared_ptr<LocalCluster> cluster, int rank)
+    : cluster(std::move(cluster)), localRank(rank), jitter(0x9E3779B97F4A7C15ull * (rank + 1)) {}
+
+void LocalTransport::launch(int numRanks, const LocalLatency& latency, const std::function<void(Transport&)>& body) {
+    auto cluster = std::make_shared<LocalCluster>(numRanks, latency);
+    const int threadsPerRank = std::max(1, omp_get_max_threads() / numRanks);
+
+    std::vector<std::thread> ranks;
+    for (int r = 0; r < numRanks; ++r) {
+        ranks.emplace_back([&, r] {
+            // nthreads-var is per thread, so every rank gets its own share of the cores
+            omp_set_num_threads(threadsPerRank);
+            LocalTransport transport(cluster, r);
+            body(transport);
+        });
+    }
+    for (auto& t : ranks) t.join();
+}
+
+double LocalTransport::wtime() const {
+    return steadySeconds();
+}
+
+double LocalTransport::costUs(size_t bytes) const {
+    const LocalLatency& cost = cluster->latency;
+    double us = cost.latencyUs;
+    if (cost.bandwidthGBs > 0.0) us += static_cast<double>(bytes) / (cost.bandwidthGBs * 1e3);
+    return us;
+}
+
+double LocalTransport::drawJitterUs() {
+    const double mean = cluster->latency.jitterUs;
+    return mean > 0.0 ? std::exponential_distribution<double>(1.0 / mean)(jitter) : 0.0;
+}
+
+void LocalTransport::charge(size_t bytes) {
+    sleepUs(costUs(bytes) + drawJitterUs());
+}
+
+void LocalTransport::barrier() {
+    cluster->barrier();
+    charge(0);
+}
+
+void LocalTransport::bcast(void* data, int count, CommDatatype type, int root) {
+    const size_t bytes = static_cast<size_t>(count) * commDatatypeSize(type);
+    if (localRank == root) cluster->published[root] = data;
+    cluster->barrier();
+    if (localRank != root) std::memcpy(data, cluster->published[root], bytes);
+    cluster->barrier();
+    charge(bytes);
+}
+
+void LocalTransport::allreduce(void* data, int count, CommDatatype type, CommOp op) {
+    const size_t bytes = static_cast<size_t>(count) * commDatatypeSize(type);
+    cluster->published[localRank] = data;
+    cluster->barrier();
+
+    // Every rank reduces all contributions in rank order into its own scratch
+    if (scratch.size() < bytes) scratch.resize(bytes);
+    std::memcpy(scratch.data(), cluster->published[0], bytes);
+    for (int r = 1; r < cluster->size; ++r) combine(scratch.data(), cluster->published[r], count, type, op);
+    cluster->barrier();
+
+    std::memcpy(data, scratch.data(), bytes);
+    charge(bytes);
+}
+
+CommRequest LocalTransport::iallreduce(const void* send, void* recv, int count, CommDatatype type, CommOp op) {
+    const size_t bytes = static_cast<size_t>(count) * commDatatypeSize(type);
+    // The jitter delays this rank only, the transfer itself overlaps with whatever comes next
+    sleepUs(drawJitterUs());
+    const double readyAt = wtime() + costUs(bytes) * 1e-6;
+    const long long sequence = nextSequence++;
+    cluster->startReduction(sequence, localRank, send, count, type, op, readyAt);
+
+    auto slot = std::find_if(requests.begin(), requests.end(), [](const Request& r) { return r.sequence < 0; });
+    if (slot == requests.end()) slot = requests.insert(requests.end(), Request());
+    slot->sequence = sequence;
+    slot->recv = recv;
+    return static_cast<CommRequest>(slot - requests.begin());
+}
+
+bool LocalTransport::test(CommRequest request) {
+    Request& r = requests[request];
+    if (r.sequence < 0) return true;
+    if (!cluster->collectReduction(r.sequence, r.recv, false)) return false;
+    r.sequence = -1;
+    return true;
+}
+
+void LocalTransport::wait(CommRequest request) {
+    Request& r = requests[request];
+    if (r.sequence < 0) return;
+    cluster->collectReduction(r.sequence, r.recv, true);
+    r.sequence = -1;
+}
+
+void LocalTransport::allgather(const void* send, int count, CommDatatype type, void* recv) {
+    const size_t bytes = static_cast<size_t>(count) * commDatatypeSize(type);
+    cluster->published[localRank] = send;
+    cluster->barrier();
+    for (int r = 0; r < cluster->size; ++r) {
+        std::memcpy(static_cast<char*>(recv) + r * bytes, cluster->published[r], bytes);
+    }
+    cluster->barrier();
+    charge(bytes * cluster->size);
+}
+
+void LocalTransport::gatherv(const void* send, int count, CommDatatype type,
+                             void* recv, const int* counts, const int* displs, int root) {
+    const size_t size = commDatatypeSize(type);
+    cluster->published[localRank] = send;
+    cluster->barrier();
+    if (localRank == root) {
+        for (int r = 0; r < cluster->size; ++r) {
+            std::memcpy(static_cast<char*>(recv) + static_cast<size_t>(displs[r]) * size, cluster->published[r],
+                        static_cast<size_t>(counts[r]) * size);
+        }
+    }
+    cluster->barrier();
+    charge(static_cast<size_t>(count) * size);
+}
+
+void LocalTransport::scatterv(const void* send, const int* counts, const int* displs, CommDatatype type,
+                              void* recv, int count, int root) {
+    const size_t size = commDatatypeSize(type);
+    if (localRank == root) {
+        cluster->published[root] = send;
+        cluster->publishedCounts[root] = counts;
+        cluster->publishedDispls[root] = displs;
+    }
+    cluster->barrier();
+    const int available = cluster->publishedCounts[root][localRank];
+    const char* from = static_cast<const char*>(cluster->published[root])
+                       + static_cast<size_t>(cluster->publishedDispls[root][localRank]) * size;
+    std::memcpy(recv, from, static_cast<size_t>(std::min(count, available)) * size);
+    cluster->barrier();
+    charge(static_cast<size_t>(count) * size);
+}
+
+bool LocalTransport::writeShared(const std::string& filename, const std::vector<FileBlock>& blocks) {
+    // Rank 0 truncates, then every rank writes its blocks through its own handle
+    cluster->failed[localRank] = 0;
+    if (localRank == 0) {
+        std::ofstream create(filename, std::ios::binary | std::ios::trunc);
+        cluster->failed[0] = create ? 0 : 1;
+    }
+    cluster->barrier();
+
+    if (cluster->failed[0]) {
+        cluster->failed[localRank] = 1;
+    } else {
+        std::fstream file(filename, std::ios::binary | std::ios::in | std::ios::out);
+        for (const FileBlock& block : blocks) {
+            file.seekp(block.offset);
+            file.write(static_cast<const char*>(block.data), static_cast<std::streamsize>(block.bytes));
+        }
+        if (!file) cluster->failed[localRank] = 1;
+    }
+    cluster->barrier();
+
+    bool ok = std::none_of(cluster->failed.begin(), cluster->failed.end(), [](int f) { return f != 0; });
+    cluster->barrier();
+    return ok;
+}
@@ -5,16 +5,31 @@
 #include <numeric>
 #include <algorithm>
 #include <iomanip>
+#include <cstdlib>
+#include <cmath>
+#ifdef USE_MPI
 #include <mpi.h>
+#endif
 #include <omp.h>
 #include <fstream>
 #include "../include/data_loader.h"
 #include "../include/kmeans.h"
 #include "../include/parallel_kmeans.h"
 #include "../include/distributed_kmeans.h"
+#include "../include/local_transport.h"
 #include "../include/utils.h"
 #include "../include/profiler_utils.h"
 #include "../include/old_parallel_kmeans.h"
+#include "../include/centroid_kdtree.h"
+#include "../include/distance_kernels.h"
+#include "../include/multi_run_kmeans.h"
+#include "../include/alloc_counter.h"
+#include "../include/coreset.h"
+#include "../include/bisecting_kmeans.h"
+#include "../include/label_writer.h"
+#include "../include/stream_service.h"
+#include "../include/run_planner.h"
+#include "../include/job_runner.h"
 
 void runTest() {
     std::cout <<"--- Running Data Generation Test ---" << std::endl;
@@ -23,84 +38,54 @@ void runTest() {
     Dataset data = DataLoader::generateData(numPoints, dim, 0.0, 100.0);
 
     DataLoader::printData(data, numPoints);
-    std::cout << "--- Test Finished! ---" << std::endl;
-}
-
-void runKMeansSequential(int repeat = 5) {
-    std::cout << "--- Running Sequential K-Means benchmark ---" << std::endl;
-
-    int numPoints = 5000000;
-    int dim = 3;
-    int k = 10;
-    int maxIters = 150;
-
-
-    Dataset dataTemp = DataLoader::generateData(numPoints, dim, 0.0, 1000.0);
 
-    for (int i = 0; i < repeat; ++i) {
-        Dataset data = dataTemp;
-
-        std::cin.get();
-
-        KMeans kmeans(k, maxIters);
-
-        double startCpu = ResourceProfiler::getCPUTime();
-        auto startWall = std::chrono::high_resolution_clock::now();
-
-        int iters = kmeans.run(data);
-
-        auto endWall = std::chrono::high_resolution_clock::now();
-        double endCpu = ResourceProfiler::getCPUTime();
-
-        std::chrono::duration<double> elapsedWall = endWall - startWall;
-        double elapsedCpu = endCpu - startCpu;
-
-        // Calculate utilization (100% = 1 core fully loaded)
-        double utilization = (elapsedCpu / elapsedWall.count()) * 100.0;
-
-        std::cout << "Run " << (i + 1) << "/" << repeat
-                  << " | Wall: " << std::fixed << std::setprecision(4) << elapsedWall.count() << "s"
-                  << " | CPU: " << elapsedCpu << "s"
-                  << " | Load: " << std::setprecision(1) << utilization << "%"
-                  << " (" << iters << " iters)" << std::endl;
+    // Blobs with ground truth, generated twice with different thread counts
+    GeneratorSpec spec;
+    spec.distribution = DataDistribution::ANISOTROPIC_BLOBS;
+    spec.dim = dim;
+    spec.numClusters = 3;
+    spec.seed = 42;
+    std::vector<int> labels;
+    int threads = omp_get_max_threads();
+    omp_set_num_threads(1);
+    Dataset blobsSerial = DataLoader::generate(spec, 100000);
+    omp_set_num_threads(threads);
+    Dataset blobs = DataLoader::generate(spec, 100000, &labels);
+    DataLoader::printData(blobs, numPoints);
+
+    // A rank generating only its own slice must see the same points
+    std::vector<double> slice(static_cast<size_t>(1000) * dim);
+    DataLoader::generateInto(spec, 50000, 1000, slice.data());
+
+    bool identical = true;
+    for (size_t i = 0; i < blobs.size(); ++i) identical = identical && blobs[i].coords == blobsSerial[i].coords;
+    for (int i = 0; i < 1000; ++i) {
+        for (int d = 0; d < dim; ++d) identical = identical && slice[static_cast<size_t>(i) * dim + d] == blobs[50000 + i].coords[d];
     }
-}
-
-void runKMeansParallel(int repeat = 10) {
-    std::cout << "--- Running Parallel K-Means (Optimized) benchmark ---" << std::endl;
-
-    int numPoints = 5000000;
-    int dim = 3;
-    int k = 10;
-    int maxIters = 150;
-
-
-    Dataset dataTemp = DataLoader::generateData(numPoints, dim, 0.0, 1000.0);
-
-    for (int i = 0; i < repeat; ++i) {
-        Dataset data = dataTemp;
-        ParallelKMeans kmeans(k, maxIters);
-
-        std::cin.get();
-
-        double startCpu = ResourceProfiler::getCPUTime();
-        auto startWall = std::chrono::high_resolution_clock::now();
-
-        int iters = kmeans.run(data);
-
-        auto endWall = std::chrono::high_resolution_clock::now();
-        double endCpu = ResourceProfiler::getCPUTime();
-
-        std::chrono::duration<double> elapsedWall = endWall - startWall;
-        double elapsedCpu = endCpu - startCpu;
-        double utilization = (elapsedCpu / elapsedWall.count()) * 100.0;
-
-        std::cout << "Run " << (i + 1) << "/" << repeat
-                  << " | Wall: " << std::fixed << std::setprecision(4) << elapsedWall.count() << "s"
-                  << " | CPU: " << elapsedCpu << "s"
-                  << " | Load: " << std::setprecision(1) << utilization << "%"
-                  << " (" << iters << " iters)" << std::endl;
+    std::cout << "Deterministic across threads/slices: " << (identical ? "YES" : "NO") << std::endl;
+
+    // Weighted points must behave like the same points repeated weight times
+    Dataset weighted(blobs.begin(), blobs.begin() + 2000);
+    Dataset expanded;
+    for (size_t i = 0; i < weighted.size(); ++i) {
+        weighted[i].weight = static_cast<double>(1 + i % 4);
+        for (int r = 0; r < static_cast<int>(weighted[i].weight); ++r) expanded.push_back(Point(weighted[i].coords));
+    }
+    std::vector<Point> initial(weighted.begin(), weighted.begin() + 3);
+    KMeans weightedRun(3, 20, 0.0), expandedRun(3, 20, 0.0);
+    weightedRun.setInitialCentroids(initial);
+    expandedRun.setInitialCentroids(initial);
+    double weightedInertia = weightedRun.run(weighted).inertia;
+    double expandedInertia = expandedRun.run(expanded).inertia;
+
+    double maxDiff = std::abs(weightedInertia - expandedInertia) / expandedInertia;
+    for (int j = 0; j < 3; ++j) {
+        for (int d = 0; d < dim; ++d) {
+            maxDiff = std::max(maxDiff, std::abs(weightedRun.getCentroids()[j].coords[d] - expandedRun.getCentroids()[j].coords[d]));
+        }
     }
+    std::cout << "Weighted == expanded duplicates: " << (maxDiff < 1e-9 ? "YES" : "NO") << std::endl;
+    std::cout << "--- Test Finished! ---" << std::endl;
 }
 
 void runOldParallelKMeans() {
@@ -115,8 +100,6 @@ void runOldParallelKMeans() {
 
     OldParallelKMeans oldKmeans(k, maxIters);
 
-    std::cin.get();
-
     double startCpu = ResourceProfiler::getCPUTime();
     auto startWall = std::chrono::high_resolution_clock::now();
 
@@ -136,69 +119,6 @@ void runOldParallelKMeans() {
     std::cout << "Iterations:      " << iters << std::endl;
 }
 
-void runKMeansDistributed(int repeat = 10) {
-    int world_rank, world_size;
-    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
-    MPI_Comm_size(MPI_COMM_WORLD, &world_size);
-
-    int numPoints = 5000000;
-    int dim = 3;
-    int k = 10;
-    int maxIters = 150;
-
-    Dataset dataTemp;
-
-    if (world_rank == 0) {
-        std::cout << "--- Running Distributed K-Means (MPI) benchmark ---" << std::endl;
-        std::cout << "Nodes: " << world_size << " | Points: " << numPoints << std::endl;
-        dataTemp = DataLoader::generateData(numPoints, dim, 0.0, 1000.0);
-    }
-
-    MPI_Barrier(MPI_COMM_WORLD);
-
-    for (int i = 0; i < repeat; ++i) {
-        Dataset data;
-        if (world_rank == 0) {
-            data = dataTemp;
-        }
-
-        DistributedKMeans mpiKmeans(k, maxIters);
-
-        MPI_Barrier(MPI_COMM_WORLD);
-
-        auto startWall = std::chrono::high_resolution_clock::now();
-
-        double startCpuLocal = ResourceProfiler::getCPUTime();
-
-        int iters = mpiKmeans.run(data);
-
-        double endCpuLocal = ResourceProfiler::getCPUTime();
-
-        MPI_Barrier(MPI_COMM_WORLD);
-
-        auto endWall = std::chrono::high_resolution_clock::now();
-
-        double elapsedCpuLocal = endCpuLocal - startCpuLocal;
-        std::chrono::duration<double> elapsedWall = endWall - startWall;
-
-        double totalCpuTimeAllNodes = 0.0;
-
-        MPI_Reduce(&elapsedCpuLocal, &totalCpuTimeAllNodes, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
-
-        if (world_rank == 0) {
-            double maxPossibleCpuTime = elapsedWall.count() * world_size;
-            double utilization = (totalCpuTimeAllNodes / maxPossibleCpuTime) * 100.0;
-
-            std::cout << "Run " << (i + 1) << "/" << repeat
-                      << " | Wall: " << std::fixed << std::setprecision(4) << elapsedWall.count() << "s"
-                      << " | Total CPU: " << std::setprecision(4) << totalCpuTimeAllNodes << "s"
-                      << " | Cluster Load: " << std::setprecision(1) << utilization << "%"
-                      << " (" << iters << " iters)" << std::endl;
-        }
-    }
-}
-
-
 void runScalabilityAnalysis() {
     std::cout << "--- Running Scalability Analysis (Strong Scaling) ---" << std::endl;
 
@@ -254,9 +174,8 @@ void runScalabilityAnalysis() {
 }
 
 
-void runComparison() {
-    int rank;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+void runComparison(Transport& world) {
+    int rank = world.rank();
 
     int numPoints = 200000;
     int dim = 3;
@@ -286,12 +205,13 @@ void runComparison() {
 
         KMeans seq(k, maxIters);
         auto start = std::chrono::high_resolution_clock::now();
-        iterSeq = seq.run(dataSeq);
+        KMeansResult res = seq.run(dataSeq);
+        iterSeq = res.iterations;
         auto end = std::chrono::high_resolution_clock::now();
 
         std::chrono::duration<double> elapsed = end - start;
         timeSeq = elapsed.count();
-        std::cout << "   Time: " << timeSeq << "s, Iters: " << iterSeq << std::endl;
+        std::cout << "   Time: " << timeSeq << "s, Iters: " << iterSeq << ", Inertia: " << res.inertia << std::endl;
     }
 
     if (rank == 0) {
@@ -300,15 +220,16 @@ void runComparison() {
 
         ParallelKMeans par(k, maxIters);
         auto start = std::chrono::high_resolution_clock::now();
-        iterPar = par.run(dataPar);
+        KMeansResult res = par.run(dataPar);
+        iterPar = res.iterations;
         auto end = std::chrono::high_resolution_clock::now();
 
         std::chrono::duration<double> elapsed = end - start;
         timePar = elapsed.count();
-        std::cout << "   Time: " << timePar << "s, Iters: " << iterPar << std::endl;
+        std::cout << "   Time: " << timePar << "s, Iters: " << iterPar << ", Inertia: " << res.inertia << std::endl;
     }
 
-    MPI_Barrier(MPI_COMM_WORLD);
+    world.barrier();
 
     if (rank == 0) std::cout << "\n3. Distributed K-Means (MPI)..." << std::endl;
 
@@ -317,20 +238,21 @@ void runComparison() {
         dataDist = dataOriginal;
     }
 
-    DistributedKMeans dist(k, maxIters);
+    DistributedKMeans dist(k, maxIters, 1e-4, world);
 
-    MPI_Barrier(MPI_COMM_WORLD);
+    world.barrier();
     auto startDistTime = std::chrono::high_resolution_clock::now();
 
-    iterDist = dist.run(dataDist);
+    KMeansResult resDist = dist.run(dataDist);
+    iterDist = resDist.iterations;
 
-    MPI_Barrier(MPI_COMM_WORLD);
+    world.barrier();
     auto endDistTime = std::chrono::high_resolution_clock::now();
 
     if (rank == 0) {
         std::chrono::duration<double> elapsed = endDistTime - startDistTime;
         timeDist = elapsed.count();
-        std::cout << "   Time: " << timeDist << "s, Iters: " << iterDist << std::endl;
+        std::cout << "   Time: " << timeDist << "s, Iters: " << iterDist << ", Inertia: " << resDist.inertia << std::endl;
     }
 
     if (rank == 0) {
@@ -391,56 +313,1163 @@ void runEmpiricalAnalysis() {
     std::cout << "Results saved to 'empirical_results.csv'. Run Python script now." << std::endl;
 }
 
-int main(int argc, char* argv[]) {
-    int provided;
-    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+void runPredictBenchmark() {
+    std::cout << "--- Running Batch Inference (predict) benchmark ---" << std::endl;
 
-    int rank;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    int trainPoints = 200000;
+    int scorePoints = 5000000;
+    int dim = 3;
+    int k = 10;
+    int maxIters = 150;
+
+    Dataset train = DataLoader::generateData(trainPoints, dim, 0.0, 1000.0);
+    ParallelKMeans kmeans(k, maxIters);
+    kmeans.run(train);
+    // Round trip through the model file, as a scoring service would cold-start
+    if (!kmeans.getModel().save("kmeans_model.bin")) return;
+    KMeansModel model;
+    auto startLoad = std::chrono::high_resolution_clock::now();
+    if (!model.load("kmeans_model.bin")) return;
+    auto endLoad = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> loadTime = endLoad - startLoad;
+    std::cout << "Model saved to 'kmeans_model.bin', load took " << std::fixed << std::setprecision(2)
+              << loadTime.count() * 1e6 << " us" << std::endl;
+
+    // Scoring input arrives as one contiguous batch
+    Dataset score = DataLoader::generateData(scorePoints, dim, 0.0, 1000.0);
+    std::vector<double> batch(static_cast<size_t>(scorePoints) * dim);
+    for (int i = 0; i < scorePoints; ++i) {
+        for (int d = 0; d < dim; ++d) batch[static_cast<size_t>(i) * dim + d] = score[i].coords[d];
+    }
+    std::vector<int> labels(scorePoints);
+    std::vector<double> distances(scorePoints);
+
+    // Throughput path
+    auto start = std::chrono::high_resolution_clock::now();
+    model.predict(batch.data(), scorePoints, labels.data(), distances.data());
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed = end - start;
+    std::cout << "Large batch: " << scorePoints << " points in " << std::fixed << std::setprecision(4)
+              << elapsed.count() << "s (" << std::setprecision(1) << scorePoints / elapsed.count() / 1e6
+              << " M points/s)" << std::endl;
+
+    // Low-latency path, many small requests
+    int smallBatch = 64;
+    int requests = 10000;
+    start = std::chrono::high_resolution_clock::now();
+    for (int r = 0; r < requests; ++r) {
+        size_t offset = static_cast<size_t>(r % (scorePoints / smallBatch)) * smallBatch;
+        model.predict(batch.data() + offset * dim, smallBatch, labels.data(), distances.data());
+    }
+    end = std::chrono::high_resolution_clock::now();
+    elapsed = end - start;
+    std::cout << "Small batches: " << requests << " x " << smallBatch << " points, "
+              << std::setprecision(2) << elapsed.count() / requests * 1e6 << " us per request" << std::endl;
+}
+
+void runKDTreeBenchmark() {
+    std::cout << "--- Nearest-centroid search: k-d tree vs brute force (one assignment pass) ---" << std::endl;
+
+    int numPoints = 200000;
+    std::vector<int> dims = {2, 3, 5, 8};
+    std::vector<int> ks = {16, 64, 256, 1024, 4096, 16384};
+
+    std::cout << "Dim,K,Brute_s,KDTree_s,Speedup,Auto" << std::endl;
+    for (int dim : dims) {
+        Dataset data = DataLoader::generateData(numPoints, dim, 0.0, 1000.0);
+        for (int k : ks) {
+            Dataset centroidPoints = DataLoader::generateData(k, dim, 0.0, 1000.0);
+            std::vector<double> flat(static_cast<size_t>(k) * dim);
+            for (int j = 0; j < k; ++j) {
+                for (int d = 0; d < dim; ++d) flat[static_cast<size_t>(j) * dim + d] = centroidPoints[j].coords[d];
+            }
+
+            std::vector<int> bruteLabels(numPoints), treeLabels(numPoints);
+
+            auto start = std::chrono::high_resolution_clock::now();
+            #pragma omp parallel for
+            for (int i = 0; i < numPoints; ++i) {
+                double dist;
+                bruteLabels[i] = nearestCentroid(data[i].coords.data(), flat.data(), k, dim, dist);
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            std::chrono::duration<double> bruteTime = end - start;
+
+            // Rebuild is part of the per-iteration cost, so it is timed too
+            start = std::chrono::high_resolution_clock::now();
+            CentroidKDTree tree;
+            tree.build(flat.data(), k, dim);
+            #pragma omp parallel for schedule(dynamic, 1024)
+            for (int i = 0; i < numPoints; ++i) {
+                double dist;
+                treeLabels[i] = tree.nearest(data[i].coords.data(), dist);
+            }
+            end = std::chrono::high_resolution_clock::now();
+            std::chrono::duration<double> treeTime = end - start;
+
+            if (bruteLabels != treeLabels) {
+                std::cerr << "Mismatch between k-d tree and brute force (dim=" << dim << ", k=" << k << ")" << std::endl;
+            }
+
+            std::cout << dim << "," << k << ","
+                      << std::fixed << std::setprecision(5) << bruteTime.count() << ","
+                      << treeTime.count() << ","
+                      << std::setprecision(2) << bruteTime.count() / treeTime.count() << ","
+                      << (CentroidKDTree::isBeneficial(k, dim) ? "kdtree" : "brute") << std::endl;
+        }
+    }
+}
+
+void runMultiRunComparison() {
+    std::cout << "--- Multi-restart / k-sweep: shared data pass vs separate runs ---" << std::endl;
+
+    int numPoints = 1000000;
+    int dim = 3;
+    int nInit = 5;
+    std::vector<int> ks = {5, 10, 20};
+    int maxIters = 150;
+
+    Dataset data = DataLoader::generateData(numPoints, dim, 0.0, 1000.0);
+
+    // Baseline: one ParallelKMeans per (k, restart), each on its own copy of the data
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int k : ks) {
+        for (int r = 0; r < nInit; ++r) {
+            Dataset copy = data;
+            ParallelKMeans kmeans(k, maxIters);
+            kmeans.run(copy);
+        }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> separateTime = end - start;
+
+    start = std::chrono::high_resolution_clock::now();
+    MultiRunKMeans multi(ks, nInit, maxIters);
+    int passes = multi.run(data);
+    end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> sharedTime = end - start;
+
+    for (const auto& best : multi.getBestRuns()) {
+        std::cout << "k=" << best.k << " best restart " << best.restart
+                  << " | inertia: " << std::scientific << std::setprecision(6) << best.inertia
+                  << " | iters: " << best.iterations << std::endl;
+    }
+    std::cout << "Separate runs: " << std::fixed << std::setprecision(4) << separateTime.count() << "s" << std::endl;
+    std::cout << "Shared passes: " << sharedTime.count() << "s (" << passes << " data passes)" << std::endl;
+}
 
+void runMetricComparison() {
+    std::cout << "--- Distance metrics: squared euclidean vs spherical (cosine) vs k-medians (manhattan) ---" << std::endl;
+
+    // High enough dim for the brute-force scan, so every metric runs the same loop shape
+    GeneratorSpec spec;
+    spec.distribution = DataDistribution::GAUSSIAN_MIXTURE;
+    spec.dim = 32;
+    spec.numClusters = 32;
+    spec.seed = 9;
+    Dataset data = DataLoader::generate(spec, 500000);
+    int k = 32;
+    int maxIters = 10;
+    std::vector<Point> initial(data.begin(), data.begin() + k);
+
+    std::cout << "Metric,Time_s,Per_iter_ms,Objective,Model_label_mismatches" << std::endl;
+    for (DistanceMetric metric : {DistanceMetric::SQUARED_EUCLIDEAN, DistanceMetric::COSINE, DistanceMetric::MANHATTAN}) {
+        ParallelKMeans kmeans(k, maxIters, 0.0);
+        kmeans.setDistanceMetric(metric);
+        kmeans.setInitialCentroids(initial);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        KMeansResult result = kmeans.run(data);
+        std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+        // The model keeps the metric, so scoring with it must agree with a direct scan of the same metric
+        Dataset check = data;
+        kmeans.getModel().assign(check);
+        std::vector<double> flat;
+        for (const auto& c : kmeans.getCentroids()) flat.insert(flat.end(), c.coords.begin(), c.coords.end());
+        long long mismatched = 0;
+        withMetric(metric, [&](auto policy) {
+            using Metric = decltype(policy);
+            #pragma omp parallel for reduction(+:mismatched)
+            for (long long i = 0; i < static_cast<long long>(check.size()); ++i) {
+                double dist;
+                mismatched += check[i].clusterId != nearestCentroidWith<Metric>(check[i].coords.data(), flat.data(), k, spec.dim, dist);
+            }
+        });
+
+        std::cout << metricName(metric) << "," << std::fixed << std::setprecision(4) << elapsed.count() << ","
+                  << std::setprecision(2) << elapsed.count() * 1000.0 / std::max(1, result.iterations) << ","
+                  << std::setprecision(4) << result.inertia << "," << mismatched << std::endl;
+    }
+}
+
+void runPoolComparison() {
+    std::cout << "--- Scheduling backends: OpenMP worksharing vs work-stealing pool ---" << std::endl;
+
+    // Clustered data with many centroids in 2D takes the k-d tree path, where the pruning
+    // makes the cost per point depend on its neighbourhood
+    GeneratorSpec spec;
+    spec.distribution = DataDistribution::GAUSSIAN_MIXTURE;
+    spec.dim = 2;
+    spec.numClusters = 64;
+    spec.clusterStd = 15.0;
+    spec.seed = 7;
+    Dataset data = DataLoader::generate(spec, 1000000);
+
+    std::vector<int> ks = {16, 256, 2048};
+    int maxIters = 20;
+
+    std::cout << "Threads: " << omp_get_max_threads() << std::endl;
+    std::cout << "K,Backend,Time_s,Per_iter_ms,Inertia,Stolen_chunks" << std::endl;
+    for (int k : ks) {
+        for (ExecutionBackend backend : {ExecutionBackend::OPENMP, ExecutionBackend::THREAD_POOL}) {
+            ParallelKMeans kmeans(k, maxIters, 0.0);
+            kmeans.setExecutionBackend(backend);
+
+            auto start = std::chrono::high_resolution_clock::now();
+            KMeansResult result = kmeans.run(data);
+            auto end = std::chrono::high_resolution_clock::now();
+            std::chrono::duration<double> elapsed = end - start;
+
+            std::cout << k << "," << (backend == ExecutionBackend::OPENMP ? "openmp" : "pool") << ","
+                      << std::fixed << std::setprecision(4) << elapsed.count() << ","
+                      << std::setprecision(2) << elapsed.count() * 1000.0 / std::max(1, result.iterations) << ","
+                      << std::setprecision(1) << result.inertia << ","
+                      << kmeans.getStolenChunks() << std::endl;
+        }
+    }
+}
+
+void runAllocationCheck(Transport& world) {
+    int rank = world.rank();
+
+    if (rank == 0) std::cout << "--- Steady-state heap allocations per engine ---" << std::endl;
+    if (!AllocCounter::enabled()) {
+        if (rank == 0) std::cout << "Allocation counting is disabled, rebuild with -DKMEANS_ALLOC_HOOK." << std::endl;
+        return;
+    }
+
+    int numPoints = 200000;
+    int dim = 3;
+    int maxIters = 20;
+    bool failed = false;
+
+    // k = 8 takes the brute-force path, k = 128 the k-d tree path
+    for (int k : {8, 128}) {
+        Dataset data;
+        if (rank == 0) {
+            data = DataLoader::generateData(numPoints, dim, 0.0, 1000.0, 11);
+
+            KMeans seq(k, maxIters, 0.0);
+            seq.run(data);
+            ParallelKMeans omp(k, maxIters, 0.0);
+            omp.run(data);
+            ParallelKMeans pool(k, maxIters, 0.0);
+            pool.setExecutionBackend(ExecutionBackend::THREAD_POOL);
+            pool.run(data);
+
+            std::cout << "K=" << k << " Sequential: " << seq.getSteadyStateAllocations()
+                      << ", OpenMP: " << omp.getSteadyStateAllocations()
+                      << ", Pool: " << pool.getSteadyStateAllocations() << std::endl;
+            failed = failed || seq.getSteadyStateAllocations() != 0 || omp.getSteadyStateAllocations() != 0
+                     || pool.getSteadyStateAllocations() != 0;
+        }
+
+        DistributedKMeans mpi(k, maxIters, 0.0, world);
+        mpi.run(data);
+        long long mpiAllocs = mpi.getSteadyStateAllocations();
+        long long maxMpiAllocs = mpiAllocs;
+        world.allreduce(&maxMpiAllocs, 1, CommDatatype::LONG_LONG, CommOp::MAX);
+        if (rank == 0) std::cout << "K=" << k << " Distributed (max over ranks): " << maxMpiAllocs << std::endl;
+        failed = failed || maxMpiAllocs != 0;
+    }
+
+    if (rank == 0) std::cout << (failed ? "FAILED: an engine allocates in steady state" : "OK: no steady-state allocations") << std::endl;
+}
+
+void runCoresetComparison() {
+    std::cout << "--- Coreset (sensitivity sampling) vs full run ---" << std::endl;
+
+    GeneratorSpec spec;
+    spec.distribution = DataDistribution::GAUSSIAN_MIXTURE;
+    spec.dim = 3;
+    spec.numClusters = 20;
+    spec.seed = 5;
+    Dataset data = DataLoader::generate(spec, 2000000);
+    int k = 20;
+    int maxIters = 100;
+    double threshold = 1e-2;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    ParallelKMeans full(k, maxIters, threshold);
+    KMeansResult fullResult = full.run(data);
+    std::chrono::duration<double> fullTime = std::chrono::high_resolution_clock::now() - start;
+
+    // Coreset 100x smaller. It is cheap enough for several restarts, the best one
+    // then seeds the full-precision run
+    start = std::chrono::high_resolution_clock::now();
+    Dataset coreset = Coreset::build(data, data.size() / 100, 17);
+    std::chrono::duration<double> buildTime = std::chrono::high_resolution_clock::now() - start;
+
+    MultiRunKMeans restarts({k}, 10, maxIters, threshold, 17);
+    restarts.run(coreset);
+    const std::vector<Point>& coresetCentroids = restarts.getBestRuns()[0].centroids;
+    std::chrono::duration<double> coresetTime = std::chrono::high_resolution_clock::now() - start;
+
+    // Cost of the coreset solution on the full data
+    KMeansModel coresetModel(coresetCentroids);
+    std::vector<double> flat(data.size() * spec.dim);
+    for (size_t i = 0; i < data.size(); ++i) std::copy(data[i].coords.begin(), data[i].coords.end(), flat.begin() + i * spec.dim);
+    std::vector<int> labels(data.size());
+    std::vector<double> distances(data.size());
+    coresetModel.predict(flat.data(), data.size(), labels.data(), distances.data());
+    double coresetInertia = std::accumulate(distances.begin(), distances.end(), 0.0);
+
+    auto startRefine = std::chrono::high_resolution_clock::now();
+    ParallelKMeans refined(k, maxIters, threshold);
+    refined.setInitialCentroids(coresetCentroids);
+    KMeansResult refinedResult = refined.run(data);
+    std::chrono::duration<double> refineTime = std::chrono::high_resolution_clock::now() - startRefine;
+
+    std::cout << "Coreset: " << coreset.size() << " points, built in " << buildTime.count() << " s" << std::endl;
+    std::cout << "Method,Time_s,Iterations,Inertia" << std::endl;
+    std::cout << std::fixed << std::setprecision(4)
+              << "Full run (1 restart)," << fullTime.count() << "," << fullResult.iterations << "," << fullResult.inertia << std::endl
+              << "Coreset (10 restarts)," << coresetTime.count() << ",-," << coresetInertia << std::endl
+              << "Coreset + full refine," << coresetTime.count() + refineTime.count() << ","
+              << refinedResult.iterations << "," << refinedResult.inertia << std::endl;
+}
+
+void runReorderComparison() {
+    std::cout << "--- Cluster-grouped data reordering (" << omp_get_max_threads() << " threads) ---" << std::endl;
+
+    GeneratorSpec spec;
+    spec.distribution = DataDistribution::GAUSSIAN_MIXTURE;
+    spec.dim = 16;
+    spec.numClusters = 256;
+    spec.seed = 37;
+    const int k = 256;
+    Dataset original = DataLoader::generate(spec, 500000);
+    std::vector<Point> initial(original.begin(), original.begin() + k);
+
+    std::cout << "Mode,Time_s,Iterations,Reorders,Inertia" << std::endl;
+    std::vector<int> referenceLabels;
+    for (bool reorder : {false, true}) {
+        Dataset data = original;
+        ParallelKMeans kmeans(k, 40, 1e-6);
+        kmeans.setVerbose(false);
+        kmeans.setInitialCentroids(initial);
+        kmeans.setReorder(reorder);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        KMeansResult result = kmeans.run(data);
+        std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+        std::cout << (reorder ? "reordered" : "generation order") << "," << std::fixed << std::setprecision(3)
+                  << elapsed.count() << "," << result.iterations << "," << kmeans.getReorderCount() << ","
+                  << std::setprecision(1) << result.inertia << std::defaultfloat << std::endl;
+
+        // The caller's order is restored, so labels compare point by point
+        if (referenceLabels.empty()) {
+            for (const auto& p : data) referenceLabels.push_back(p.clusterId);
+        } else {
+            size_t differ = 0;
+            for (size_t i = 0; i < data.size(); ++i) differ += data[i].clusterId != referenceLabels[i];
+            std::cout << "Labels differing from generation order: " << differ << std::endl;
+        }
+    }
+}
+
+void runNormCacheComparison() {
+    std::cout << "--- Cached norms vs direct distances (" << omp_get_max_threads() << " threads) ---" << std::endl;
+
+    // The second dataset sits far from the origin: ||x||^2 is ~1e10 against distances of ~1e3,
+    // which is where the expanded form loses digits and the exact fallback has to step in
+    std::cout << "Data,Mode,Time_s,Iterations,Inertia,Labels_differing" << std::endl;
+    for (double offset : {0.0, 1e5}) {
+        GeneratorSpec spec;
+        spec.distribution = DataDistribution::GAUSSIAN_MIXTURE;
+        spec.dim = 32;
+        spec.numClusters = 64;
+        spec.minVal = offset;
+        spec.maxVal = offset + 1000.0;
+        spec.seed = 41;
+        const int k = 64;
+        Dataset original = DataLoader::generate(spec, 200000);
+        std::vector<Point> initial(original.begin(), original.begin() + k);
+
+        std::vector<int> referenceLabels;
+        double referenceInertia = 0.0;
+        for (bool cached : {false, true}) {
+            Dataset data = original;
+            ParallelKMeans kmeans(k, 30, 1e-6);
+            kmeans.setVerbose(false);
+            kmeans.setInitialCentroids(initial);
+            kmeans.setNormCache(cached);
+
+            auto start = std::chrono::high_resolution_clock::now();
+            KMeansResult result = kmeans.run(data);
+            std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+            size_t differ = 0;
+            if (referenceLabels.empty()) {
+                for (const auto& p : data) referenceLabels.push_back(p.clusterId);
+                referenceInertia = result.inertia;
+            } else {
+                for (size_t i = 0; i < data.size(); ++i) differ += data[i].clusterId != referenceLabels[i];
+            }
+            std::cout << (offset > 0.0 ? "offset" : "centered") << "," << (cached ? "cached norms" : "direct") << ","
+                      << std::fixed << std::setprecision(3) << elapsed.count() << "," << result.iterations << ","
+                      << std::setprecision(1) << result.inertia << std::defaultfloat << "," << differ << std::endl;
+            if (cached && result.inertia != referenceInertia) {
+                std::cout << "Inertia differs from the direct scan" << std::endl;
+            }
+        }
+    }
+}
+
+void runHugePageBenchmark() {
+    std::cout << "--- Point storage and page size (" << omp_get_max_threads() << " threads) ---" << std::endl;
+
+    GeneratorSpec spec;
+    spec.distribution = DataDistribution::GAUSSIAN_MIXTURE;
+    spec.dim = 8;
+    spec.numClusters = 8;
+    spec.seed = 71;
+    const int k = 8;
+    const int iters = 10;
+    Dataset original = DataLoader::generate(spec, 2000000);
+    std::vector<Point> initial(original.begin(), original.begin() + k);
+
+    struct Setup {
+        const char* name;
+        bool packed;
+        HugePages pages;
+    };
+    const Setup setups[] = {
+        {"per-point vectors, 4 KB pages", false, HugePages::NONE},
+        {"per-point vectors, THP", false, HugePages::TRANSPARENT},
+        {"packed, 4 KB pages", true, HugePages::NONE},
+        {"packed, THP", true, HugePages::TRANSPARENT},
+        {"packed, MAP_HUGETLB", true, HugePages::EXPLICIT},
+    };
+
+    // Misses are counted over whole runs with a fixed number of iterations, the assignment
+    // pass dominates them. Only the Point array and the packed copy follow the page mode,
+    // the per-point coordinate vectors stay on the malloc heap
+    TlbMissCounter tlb;
+    if (!tlb.available()) std::cout << "dTLB counters unavailable here, timings only" << std::endl;
+    const HugePages previous = AlignedMemory::getHugePages();
+    std::cout << "Storage,Assign_s,Update_s,dTLB_misses_per_point_pass,AnonHugePages_MB,Inertia" << std::endl;
+    double referenceInertia = -1.0;
+    for (const Setup& setup : setups) {
+        AlignedMemory::setHugePages(setup.pages);
+        const long long hugeBefore = AlignedMemory::residentHugePageBytes();
+        Dataset data(original.begin(), original.end());
+        const long long hugeAfter = AlignedMemory::residentHugePageBytes();
+
+        ParallelKMeans kmeans(k, iters, 0.0);
+        kmeans.setVerbose(false);
+        kmeans.setInitialCentroids(initial);
+        kmeans.setPackedCoords(setup.packed);
+        tlb.start();
+        KMeansResult result = kmeans.run(data);
+        const long long misses = tlb.stop();
+
+        std::cout << setup.name << "," << std::fixed << std::setprecision(3) << kmeans.getAssignTime() << ","
+                  << kmeans.getUpdateTime() << ",";
+        if (misses >= 0) std::cout << std::setprecision(4) << static_cast<double>(misses) / (2.0 * iters * data.size());
+        else std::cout << "n/a";
+        std::cout << "," << (hugeBefore >= 0 ? (hugeAfter - hugeBefore) >> 20 : -1) << ","
+                  << std::setprecision(1) << result.inertia << std::defaultfloat << std::endl;
+        if (referenceInertia < 0.0) referenceInertia = result.inertia;
+        else if (result.inertia != referenceInertia) std::cout << "Inertia differs from the first setup" << std::endl;
+    }
+    if (AlignedMemory::getExplicitFallbacks() > 0) {
+        std::cout << "MAP_HUGETLB failed (vm.nr_hugepages too small), fell back to THP" << std::endl;
+    }
+    AlignedMemory::setHugePages(previous);
+}
+
+// Largest coordinate difference between two sets of centroids
+static double centroidDifference(const std::vector<Point>& a, const std::vector<Point>& b) {
+    double diff = 0.0;
+    for (size_t j = 0; j < a.size() && j < b.size(); ++j) {
+        for (size_t d = 0; d < a[j].coords.size(); ++d) diff = std::max(diff, std::abs(a[j].coords[d] - b[j].coords[d]));
+    }
+    return diff;
+}
+
+void runReproducibility() {
+    std::cout << "--- Reproducible sums across thread counts, backends and ranks ---" << std::endl;
+
+    // Far from the origin with a fixed number of iterations, so rounding differences in the
+    // sums show up in the centroids and every run does the same amount of work
+    GeneratorSpec spec;
+    spec.distribution = DataDistribution::GAUSSIAN_MIXTURE;
+    spec.dim = 16;
+    spec.numClusters = 32;
+    spec.minVal = 1e4;
+    spec.maxVal = 1e4 + 1000.0;
+    spec.seed = 83;
+    const int k = 32;
+    const int iters = 20;
+    Dataset original = DataLoader::generate(spec, 400000);
+    std::vector<Point> initial(original.begin(), original.begin() + k);
+
+    // Differences are against the first run of the same sums mode (1 thread, OpenMP)
+    std::vector<Point> reference[2];
+    double referenceInertia[2] = {0.0, 0.0};
+    std::cout << "Engine,Sums,Workers,Time_s,Inertia,Inertia_delta,Max_centroid_diff" << std::endl;
+    auto report = [&](const std::string& engine, bool reproducible, int workers, double seconds,
+                      const KMeansResult& result, const std::vector<Point>& centroids) {
+        if (reference[reproducible].empty()) {
+            reference[reproducible] = centroids;
+            referenceInertia[reproducible] = result.inertia;
+        }
+        std::cout << engine << "," << (reproducible ? "reproducible" : "plain") << "," << workers << ","
+                  << std::fixed << std::setprecision(3) << seconds << "," << std::setprecision(6) << result.inertia
+                  << std::scientific << std::setprecision(2) << "," << result.inertia - referenceInertia[reproducible]
+                  << "," << centroidDifference(centroids, reference[reproducible]) << std::defaultfloat << std::endl;
+    };
+
+    const int allThreads = omp_get_max_threads();
+    for (bool reproducible : {false, true}) {
+        for (ExecutionBackend backend : {ExecutionBackend::OPENMP, ExecutionBackend::THREAD_POOL}) {
+            for (int threads : {1, 2, 3, 4, 8}) {
+                Dataset data(original.begin(), original.end());
+                omp_set_num_threads(threads);
+                ParallelKMeans kmeans(k, iters, 0.0);
+                kmeans.setVerbose(false);
+                kmeans.setInitialCentroids(initial);
+                kmeans.setExecutionBackend(backend);
+                kmeans.setReproducible(reproducible);
+
+                auto start = std::chrono::high_resolution_clock::now();
+                KMeansResult result = kmeans.run(data);
+                std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+                report(backend == ExecutionBackend::OPENMP ? "omp" : "omp-pool", reproducible, threads,
+                       elapsed.count(), result, kmeans.getCentroids());
+            }
+        }
+    }
+    omp_set_num_threads(allThreads);
+
+    // Simulated ranks split the data differently and reduce in a different order
+    for (bool reproducible : {false, true}) {
+        for (int ranks : {1, 2, 3, 4}) {
+            KMeansResult result;
+            std::vector<Point> centroids;
+            double seconds = 0.0;
+            LocalTransport::launch(ranks, LocalLatency(), [&](Transport& world) {
+                Dataset data;
+                if (world.rank() == 0) data.assign(original.begin(), original.end());
+                DistributedKMeans kmeans(k, iters, 0.0, world);
+                kmeans.setInitialCentroids(initial);
+                kmeans.setReproducible(reproducible);
+                world.barrier();
+                double start = world.wtime();
+                KMeansResult local = kmeans.run(data);
+                if (world.rank() == 0) {
+                    seconds = world.wtime() - start;
+                    result = local;
+                    centroids = kmeans.getCentroids();
+                }
+            });
+            report("mpi", reproducible, ranks, seconds, result, centroids);
+        }
+    }
+}
+
+void runBisectingBenchmark() {
+    std::cout << "--- Bisecting k-means vs flat k-means for large k (" << omp_get_max_threads() << " threads) ---" << std::endl;
+
+    GeneratorSpec spec;
+    spec.distribution = DataDistribution::GAUSSIAN_MIXTURE;
+    spec.dim = 16;
+    spec.numClusters = 1024;
+    spec.seed = 29;
+    const int k = 2048;
+    Dataset data = DataLoader::generate(spec, 200000);
+
+    auto startBisect = std::chrono::high_resolution_clock::now();
+    BisectingKMeans bisecting(k, 20, 1e-4, 7);
+    KMeansResult tree = bisecting.run(data);
+    std::chrono::duration<double> bisectTime = std::chrono::high_resolution_clock::now() - startBisect;
+
+    // Flat k-means at this k pays O(k * dim) per point and iteration, so it only gets a few
+    auto startFlat = std::chrono::high_resolution_clock::now();
+    ParallelKMeans flat(k, 5, 1e-4);
+    flat.setVerbose(false);
+    KMeansResult flatResult = flat.run(data);
+    std::chrono::duration<double> flatTime = std::chrono::high_resolution_clock::now() - startFlat;
+
+    std::cout << "Engine,Clusters,Time_s,Iterations,Inertia" << std::endl;
+    std::cout << "bisecting," << bisecting.getCentroids().size() << "," << std::fixed << std::setprecision(3)
+              << bisectTime.count() << "," << tree.iterations << "," << std::setprecision(1) << tree.inertia << std::endl;
+    std::cout << "flat (5 iterations)," << k << "," << std::setprecision(3) << flatTime.count() << ","
+              << flatResult.iterations << "," << std::setprecision(1) << flatResult.inertia << std::endl;
+
+    // Tree descent against the exact nearest leaf centroid on fresh points
+    spec.seed = 31;
+    Dataset queries = DataLoader::generate(spec, 50000);
+    std::vector<double> flatQueries(queries.size() * spec.dim);
+    for (size_t i = 0; i < queries.size(); ++i) {
+        std::copy(queries[i].coords.begin(), queries[i].coords.end(), flatQueries.begin() + i * spec.dim);
+    }
+    std::vector<int> treeLabels(queries.size()), exactLabels(queries.size());
+    std::vector<double> exactDistances(queries.size());
+
+    auto startTree = std::chrono::high_resolution_clock::now();
+    bisecting.predict(flatQueries.data(), queries.size(), treeLabels.data());
+    std::chrono::duration<double> treeTime = std::chrono::high_resolution_clock::now() - startTree;
+
+    KMeansModel model = bisecting.getModel();
+    auto startExact = std::chrono::high_resolution_clock::now();
+    model.predict(flatQueries.data(), queries.size(), exactLabels.data(), exactDistances.data());
+    std::chrono::duration<double> exactTime = std::chrono::high_resolution_clock::now() - startExact;
+
+    // Greedy descent may end in a sibling of the nearest leaf, the cost ratio shows how much that matters
+    size_t agree = 0;
+    double treeCost = 0.0;
+    double exactCost = std::accumulate(exactDistances.begin(), exactDistances.end(), 0.0);
+    for (size_t i = 0; i < queries.size(); ++i) {
+        agree += treeLabels[i] == exactLabels[i];
+        treeCost += distanceSquared(queries[i], bisecting.getCentroids()[treeLabels[i]]);
+    }
+    std::cout << "Index,Time_s,Same_leaf_as_exact,Cost_vs_exact" << std::endl;
+    std::cout << "tree descent," << std::setprecision(4) << treeTime.count() << ","
+              << std::setprecision(3) << static_cast<double>(agree) / queries.size() << ","
+              << treeCost / exactCost << std::endl;
+    std::cout << "exact scan," << std::setprecision(4) << exactTime.count() << ",1.000,1.000" << std::defaultfloat << std::endl;
+}
+
+void runCompressionComparison(Transport& world) {
+    int rank = world.rank();
+
+    // Large k * dim, the regime where the sums exchange dominates the traces
+    GeneratorSpec spec;
+    spec.distribution = DataDistribution::GAUSSIAN_MIXTURE;
+    spec.dim = 128;
+    spec.numClusters = 512;
+    spec.seed = 21;
+    int k = 512;
+    int maxIters = 30;
+    Dataset data;
     if (rank == 0) {
-        std::cout << "==============================" << std::endl;
-        std::cout << "   K-Means HPC Project Demo   " << std::endl;
-        std::cout << "==============================" << std::endl;
+        std::cout << "--- MPI sums exchange: full vs changed clusters vs float32 deltas ---" << std::endl;
+        data = DataLoader::generate(spec, 60000);
+    }
+    std::vector<Point> initial;
+    if (rank == 0) initial.assign(data.begin(), data.begin() + k);
+
+    std::vector<Point> exactCentroids;
+    if (rank == 0) std::cout << "Mode,Time_s,Iterations,MB_sent_per_rank,Inertia,Max_centroid_diff" << std::endl;
+    const std::pair<CommCompression, const char*> modes[] = {
+        {CommCompression::NONE, "full"},
+        {CommCompression::CHANGED_CLUSTERS, "changed-clusters"},
+        {CommCompression::FLOAT32_DELTA, "float32-delta"}
+    };
+    for (const auto& mode : modes) {
+        DistributedKMeans kmeans(k, maxIters, 1e-4, world);
+        kmeans.setInitialCentroids(initial);
+        kmeans.setCommCompression(mode.first);
+
+        world.barrier();
+        double start = world.wtime();
+        KMeansResult result = kmeans.run(data);
+        double elapsed = world.wtime() - start;
+
+        long long bytes = kmeans.getCommunicatedBytes();
+        world.allreduce(&bytes, 1, CommDatatype::LONG_LONG, CommOp::MAX);
+
+        const std::vector<Point>& centroids = kmeans.getCentroids();
+        if (mode.first == CommCompression::NONE) exactCentroids = centroids;
+        double maxDiff = 0.0;
+        for (int j = 0; j < k; ++j) {
+            for (int d = 0; d < spec.dim; ++d) {
+                maxDiff = std::max(maxDiff, std::fabs(centroids[j].coords[d] - exactCentroids[j].coords[d]));
+            }
+        }
+
+        if (rank == 0) {
+            std::cout << mode.second << "," << std::fixed << std::setprecision(4) << elapsed << ","
+                      << result.iterations << "," << std::setprecision(2) << bytes / 1e6 << ","
+                      << std::setprecision(1) << result.inertia << "," << std::scientific << std::setprecision(2)
+                      << maxDiff << std::defaultfloat << std::endl;
+        }
+    }
+}
+
+void runStaleComparison(Transport& world) {
+    int rank = world.rank();
+
+    // Small per-iteration work, so the wait for the slowest rank is a visible share of the time.
+    // Stragglers show up with simulated ranks and --jitter-us
+    GeneratorSpec spec;
+    spec.distribution = DataDistribution::GAUSSIAN_MIXTURE;
+    spec.dim = 8;
+    spec.numClusters = 32;
+    spec.seed = 53;
+    int k = 32;
+    Dataset data;
+    if (rank == 0) {
+        std::cout << "--- Bulk-synchronous vs stale-synchronous iterations, " << world.size() << " ranks ---" << std::endl;
+        data = DataLoader::generate(spec, 200000);
+    }
+    std::vector<Point> initial;
+    if (rank == 0) initial.assign(data.begin(), data.begin() + k);
+
+    if (rank == 0) std::cout << "Staleness,Time_s,Iterations,Converged,Max_wait_s,Inertia" << std::endl;
+    for (int staleness : {0, 1, 2, 4}) {
+        DistributedKMeans kmeans(k, 200, 1e-3, world);
+        kmeans.setInitialCentroids(initial);
+        kmeans.setStaleness(staleness);
+
+        world.barrier();
+        double start = world.wtime();
+        KMeansResult result = kmeans.run(data);
+        double elapsed = world.wtime() - start;
+
+        double wait = kmeans.getReductionWaitTime();
+        world.allreduce(&wait, 1, CommDatatype::DOUBLE, CommOp::MAX);
+        if (rank == 0) {
+            std::cout << staleness << "," << std::fixed << std::setprecision(4) << elapsed << "," << result.iterations
+                      << "," << (result.converged ? "yes" : "no") << "," << wait << "," << std::setprecision(1)
+                      << result.inertia << std::defaultfloat << std::endl;
+        }
+    }
+}
+
+void runPlannedRun(Transport& world) {
+    int rank = world.rank();
+
+    GeneratorSpec spec;
+    spec.distribution = DataDistribution::GAUSSIAN_MIXTURE;
+    spec.dim = 16;
+    spec.numClusters = 64;
+    spec.seed = 61;
+    int k = 64;
+    int maxIters = 100;
+    double threshold = 1e-4;
+    Dataset data;
+    if (rank == 0) {
+        std::cout << "--- Planning from a sample, then the full run ---" << std::endl;
+        data = DataLoader::generate(spec, 1000000);
     }
 
-    if (argc > 1) {
-        std::string mode = argv[1];
-        if (mode == "--seq") {
+    RunPlanner planner(k, maxIters, threshold);
+    RunPlan plan = planner.plan(data, world);
+    if (plan.numPoints == 0) return;
+    if (rank == 0) plan.print(std::cout);
+
+    world.barrier();
+    double start = world.wtime();
+    KMeansResult result;
+    switch (plan.engine) {
+        case PlannedEngine::DISTRIBUTED: {
+            DistributedKMeans kmeans(k, maxIters, threshold, world);
+            kmeans.setCommCompression(plan.compression);
+            result = kmeans.run(data);
+            break;
+        }
+        case PlannedEngine::BISECTING:
+            if (rank == 0) result = BisectingKMeans(k, maxIters, threshold).run(data);
+            break;
+        case PlannedEngine::OPENMP:
             if (rank == 0) {
-                std::cout << "Running sequential version..." << std::endl;
-                runKMeansSequential(1);
+                const int allThreads = omp_get_max_threads();
+                omp_set_num_threads(plan.threads);
+                ParallelKMeans kmeans(k, maxIters, threshold);
+                kmeans.setVerbose(false);
+                result = kmeans.run(data);
+                omp_set_num_threads(allThreads);
             }
+            break;
+    }
+    double elapsed = world.wtime() - start;
+
+    if (rank == 0) {
+        std::cout << "Actual: " << result.iterations << " iterations, " << std::fixed << std::setprecision(2)
+                  << elapsed << " s" << std::defaultfloat << " (predicted " << plan.predictedIterations << ", "
+                  << std::fixed << std::setprecision(2) << plan.predictedSeconds << " s)" << std::defaultfloat << std::endl;
+    }
+}
+
+void runHierarchicalReduce(Transport& world) {
+    int rank = world.rank();
+    int size = world.size();
+
+    GeneratorSpec spec;
+    spec.distribution = DataDistribution::GAUSSIAN_MIXTURE;
+    spec.dim = 64;
+    spec.numClusters = 256;
+    spec.seed = 23;
+    int k = 256;
+    Dataset data;
+    if (rank == 0) {
+        std::cout << "--- Flat vs hierarchical (node-local shared memory) reductions, " << size << " ranks ---" << std::endl;
+        data = DataLoader::generate(spec, 100000);
+    }
+    std::vector<Point> initial;
+    if (rank == 0) initial.assign(data.begin(), data.begin() + k);
+
+    // Simulated nodes of two ranks show the leader-only traffic on a single machine
+    struct Variant { const char* name; bool hierarchical; int ranksPerNode; };
+    const Variant variants[] = {{"flat", false, 0}, {"hierarchical (shared-memory nodes)", true, 0},
+                                {"hierarchical (2 ranks per node)", true, 2}};
+
+    std::vector<Point> reference;
+    if (rank == 0) std::cout << "Mode,Time_s,Iterations,Max_network_MB_per_rank,Total_network_MB,Inertia,Max_centroid_diff" << std::endl;
+    for (const auto& variant : variants) {
+        DistributedKMeans kmeans(k, 20, 1e-4, world);
+        kmeans.setInitialCentroids(initial);
+        // Centroids are updated locally after the first Bcast, so the sums exchange is the whole story
+        kmeans.setCommCompression(CommCompression::CHANGED_CLUSTERS);
+        kmeans.setHierarchicalReduce(variant.hierarchical, variant.ranksPerNode);
+
+        world.barrier();
+        double start = world.wtime();
+        KMeansResult result = kmeans.run(data);
+        double elapsed = world.wtime() - start;
+
+        long long bytes = kmeans.getCommunicatedBytes();
+        long long maxBytes = bytes, totalBytes = bytes;
+        world.allreduce(&maxBytes, 1, CommDatatype::LONG_LONG, CommOp::MAX);
+        world.allreduce(&totalBytes, 1, CommDatatype::LONG_LONG, CommOp::SUM);
+
+        const std::vector<Point>& centroids = kmeans.getCentroids();
+        if (reference.empty()) reference = centroids;
+        double maxDiff = 0.0;
+        for (int j = 0; j < k; ++j) {
+            for (int d = 0; d < spec.dim; ++d) {
+                maxDiff = std::max(maxDiff, std::fabs(centroids[j].coords[d] - reference[j].coords[d]));
+            }
+        }
+
+        if (rank == 0) {
+            std::cout << variant.name << "," << std::fixed << std::setprecision(4) << elapsed << ","
+                      << result.iterations << "," << std::setprecision(2) << maxBytes / 1e6 << ","
+                      << totalBytes / 1e6 << "," << std::setprecision(1) << result.inertia << ","
+                      << std::scientific << std::setprecision(2) << maxDiff << std::defaultfloat << std::endl;
+        }
+    }
+}
+
+static bool sameFileContents(const std::string& a, const std::string& b) {
+    std::ifstream fa(a, std::ios::binary), fb(b, std::ios::binary);
+    std::string ca((std::istreambuf_iterator<char>(fa)), std::istreambuf_iterator<char>());
+    std::string cb((std::istreambuf_iterator<char>(fb)), std::istreambuf_iterator<char>());
+    return !ca.empty() && ca == cb;
+}
+
+void runLabelOutput(Transport& world) {
+    int rank = world.rank();
+    int numPoints = 1000000;
+    int dim = 3;
+    int k = 10;
+
+    if (rank == 0) {
+        std::cout << "--- Label output: synchronous vs asynchronous writes over a job sequence ---" << std::endl;
+        int jobs = 3;
+
+        // The writes of job i overlap the load (generation) and clustering of job i + 1
+        for (bool async : {false, true}) {
+            auto start = std::chrono::high_resolution_clock::now();
+            std::future<bool> pending;
+            double writeTime = 0.0;
+            for (int job = 0; job < jobs; ++job) {
+                Dataset data = DataLoader::generateData(numPoints, dim, 0.0, 1000.0, 100 + job);
+                ParallelKMeans kmeans(k, 20);
+                kmeans.run(data);
+
+                std::vector<int> labels;
+                std::vector<double> distances;
+                LabelWriter::extract(data, kmeans.getCentroids(), labels, &distances);
+                std::string filename = "labels_job" + std::to_string(job) + ".csv";
+
+                auto startWrite = std::chrono::high_resolution_clock::now();
+                if (pending.valid()) pending.get();
+                if (async) {
+                    pending = LabelWriter::writeAsync(filename, LabelFormat::CSV, std::move(labels), std::move(distances));
+                } else {
+                    LabelWriter::write(filename, LabelFormat::CSV, labels.data(), distances.data(), labels.size());
+                }
+                writeTime += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startWrite).count();
+            }
+            auto startWrite = std::chrono::high_resolution_clock::now();
+            if (pending.valid()) pending.get();
+            writeTime += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startWrite).count();
+
+            std::chrono::duration<double> total = std::chrono::high_resolution_clock::now() - start;
+            std::cout << (async ? "Async" : "Sync ") << ": total " << std::fixed << std::setprecision(3) << total.count()
+                      << " s, time blocked on writes " << writeTime << " s" << std::endl;
+        }
+    }
+
+    // Distributed engine: the three ways of getting per-rank labels to disk
+    Dataset data;
+    if (rank == 0) data = DataLoader::generateData(numPoints, dim, 0.0, 1000.0, 100);
+    DistributedKMeans kmeans(k, 20, 1e-4, world);
+    kmeans.run(data);
+
+    if (rank == 0) std::cout << "Mode,Format,Time_s" << std::endl;
+    const std::pair<LabelOutputMode, const char*> modes[] = {
+        {LabelOutputMode::GATHER, "gather"}, {LabelOutputMode::SHARDED, "sharded"}, {LabelOutputMode::COLLECTIVE, "collective"}};
+    for (LabelFormat format : {LabelFormat::BINARY, LabelFormat::CSV}) {
+        const char* ext = format == LabelFormat::BINARY ? ".bin" : ".csv";
+        for (const auto& mode : modes) {
+            world.barrier();
+            double start = world.wtime();
+            bool ok = kmeans.writeLabels(std::string("labels_") + mode.second + ext, format, mode.first, true);
+            double elapsed = world.wtime() - start;
+            if (rank == 0) std::cout << mode.second << "," << (ext + 1) << "," << std::fixed << std::setprecision(4)
+                                     << elapsed << (ok ? "" : " (FAILED)") << std::endl;
+        }
+        if (rank == 0) {
+            bool same = sameFileContents(std::string("labels_gather") + ext, std::string("labels_mpi-io") + ext);
+            std::cout << "Gathered and collective " << (ext + 1) << " files identical: " << (same ? "YES" : "NO") << std::endl;
+        }
+    }
+}
+
+// --serve [model file] [socket path]: labels points from stdin (or the socket) and keeps
+// the model updated online. Stdout carries only labels in stdin mode, logs go to stderr.
+int runStreamService(int argc, char* argv[]) {
+    std::string modelPath = argc > 2 ? argv[2] : "kmeans_model.bin";
+    KMeansModel trained;
+    if (!trained.load(modelPath)) {
+        std::cerr << "Train and save a model first (e.g. --predict writes kmeans_model.bin)." << std::endl;
+        return 1;
+    }
+
+    StreamConfig config;
+    if (argc > 3) config.socketPath = argv[3];
+    config.halfLife = 1e6;
+    StreamService service(trained, config);
+    return service.run();
+}
+
+// Rows are unit length, so a point sharing no dim with two row centroids is at exactly the same
+// distance from both. Blending two rows with different weights avoids those ties, which would
+// otherwise be broken differently by the sparse and dense kernels
+static std::vector<Point> blendedRowCentroids(const SparseDataset& data, int k) {
+    std::vector<Point> initial;
+    std::vector<double> other(data.dim);
+    for (int j = 0; j < k; ++j) {
+        std::vector<double> coords(data.dim);
+        data.densifyRow(2 * j, coords.data());
+        data.densifyRow(2 * j + 1, other.data());
+        for (int d = 0; d < data.dim; ++d) coords[d] += (0.3 + 0.05 * j) * other[d];
+        initial.emplace_back(coords);
+    }
+    return initial;
+}
+
+void runSparseBenchmark(Transport& world) {
+    int rank = world.rank();
+    int k = 20;
+
+    // Correctness: the sparse path has to match the dense engine on the densified data
+    if (rank == 0) {
+        std::cout << "--- Sparse (CSR) input ---" << std::endl;
+        SparseDataset small = DataLoader::generateSparse(5000, 300, 0.03, k, 11);
+        Dataset dense(small.numRows());
+        for (long long i = 0; i < small.numRows(); ++i) {
+            dense[i].coords.resize(small.dim);
+            small.densifyRow(i, dense[i].coords.data());
+        }
+        std::vector<Point> initial = blendedRowCentroids(small, k);
+
+        ParallelKMeans sparseEngine(k, 30, 1e-6);
+        sparseEngine.setInitialCentroids(initial);
+        KMeansResult sparseResult = sparseEngine.run(small);
+        ParallelKMeans denseEngine(k, 30, 1e-6);
+        denseEngine.setInitialCentroids(initial);
+        KMeansResult denseResult = denseEngine.run(dense);
+
+        int mismatched = 0;
+        for (long long i = 0; i < small.numRows(); ++i) mismatched += small.labels[i] != dense[i].clusterId;
+        std::cout << "Sparse vs dense: inertia " << sparseResult.inertia << " vs " << denseResult.inertia
+                  << ", iterations " << sparseResult.iterations << " vs " << denseResult.iterations
+                  << ", different labels " << mismatched << std::endl;
+    }
+
+    // High-dimensional text-like data, a dense copy would need numPoints * dim * 8 bytes
+    long long numPoints = 200000;
+    int dim = 100000;
+    double density = 0.0005;
+    SparseDataset data;
+    if (rank == 0) data = DataLoader::generateSparse(numPoints, dim, density, k, 7);
+    std::vector<Point> initial;
+    if (rank == 0) initial = blendedRowCentroids(data, k);
+
+    double ompInertia = 0.0;
+    std::vector<int> ompLabels;
+    if (rank == 0) {
+        ParallelKMeans engine(k, 20, 1e-6);
+        engine.setInitialCentroids(initial);
+        auto start = std::chrono::high_resolution_clock::now();
+        KMeansResult r = engine.run(data);
+        std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+        ompInertia = r.inertia;
+        ompLabels = data.labels;
+
+        double perIter = elapsed.count() / std::max(1, r.iterations);
+        std::cout << "OpenMP sparse: " << r.iterations << " iterations, " << perIter << " s/iteration, "
+                  << data.nnz() * k / perIter / 1e9 << " G nnz*k/s (dense equivalent would be "
+                  << static_cast<double>(numPoints) * dim * 8 / 1e9 << " GB)" << std::endl;
+    }
+
+    // Same start on every rank count -> same labels and inertia as the OpenMP engine
+    DistributedKMeans distributed(k, 20, 1e-6, world);
+    distributed.setInitialCentroids(initial);
+    double start = world.wtime();
+    KMeansResult r = distributed.run(data);
+    double elapsed = world.wtime() - start;
+    if (rank == 0) {
+        int mismatched = 0;
+        for (long long i = 0; i < numPoints; ++i) mismatched += ompLabels[i] != data.labels[i];
+        std::cout << "MPI sparse: " << r.iterations << " iterations in " << elapsed << " s, inertia "
+                  << r.inertia << " (OpenMP " << ompInertia << "), different labels " << mismatched << std::endl;
+    }
+}
+
+// Runs one demo mode on the calling rank (every rank of the transport calls it)
+// --run takes the whole job from the options (and --config files), --seq/--omp/--mpi preset the engine
+int runJob(const std::string& mode, Transport& world, int argc, char* argv[]) {
+    JobConfig job;
+    if (mode == "--seq" || mode.empty()) job.engine = JobEngine::SEQUENTIAL;
+    else if (mode == "--mpi") job.engine = JobEngine::DISTRIBUTED;
+    if (mode.empty()) job.repeat = 5;
+
+    std::string error;
+    if (!job.parseArgs(argc, argv, mode.empty() ? 1 : 2, error) || !job.validate(error)) {
+        if (world.rank() == 0) {
+            std::cerr << "Error: " << error << std::endl;
+            JobConfig::printUsage(std::cerr);
+        }
+        return 2;
+    }
+    return JobRunner(job, world).run();
+}
+
+// Jobs go through JobConfig/JobRunner. The other modes are fixed demos: each compares several
+// engine settings on its own hard-coded data (and checks that the results agree), which is not
+// one job, so their sizes stay in the function bodies on purpose
+int runMode(const std::string& mode, Transport& world, int argc, char* argv[]) {
+    int rank = world.rank();
+
+    if (!mode.empty()) {
+        if (mode == "--run" || mode == "--seq" || mode == "--omp" || mode == "--mpi") {
+            return runJob(mode, world, argc, argv);
+        } else if (mode == "--help") {
+            if (rank == 0) JobConfig::printUsage(std::cout);
         } else if (mode == "--test") {
             if (rank == 0) runTest();
-        } else if (mode == "--omp") {
-            if (rank == 0) {
-                std::cout << "Running parallel OpenMP version..." << std::endl;
-                runKMeansParallel(1);
-            }
         } else if (mode == "--old") {
             if (rank == 0) runOldParallelKMeans();
         } else if (mode == "--compare") {
-            runComparison();
+            runComparison(world);
         } else if (mode == "--empirical") {
             runEmpiricalAnalysis();
         } else if (mode == "--scale") {
             if (rank == 0) runScalabilityAnalysis();
-        } else if (mode == "--mpi") {
-            if (rank == 0) std::cout << "Running distributed MPI version..." << std::endl;
-            runKMeansDistributed(1);
+        } else if (mode == "--predict") {
+            if (rank == 0) runPredictBenchmark();
+        } else if (mode == "--kdtree") {
+            if (rank == 0) runKDTreeBenchmark();
+        } else if (mode == "--multi") {
+            if (rank == 0) runMultiRunComparison();
+        } else if (mode == "--pool") {
+            if (rank == 0) runPoolComparison();
+        } else if (mode == "--coreset") {
+            if (rank == 0) runCoresetComparison();
+        } else if (mode == "--reorder") {
+            if (rank == 0) runReorderComparison();
+        } else if (mode == "--norms") {
+            if (rank == 0) runNormCacheComparison();
+        } else if (mode == "--hugepages") {
+            if (rank == 0) runHugePageBenchmark();
+        } else if (mode == "--repro") {
+            if (rank == 0) runReproducibility();
+        } else if (mode == "--bisect") {
+            if (rank == 0) runBisectingBenchmark();
+        } else if (mode == "--hier") {
+            runHierarchicalReduce(world);
+        } else if (mode == "--plan") {
+            runPlannedRun(world);
+        } else if (mode == "--stale") {
+            runStaleComparison(world);
+        } else if (mode == "--compress") {
+            runCompressionComparison(world);
+        } else if (mode == "--metrics") {
+            if (rank == 0) runMetricComparison();
+        } else if (mode == "--sparse") {
+            runSparseBenchmark(world);
+        } else if (mode == "--labels") {
+            runLabelOutput(world);
+        } else if (mode == "--serve") {
+            if (rank == 0) return runStreamService(argc, argv);
+        } else if (mode == "--allocs") {
+            runAllocationCheck(world);
         } else {
-            if (rank == 0) std::cout << "Unknown argument. Use one of: --seq, --omp, --compare, --mpi" << std::endl;
+            if (rank == 0) std::cout << "Unknown argument. Use one of: --run, --seq, --omp, --compare, --mpi, --help" << std::endl;
+            return 2;
         }
     } else {
-        if (rank == 0) {
-            std::cout << "No mode specified. Defaulting to --seq." << std::endl;
-            runKMeansSequential();
-        }
+        if (rank == 0) std::cout << "No mode specified. Defaulting to --seq." << std::endl;
+        return runJob(mode, world, argc, argv);
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    // --ranks N runs the distributed modes over N ranks simulated as threads of this process,
+    // --latency-us / --bandwidth-gbs add a network cost to every simulated collective,
+    // --jitter-us a random per-call delay on the calling rank (stragglers)
+    int simulatedRanks = 0;
+    LocalLatency latency;
+    for (int i = 2; i + 1 < argc; ++i) {
+        std::string option = argv[i];
+        if (option == "--ranks") simulatedRanks = std::max(1, std::atoi(argv[i + 1]));
+        else if (option == "--latency-us") latency.latencyUs = std::atof(argv[i + 1]);
+        else if (option == "--bandwidth-gbs") latency.bandwidthGBs = std::atof(argv[i + 1]);
+        else if (option == "--jitter-us") latency.jitterUs = std::atof(argv[i + 1]);
     }
 
-    if (rank == 0) std::cout << "Execution finished successfully!" << std::endl;
+#ifdef USE_MPI
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+#endif
 
+    int rank = simulatedRanks > 0 ? 0 : Transport::world().rank();
+    std::string mode = argc > 1 ? argv[1] : "";
+
+    // The streaming service owns stdout, no banner there
+    bool serving = mode == "--serve";
+
+    if (rank == 0 && !serving) {
+        std::cout << "==============================" << std::endl;
+        std::cout << "   K-Means HPC Project Demo   " << std::endl;
+        std::cout << "==============================" << std::endl;
+    }
+
+    int status = 0;
+    if (simulatedRanks > 0) {
+        if (!serving) std::cout << "Simulating " << simulatedRanks << " ranks in-process" << std::endl;
+        LocalTransport::launch(simulatedRanks, latency, [&](Transport& world) {
+            int rankStatus = runMode(mode, world, argc, argv);
+            if (world.rank() == 0) status = rankStatus;
+        });
+    } else {
+        status = runMode(mode, Transport::world(), argc, argv);
+    }
+
+    if (rank == 0 && !serving && status == 0) std::cout << "Execution finished successfully!" << std::endl;
+
+#ifdef USE_MPI
     MPI_Finalize();
-    return 0;
+#endif
+    return status;
 }
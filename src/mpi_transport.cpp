@@ -0,0 +1,118 @@
+#include "../include/mpi_transport.h"
+
+#ifdef USE_MPI
+
+#include <algorithm>
+
+namespace {
+
+MPI_Datatype toMpi(CommDatatype type) {
+    switch (type) {
+        case CommDatatype::INT: return MPI_INT;
+        case CommDatatype::LONG_LONG: return MPI_LONG_LONG;
+        case CommDatatype::FLOAT: return MPI_FLOAT;
+        case CommDatatype::DOUBLE: return MPI_DOUBLE;
+        case CommDatatype::BYTE: return MPI_BYTE;
+        case CommDatatype::DOUBLE_INT: return MPI_DOUBLE_INT;
+    }
+    return MPI_BYTE;
+}
+
+MPI_Op toMpi(CommOp op) {
+    switch (op) {
+        case CommOp::SUM: return MPI_SUM;
+        case CommOp::MIN: return MPI_MIN;
+        case CommOp::MAX: return MPI_MAX;
+        case CommOp::MAXLOC: return MPI_MAXLOC;
+    }
+    return MPI_SUM;
+}
+
+}
+
+MpiTransport::MpiTransport(MPI_Comm comm) : comm(comm) {
+    MPI_Comm_rank(comm, &worldRank);
+    MPI_Comm_size(comm, &worldSize);
+}
+
+void MpiTransport::barrier() {
+    MPI_Barrier(comm);
+}
+
+void MpiTransport::bcast(void* data, int count, CommDatatype type, int root) {
+    MPI_Bcast(data, count, toMpi(type), root, comm);
+}
+
+void MpiTransport::allreduce(void* data, int count, CommDatatype type, CommOp op) {
+    MPI_Allreduce(MPI_IN_PLACE, data, count, toMpi(type), toMpi(op), comm);
+}
+
+CommRequest MpiTransport::iallreduce(const void* send, void* recv, int count, CommDatatype type, CommOp op) {
+    auto slot = std::find(requests.begin(), requests.end(), MPI_REQUEST_NULL);
+    if (slot == requests.end()) slot = requests.insert(requests.end(), MPI_REQUEST_NULL);
+    MPI_Iallreduce(send, recv, count, toMpi(type), toMpi(op), comm, &*slot);
+    return static_cast<CommRequest>(slot - requests.begin());
+}
+
+bool MpiTransport::test(CommRequest request) {
+    // A completed request is set back to MPI_REQUEST_NULL, which frees the slot
+    int done = 0;
+    MPI_Test(&requests[request], &done, MPI_STATUS_IGNORE);
+    return done != 0;
+}
+
+void MpiTransport::wait(CommRequest request) {
+    MPI_Wait(&requests[request], MPI_STATUS_IGNORE);
+}
+
+void MpiTransport::allgather(const void* send, int count, CommDatatype type, void* recv) {
+    MPI_Allgather(send, count, toMpi(type), recv, count, toMpi(type), comm);
+}
+
+void MpiTransport::gatherv(const void* send, int count, CommDatatype type,
+                           void* recv, const int* counts, const int* displs, int root) {
+    MPI_Gatherv(send, count, toMpi(type), recv, counts, displs, toMpi(type), root, comm);
+}
+
+void MpiTransport::scatterv(const void* send, const int* counts, const int* displs, CommDatatype type,
+                            void* recv, int count, int root) {
+    MPI_Scatterv(send, counts, displs, toMpi(type), recv, count, toMpi(type), root, comm);
+}
+
+bool MpiTransport::writeShared(const std::string& filename, const std::vector<FileBlock>& blocks) {
+    MPI_File fh;
+    if (MPI_File_open(comm, filename.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &fh) != MPI_SUCCESS) {
+        return false;
+    }
+    MPI_File_set_size(fh, 0);
+
+    // MPI counts are int, big blocks are written in several collective rounds
+    const long long maxPiece = 1LL << 30;
+    std::vector<FileBlock> pieces;
+    for (const FileBlock& block : blocks) {
+        for (long long begin = 0; begin < static_cast<long long>(block.bytes); begin += maxPiece) {
+            size_t len = static_cast<size_t>(std::min(maxPiece, static_cast<long long>(block.bytes) - begin));
+            pieces.push_back({block.offset + begin, static_cast<const char*>(block.data) + begin, len});
+        }
+    }
+    long long rounds = static_cast<long long>(pieces.size());
+    MPI_Allreduce(MPI_IN_PLACE, &rounds, 1, MPI_LONG_LONG, MPI_MAX, comm);
+
+    int rc = MPI_SUCCESS;
+    for (long long r = 0; r < rounds; ++r) {
+        if (r < static_cast<long long>(pieces.size())) {
+            const FileBlock& piece = pieces[r];
+            rc |= MPI_File_write_at_all(fh, piece.offset, piece.data, static_cast<int>(piece.bytes), MPI_BYTE,
+                                        MPI_STATUS_IGNORE);
+        } else {
+            rc |= MPI_File_write_at_all(fh, 0, nullptr, 0, MPI_BYTE, MPI_STATUS_IGNORE);
+        }
+    }
+    MPI_File_close(&fh);
+
+    int ok = rc == MPI_SUCCESS ? 1 : 0;
+    MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_MIN, comm);
+    return ok == 1;
+}
+
+#endif
@@ -0,0 +1,215 @@
+#include "../include/multi_run_kmeans.h"
+#include "../include/distance_kernels.h"
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <omp.h>
+
+MultiRunKMeans::MultiRunKMeans(const std::vector<int>& ks, int nInit, int maxIter, double threshold, unsigned int seed)
+    : ks(ks), nInit(nInit), maxIter(maxIter), threshold(threshold), seed(seed) {}
+
+void MultiRunKMeans::initializeRuns(const std::vector<double>& flat, size_t n, int dim) {
+    runs.clear();
+
+    std::random_device rd;
+    std::mt19937 gen(seed != 0 ? seed : rd());
+
+    // Partial Fisher-Yates on one shared index array: O(k) per run instead of a full shuffle
+    std::vector<size_t> indices(n);
+    for (size_t i = 0; i < n; ++i) indices[i] = i;
+
+    size_t offset = 0;
+    for (int k : ks) {
+        for (int r = 0; r < nInit; ++r) {
+            RunState state;
+            state.k = k;
+            state.restart = r;
+            state.offset = offset;
+            state.centroids.resize(static_cast<size_t>(k) * dim);
+
+            for (int j = 0; j < k; ++j) {
+                std::uniform_int_distribution<size_t> pick(j, n - 1);
+                std::swap(indices[j], indices[pick(gen)]);
+                std::copy(flat.begin() + indices[j] * dim, flat.begin() + (indices[j] + 1) * dim,
+                          state.centroids.begin() + static_cast<size_t>(j) * dim);
+            }
+
+            offset += k;
+            runs.push_back(std::move(state));
+        }
+    }
+}
+
+void MultiRunKMeans::accumulate(const std::vector<double>& flat, const std::vector<double>& pointWeights,
+                                size_t n, int dim, bool finalPass,
+                                std::vector<double>& sums, std::vector<double>& weights) {
+    const size_t slots = runs.back().offset + runs.back().k;
+    const int numRuns = static_cast<int>(runs.size());
+    const long long numTiles = static_cast<long long>((n + TILE_POINTS - 1) / TILE_POINTS);
+
+    std::fill(sums.begin(), sums.end(), 0.0);
+    std::fill(weights.begin(), weights.end(), 0.0);
+    const double* pw = pointWeights.empty() ? nullptr : pointWeights.data();
+    std::vector<double> inertia(numRuns, 0.0);
+
+    #pragma omp parallel
+    {
+        std::vector<double> localSums(finalPass ? 0 : slots * dim, 0.0);
+        std::vector<double> localWeights(finalPass ? 0 : slots, 0.0);
+        std::vector<double> localInertia(numRuns, 0.0);
+
+        #pragma omp for schedule(static) nowait
+        for (long long t = 0; t < numTiles; ++t) {
+            size_t begin = static_cast<size_t>(t) * TILE_POINTS;
+            size_t end = std::min(n, begin + TILE_POINTS);
+
+            // The tile stays in cache while every active centroid set is evaluated against it
+            for (int r = 0; r < numRuns; ++r) {
+                const RunState& run = runs[r];
+                if (run.converged && !finalPass) continue;
+
+                const double* c = run.centroids.data();
+                for (size_t i = begin; i < end; ++i) {
+                    const double* p = flat.data() + i * dim;
+                    const double w = pw ? pw[i] : 1.0;
+                    double dist;
+                    int best = nearestCentroid(p, c, run.k, dim, dist);
+                    localInertia[r] += w * dist;
+                    if (finalPass) continue;
+
+                    size_t slot = run.offset + best;
+                    localWeights[slot] += w;
+                    for (int d = 0; d < dim; ++d) {
+                        localSums[slot * dim + d] += w * p[d];
+                    }
+                }
+            }
+        }
+
+        #pragma omp critical
+        {
+            for (int r = 0; r < numRuns; ++r) inertia[r] += localInertia[r];
+            if (!finalPass) {
+                for (size_t s = 0; s < slots; ++s) {
+                    weights[s] += localWeights[s];
+                    for (int d = 0; d < dim; ++d) sums[s * dim + d] += localSums[s * dim + d];
+                }
+            }
+        }
+    }
+
+    for (int r = 0; r < numRuns; ++r) {
+        if (finalPass || !runs[r].converged) runs[r].inertia = inertia[r];
+    }
+}
+
+int MultiRunKMeans::run(const Dataset& data) {
+    bestRuns.clear();
+    if (data.empty() || ks.empty() || nInit <= 0) {
+        std::cerr << "Invalid data, k list or number of restarts." << std::endl;
+        return 0;
+    }
+    for (int k : ks) {
+        if (k <= 0 || data.size() < static_cast<size_t>(k)) {
+            std::cerr << "Error: Number of clusters k (" << k << ") is invalid for dataset size (" << data.size() << ")." << std::endl;
+            return 0;
+        }
+    }
+
+    // Flatten once, every run shares this buffer
+    const size_t n = data.size();
+    const int dim = static_cast<int>(data[0].coords.size());
+    std::vector<double> flat(n * dim);
+    #pragma omp parallel for
+    for (long long i = 0; i < static_cast<long long>(n); ++i) {
+        std::copy(data[i].coords.begin(), data[i].coords.end(), flat.begin() + i * dim);
+    }
+    std::vector<double> pointWeights;
+    if (std::any_of(data.begin(), data.end(), [](const Point& p) { return p.weight != 1.0; })) {
+        pointWeights.resize(n);
+        for (size_t i = 0; i < n; ++i) pointWeights[i] = data[i].weight;
+    }
+
+    initializeRuns(flat, n, dim);
+    std::cout << "Running " << runs.size() << " centroid sets (" << ks.size() << " k values x "
+              << nInit << " restarts) over shared data passes..." << std::endl;
+
+    const size_t slots = runs.back().offset + runs.back().k;
+    std::vector<double> sums(slots * dim);
+    std::vector<double> weights(slots);
+
+    int passes = 0;
+    bool anyActive = true;
+    while (passes < maxIter && anyActive) {
+        accumulate(flat, pointWeights, n, dim, false, sums, weights);
+        passes++;
+
+        anyActive = false;
+        for (auto& run : runs) {
+            if (run.converged) continue;
+
+            double maxShift = 0.0;
+            for (int j = 0; j < run.k; ++j) {
+                size_t slot = run.offset + j;
+                if (weights[slot] <= 0.0) continue;
+
+                double* c = run.centroids.data() + static_cast<size_t>(j) * dim;
+                double shift = 0.0;
+                for (int d = 0; d < dim; ++d) {
+                    double updated = sums[slot * dim + d] / weights[slot];
+                    double diff = updated - c[d];
+                    shift += diff * diff;
+                    c[d] = updated;
+                }
+                maxShift = std::max(maxShift, shift);
+            }
+
+            run.iterations++;
+            run.converged = maxShift < threshold * threshold;
+            if (!run.converged) anyActive = true;
+        }
+    }
+
+    // Exact objective of the final centroids, one more shared pass for all runs
+    accumulate(flat, pointWeights, n, dim, true, sums, weights);
+    passes++;
+
+    for (int k : ks) {
+        const RunState* best = nullptr;
+        for (const auto& run : runs) {
+            if (run.k == k && (best == nullptr || run.inertia < best->inertia)) best = &run;
+        }
+
+        RunSummary summary;
+        summary.k = k;
+        summary.restart = best->restart;
+        summary.iterations = best->iterations;
+        summary.inertia = best->inertia;
+        summary.centroids.resize(k);
+        for (int j = 0; j < k; ++j) {
+            auto first = best->centroids.begin() + static_cast<size_t>(j) * dim;
+            summary.centroids[j] = Point(std::vector<double>(first, first + dim));
+        }
+        bestRuns.push_back(std::move(summary));
+    }
+
+    return passes;
+}
+
+std::vector<RunSummary> MultiRunKMeans::getAllRuns() const {
+    std::vector<RunSummary> all;
+    for (const auto& run : runs) {
+        RunSummary summary;
+        summary.k = run.k;
+        summary.restart = run.restart;
+        summary.iterations = run.iterations;
+        summary.inertia = run.inertia;
+        int dim = run.k > 0 ? static_cast<int>(run.centroids.size() / run.k) : 0;
+        for (int j = 0; j < run.k; ++j) {
+            auto first = run.centroids.begin() + static_cast<size_t>(j) * dim;
+            summary.centroids.emplace_back(std::vector<double>(first, first + dim));
+        }
+        all.push_back(std::move(summary));
+    }
+    return all;
+}
@@ -0,0 +1,132 @@
+#include "../include/node_reducer.h"
+#include "../include/mpi_transport.h"
+#include <algorithm>
+#include <cstring>
+
+NodeReducer::~NodeReducer() {
+#ifdef USE_MPI
+    int finalized = 0;
+    MPI_Finalized(&finalized);
+    if (!finalized) release();
+#endif
+}
+
+bool NodeReducer::ready() const {
+#ifdef USE_MPI
+    return window != MPI_WIN_NULL;
+#else
+    return false;
+#endif
+}
+
+void NodeReducer::release() {
+#ifdef USE_MPI
+    if (window != MPI_WIN_NULL) {
+        MPI_Win_unlock_all(window);
+        MPI_Win_free(&window);
+    }
+    if (leaderComm != MPI_COMM_NULL) MPI_Comm_free(&leaderComm);
+    if (nodeComm != MPI_COMM_NULL) MPI_Comm_free(&nodeComm);
+#endif
+    slots = nullptr;
+    slotBytes = 0;
+    split = -1;
+}
+
+void NodeReducer::prepare(Transport& newTransport, size_t maxBytes, int ranksPerNode) {
+    transport = &newTransport;
+#ifdef USE_MPI
+    auto* mpi = dynamic_cast<MpiTransport*>(transport);
+    if (!mpi) {
+        release();
+        return;
+    }
+    MPI_Comm comm = mpi->communicator();
+
+    // Round up to whole cache lines so neighbouring slots never share one
+    maxBytes = (maxBytes + 63) / 64 * 64;
+    int fits = ready() && slotBytes >= maxBytes && split == ranksPerNode ? 1 : 0;
+    MPI_Allreduce(MPI_IN_PLACE, &fits, 1, MPI_INT, MPI_MIN, comm);
+    if (fits) return;
+    release();
+
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    split = ranksPerNode;
+    if (ranksPerNode > 0) {
+        MPI_Comm_split(comm, rank / ranksPerNode, rank, &nodeComm);
+    } else {
+        MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &nodeComm);
+    }
+    MPI_Comm_rank(nodeComm, &nodeRank);
+    MPI_Comm_size(nodeComm, &nodeSize);
+
+    MPI_Comm_split(comm, nodeRank == 0 ? 0 : MPI_UNDEFINED, rank, &leaderComm);
+    numNodes = 0;
+    if (leaderComm != MPI_COMM_NULL) MPI_Comm_size(leaderComm, &numNodes);
+    MPI_Bcast(&numNodes, 1, MPI_INT, 0, nodeComm);
+
+    // The leader allocates every slot, so the window is one contiguous block
+    slotBytes = maxBytes;
+    MPI_Aint size = nodeRank == 0 ? static_cast<MPI_Aint>(slotBytes * (nodeSize + 1)) : 0;
+    void* base = nullptr;
+    MPI_Win_allocate_shared(size, 1, MPI_INFO_NULL, nodeComm, &base, &window);
+    MPI_Aint querySize;
+    int dispUnit;
+    MPI_Win_shared_query(window, 0, &querySize, &dispUnit, &base);
+    slots = static_cast<char*>(base);
+    // Passive target epoch for the whole lifetime, synchronization is Win_sync + Barrier
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, window);
+#else
+    (void)maxBytes;
+    (void)ranksPerNode;
+#endif
+}
+
+template <class T>
+void NodeReducer::sumInPlace(T* data, int count) {
+    const size_t bytes = static_cast<size_t>(count) * sizeof(T);
+    if (!ready() || bytes > slotBytes) {
+        // No window, or larger than prepared for (same size on every rank, so all take this branch)
+        transport->allreduce(data, count, commDatatypeOf<T>(), CommOp::SUM);
+        networkBytes += static_cast<long long>(bytes);
+        return;
+    }
+#ifdef USE_MPI
+    T* mine = reinterpret_cast<T*>(slots + nodeRank * slotBytes);
+    T* result = reinterpret_cast<T*>(slots + nodeSize * slotBytes);
+
+    std::memcpy(mine, data, bytes);
+    MPI_Win_sync(window);
+    MPI_Barrier(nodeComm);
+    MPI_Win_sync(window);
+
+    // Every rank reduces its own slice, always in node rank order (same result on every run)
+    const int chunk = (count + nodeSize - 1) / nodeSize;
+    const int begin = std::min(count, nodeRank * chunk);
+    const int end = std::min(count, begin + chunk);
+    for (int i = begin; i < end; ++i) {
+        T sum = reinterpret_cast<T*>(slots)[i];
+        for (int r = 1; r < nodeSize; ++r) sum += reinterpret_cast<T*>(slots + r * slotBytes)[i];
+        result[i] = sum;
+    }
+    MPI_Win_sync(window);
+    MPI_Barrier(nodeComm);
+
+    if (leaderComm != MPI_COMM_NULL && numNodes > 1) {
+        MPI_Win_sync(window);
+        MPI_Datatype type = commDatatypeOf<T>() == CommDatatype::DOUBLE ? MPI_DOUBLE
+                          : commDatatypeOf<T>() == CommDatatype::FLOAT ? MPI_FLOAT : MPI_INT;
+        MPI_Allreduce(MPI_IN_PLACE, result, count, type, MPI_SUM, leaderComm);
+        networkBytes += static_cast<long long>(bytes);
+        MPI_Win_sync(window);
+    }
+    MPI_Barrier(nodeComm);
+    MPI_Win_sync(window);
+    std::memcpy(data, result, bytes);
+#endif
+}
+
+void NodeReducer::sum(double* data, int count) { sumInPlace(data, count); }
+void NodeReducer::sum(float* data, int count) { sumInPlace(data, count); }
+void NodeReducer::sum(int* data, int count) { sumInPlace(data, count); }
@@ -0,0 +1,78 @@
+#include "../include/online_kmeans.h"
+#include "../include/distance_kernels.h"
+#include <algorithm>
+#include <cmath>
+#include <omp.h>
+
+OnlineKMeans::OnlineKMeans(const KMeansModel& model, double halfLife)
+    : k(model.getK()), dim(model.getDim()), metric(model.getMetric()), metadata(model.getMetadata()) {
+    if (halfLife > 0.0) decay = std::pow(0.5, 1.0 / halfLife);
+
+    centroids.assign(model.getCentroidData(), model.getCentroidData() + static_cast<size_t>(k) * dim);
+    counts.resize(k);
+    for (int j = 0; j < k; ++j) counts[j] = static_cast<double>(model.getClusterCounts()[j]);
+    batchSums.resize(static_cast<size_t>(k) * dim);
+    batchCounts.resize(k);
+
+    useTree = metric == DistanceMetric::SQUARED_EUCLIDEAN && CentroidKDTree::isBeneficial(k, dim);
+    if (useTree) centroidTree.build(centroids.data(), k, dim);
+}
+
+void OnlineKMeans::processBatch(const double* points, size_t n, int* labels) {
+    if (n == 0 || k == 0) return;
+    const long long count = static_cast<long long>(n);
+
+    // Assignment against the centroids as they were when the batch started
+    withMetric(metric, [&](auto policy) {
+        using Metric = decltype(policy);
+        #pragma omp parallel for schedule(static) if(n >= PARALLEL_BATCH_THRESHOLD)
+        for (long long i = 0; i < count; ++i) {
+            double dist;
+            labels[i] = useTree ? centroidTree.nearest(points + i * dim, dist)
+                                : nearestCentroidWith<Metric>(points + i * dim, centroids.data(), k, dim, dist);
+        }
+    });
+    pointsSeen += count;
+    if (!updatesCentroids(metric)) return;
+
+    // Batch statistics (k * dim, cheap next to the assignment)
+    std::fill(batchSums.begin(), batchSums.end(), 0.0);
+    std::fill(batchCounts.begin(), batchCounts.end(), 0.0);
+    for (long long i = 0; i < count; ++i) {
+        int j = labels[i];
+        if (j < 0) continue;    // no nearest centroid (non-finite coordinates)
+        batchCounts[j] += 1.0;
+        for (int d = 0; d < dim; ++d) batchSums[static_cast<size_t>(j) * dim + d] += points[i * dim + d];
+    }
+
+    const double fade = decay < 1.0 ? std::pow(decay, static_cast<double>(n)) : 1.0;
+    for (int j = 0; j < k; ++j) {
+        double kept = fade * counts[j];
+        counts[j] = kept + batchCounts[j];
+        if (batchCounts[j] == 0.0) continue;
+
+        double* c = centroids.data() + static_cast<size_t>(j) * dim;
+        for (int d = 0; d < dim; ++d) {
+            c[d] = (kept * c[d] + batchSums[static_cast<size_t>(j) * dim + d]) / counts[j];
+        }
+        if (metric == DistanceMetric::COSINE) CentroidUpdate::normalize(c, dim);
+    }
+
+    if (useTree) centroidTree.build(centroids.data(), k, dim);
+}
+
+KMeansModel OnlineKMeans::snapshot() const {
+    std::vector<Point> points(k);
+    std::vector<long long> roundedCounts(k);
+    for (int j = 0; j < k; ++j) {
+        auto first = centroids.begin() + static_cast<size_t>(j) * dim;
+        points[j].coords.assign(first, first + dim);
+        roundedCounts[j] = std::llround(counts[j]);
+    }
+
+    ModelMetadata info = metadata;
+    info.numPoints += pointsSeen;
+    info.inertia = 0.0;  // the training inertia no longer describes these centroids
+    info.trainedAt = 0;  // stamped with the snapshot time
+    return KMeansModel(points, roundedCounts, info);
+}
@@ -1,9 +1,13 @@
 #include "../include/parallel_kmeans.h"
+#include "../include/alloc_counter.h"
+#include "../include/data_loader.h"
 #include <chrono>
 #include <limits>
 #include <random>
 #include <iostream>
 #include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <omp.h>
 
 ParallelKMeans::ParallelKMeans(int k, int maxIter, double threshold)
@@ -11,7 +15,7 @@ ParallelKMeans::ParallelKMeans(int k, int maxIter, double threshold)
 
 void ParallelKMeans::initializeCentroids(const Dataset &data) {
     // Initialization can be serial as it's fast and done once
-    std::cout << "Initializing centroids (Parallel)..." << std::endl;
+    if (verbose) std::cout << "Initializing centroids (Parallel)..." << std::endl;
     centroids.clear();
 
     if (data.size() < static_cast<size_t>(k)) {
@@ -19,6 +23,15 @@ void ParallelKMeans::initializeCentroids(const Dataset &data) {
         return;
     }
 
+    if (!initialCentroids.empty()) {
+        if (initialCentroids.size() == static_cast<size_t>(k)
+            && initialCentroids[0].coords.size() == data[0].coords.size()) {
+            centroids = initialCentroids;
+            return;
+        }
+        std::cerr << "Warning: initial centroids do not match k/dim, using random initialization." << std::endl;
+    }
+
     std::vector<size_t> indices(data.size());
     for (size_t i = 0; i < indices.size(); i++) indices[i] = i;
 
@@ -33,74 +46,166 @@ void ParallelKMeans::initializeCentroids(const Dataset &data) {
 }
 
 void ParallelKMeans::assignClusters(Dataset& data) {
-    #pragma omp parallel for
-    for (int i = 0; i < static_cast<int>(data.size()); ++i) {
-        double minDist = std::numeric_limits<double>::max();
-        int bestCluster = -1;
-
-        for (int j = 0; j < k; ++j) {
-            double dist = distanceSquared(data[i], centroids[j]);
-            if (dist < minDist) {
-                minDist = dist;
-                bestCluster = j;
+    // One dispatch per pass, the workers run a loop compiled for the metric
+    withMetric(metric, [&](auto policy) { assignWith<decltype(policy)>(data); });
+}
+
+template <class Metric>
+void ParallelKMeans::assignWith(Dataset& data) {
+    const int dim = static_cast<int>(data[0].coords.size());
+    const int workers = workspace.numWorkers();
+
+    // Per-cluster SSE comes for free from the distances the assignment already computes,
+    // reseeding candidates for empty clusters are tracked in the same pass
+    workspace.resetAssignment(emptyPolicy);
+
+    const bool useTree = Metric::supportsKDTree && CentroidKDTree::isBeneficial(k, dim);
+    if (useTree) centroidTree.build(centroids);
+    const bool useNorms = normCache && !useTree && Metric::id == DistanceMetric::SQUARED_EUCLIDEAN;
+
+    // With the tree the cost per point varies, chunks are balanced by the backend
+    // std::atomic rather than omp atomic: the pool backend runs the ranges on std::threads
+    std::atomic<long long> moved{0};
+    const double* block = coordBlock.empty() ? nullptr : coordBlock.data();
+    auto assignRange = [&](long long begin, long long end, int worker) {
+        double* sse = workspace.sse(worker);
+        ReseedTracker& tracker = workspace.trackers[worker];
+        long long rangeMoved = 0;
+
+        for (long long i = begin; i < end; ++i) {
+            double minDist = std::numeric_limits<double>::max();
+            int bestCluster = -1;
+            const double* x = block ? block + i * dim : data[i].coords.data();
+
+            if (useTree) {
+                bestCluster = centroidTree.nearest(x, minDist);
+            } else if (useNorms) {
+                bestCluster = nearestCentroidByNorms(x, data[i].normSq, centroidRows.data(),
+                                                     centroidNorms.data(), k, dim, minDist);
+            } else {
+                for (int j = 0; j < k; ++j) {
+                    double dist = Metric::distance(x, centroids[j].coords.data(), dim);
+                    if (dist < minDist) {
+                        minDist = dist;
+                        bestCluster = j;
+                    }
+                }
             }
+            rangeMoved += data[i].clusterId != bestCluster;
+            data[i].clusterId = bestCluster;
+            if (reproducible) sseSum.deposit(sse + bestCluster * ReproducibleSum::FOLDS, data[i].weight * minDist);
+            else sse[bestCluster] += data[i].weight * minDist;
+            tracker.observe(minDist, static_cast<int>(i), bestCluster);
         }
-        data[i].clusterId = bestCluster;
+        moved.fetch_add(rangeMoved, std::memory_order_relaxed);
+    };
+    executor.parallelFor(static_cast<long long>(data.size()), chunkSize, assignRange);
+    movedPoints = moved.load();
+
+    // Merge in worker order
+    result.clusterSSE.assign(k, 0.0);
+    reseedTracker.reset(emptyPolicy, k);
+    if (reproducible) std::fill(foldedSSE.begin(), foldedSSE.end(), 0.0);
+    for (int w = 0; w < workers; ++w) {
+        const double* sse = workspace.sse(w);
+        if (reproducible) {
+            for (size_t j = 0; j < foldedSSE.size(); ++j) foldedSSE[j] += sse[j];
+        } else {
+            for (int j = 0; j < k; ++j) result.clusterSSE[j] += sse[j];
+        }
+        reseedTracker.merge(workspace.trackers[w]);
+    }
+    if (reproducible) {
+        for (int j = 0; j < k; ++j) result.clusterSSE[j] = ReproducibleSum::value(foldedSSE.data() + j * ReproducibleSum::FOLDS);
     }
 }
 
 bool ParallelKMeans::updateCentroids(const Dataset& data) {
-    std::vector<Point> newCentroids(k);
-    std::vector<int> counts(k, 0);
     size_t dim = data[0].coords.size();
-
-    // Initialize new centroids
-    for (int i = 0; i < k; ++i) {
-        newCentroids[i].coords.resize(dim, 0.0);
-    }
+    std::vector<Point>& newCentroids = workspace.nextCentroids;
 
     // Accumulate sums in parallel
-    // We need thread-local storage to avoid race conditions on newCentroids and counts
-    
-    #pragma omp parallel
-    {
-        std::vector<Point> localCentroids(k);
-        std::vector<int> localCounts(k, 0);
-        for(int i=0; i<k; ++i) localCentroids[i].coords.resize(dim, 0.0);
+    // Every worker has its own row of sums/counts in the workspace to avoid race conditions
+    workspace.resetSums();
 
-        #pragma omp for nowait
-        for (int i = 0; i < static_cast<int>(data.size()); ++i) {
-            int clusterId = data[i].clusterId;
-            if (clusterId == -1) continue;
+    // Points are taken in runs of equal labels: one accumulator row stays hot for the whole run,
+    // which on cluster-ordered data is a streaming reduction per cluster
+    std::atomic<long long> runsSeen{0};
+    const double* block = coordBlock.empty() ? nullptr : coordBlock.data();
+    auto accumulateRange = [&](long long begin, long long end, int worker) {
+        double* sums = workspace.sums(worker);
+        double* localWeights = workspace.weights(worker);
+        int* localCounts = workspace.workerCounts(worker);
+        long long runs = 0;
 
-            localCounts[clusterId]++;
-            for (size_t d = 0; d < dim; ++d) {
-                localCentroids[clusterId].coords[d] += data[i].coords[d];
+        for (long long i = begin; i < end;) {
+            const int clusterId = data[i].clusterId;
+            long long runEnd = i + 1;
+            while (runEnd < end && data[runEnd].clusterId == clusterId) runEnd++;
+            runs++;
+            if (clusterId == -1) {
+                i = runEnd;
+                continue;
             }
-        }
 
-        #pragma omp critical
-        {
-            for (int i = 0; i < k; ++i) {
-                counts[i] += localCounts[i];
+            localCounts[clusterId] += static_cast<int>(runEnd - i);
+            if (reproducible) {
+                constexpr int F = ReproducibleSum::FOLDS;
+                double* row = sums + clusterId * dim * F;
+                for (; i < runEnd; ++i) {
+                    const double w = data[i].weight;
+                    const double* coords = block ? block + i * dim : data[i].coords.data();
+                    weightSum.deposit(localWeights + clusterId * F, w);
+                    for (size_t d = 0; d < dim; ++d) coordSum.deposit(row + d * F, w * coords[d]);
+                }
+                continue;
+            }
+            double* row = sums + clusterId * dim;
+            double runWeight = 0.0;
+            for (; i < runEnd; ++i) {
+                const double w = data[i].weight;
+                const double* coords = block ? block + i * dim : data[i].coords.data();
+                runWeight += w;
                 for (size_t d = 0; d < dim; ++d) {
-                    newCentroids[i].coords[d] += localCentroids[i].coords[d];
+                    row[d] += w * coords[d];
                 }
             }
+            localWeights[clusterId] += runWeight;
         }
+        runsSeen.fetch_add(runs, std::memory_order_relaxed);
+    };
+    executor.parallelFor(static_cast<long long>(data.size()), chunkSize, accumulateRange);
+    labelRuns = runsSeen.load();
+
+    workspace.reduceWorkers();
+    workspace.collapseReduced();
+    const int* counts = workspace.reducedCounts.data();
+    const double* clusterWeight = workspace.reducedRow.data() + static_cast<size_t>(k) * dim + k;
+    for (int i = 0; i < k; ++i) {
+        std::copy(workspace.reducedRow.begin() + i * dim, workspace.reducedRow.begin() + (i + 1) * dim,
+                  newCentroids[i].coords.begin());
     }
 
-    // Division by the number of points (serial is fine here, k is small)
+    // k-medians replaces the means by per-dimension medians
+    if (metric == DistanceMetric::MANHATTAN) CentroidUpdate::medians(data, k, newCentroids);
+
+    // Division by the total weight (serial is fine here, k is small)
     double maxShift = 0.0;
+    std::vector<int>& emptyClusters = workspace.emptyClusters;
+    emptyClusters.clear();
     for (int i = 0; i < k; ++i) {
-        if (counts[i] == 0) {
-            newCentroids[i] = centroids[i];
+        if (clusterWeight[i] <= 0.0) {
+            newCentroids[i].coords = centroids[i].coords;
+            emptyClusters.push_back(i);
             continue;
         }
 
-        for (size_t d = 0; d < dim; ++d) {
-            newCentroids[i].coords[d] /= static_cast<double>(counts[i]);
+        if (metric != DistanceMetric::MANHATTAN) {
+            for (size_t d = 0; d < dim; ++d) {
+                newCentroids[i].coords[d] /= clusterWeight[i];
+            }
         }
+        if (metric == DistanceMetric::COSINE) CentroidUpdate::normalize(newCentroids[i].coords.data(), static_cast<int>(dim));
 
         double shift = distanceSquared(centroids[i], newCentroids[i]);
         if (shift > maxShift) {
@@ -108,27 +213,162 @@ bool ParallelKMeans::updateCentroids(const Dataset& data) {
         }
     }
 
-    centroids = newCentroids;
+    // Move dead centroids onto the candidates found during the assignment pass
+    if (!emptyClusters.empty() && reseedTracker.active()) {
+        for (const auto& move : reseedTracker.choose(emptyClusters, result.clusterSSE)) {
+            const Point& seed = data[move.second];
+            maxShift = std::max(maxShift, distanceSquared(centroids[move.first], seed));
+            newCentroids[move.first].coords = seed.coords;
+            if (metric == DistanceMetric::COSINE) CentroidUpdate::normalize(newCentroids[move.first].coords.data(), static_cast<int>(dim));
+            result.reseededClusters++;
+        }
+    }
+
+    workspace.swapCentroids(centroids);
+    refreshCentroidNorms();
+    result.clusterSizes.assign(counts, counts + k);
     return maxShift < (threshold * threshold);
 }
 
-int ParallelKMeans::run(Dataset& data) {
+void ParallelKMeans::refreshCentroidNorms() {
+    if (!normCache || metric != DistanceMetric::SQUARED_EUCLIDEAN) return;
+    const int dim = static_cast<int>(centroids[0].coords.size());
+    centroidRows.resize(static_cast<size_t>(k) * dim);
+    centroidNorms.resize(k);
+    for (int j = 0; j < k; ++j) {
+        std::copy(centroids[j].coords.begin(), centroids[j].coords.end(), centroidRows.begin() + static_cast<size_t>(j) * dim);
+    }
+    rowNorms(centroidRows.data(), k, dim, centroidNorms.data());
+}
+
+void ParallelKMeans::reorderByCluster(Dataset& data) {
+    const long long n = static_cast<long long>(data.size());
+    std::vector<long long> offsets;
+    std::vector<size_t> order(n);
+
+    #pragma omp parallel
+    {
+        const int t = omp_get_thread_num();
+        const int threads = omp_get_num_threads();
+        const long long begin = n * t / threads;
+        const long long end = n * (t + 1) / threads;
+
+        #pragma omp single
+        offsets.assign(static_cast<size_t>(threads) * k, 0);
+
+        // Per-thread histograms over static blocks, then (cluster, thread) prefix sums:
+        // the sort is stable, points of a cluster keep their relative order
+        long long* mine = offsets.data() + static_cast<size_t>(t) * k;
+        for (long long i = begin; i < end; ++i) mine[data[i].clusterId]++;
+        #pragma omp barrier
+
+        #pragma omp single
+        {
+            long long running = 0;
+            for (int j = 0; j < k; ++j) {
+                for (int w = 0; w < threads; ++w) {
+                    long long count = offsets[static_cast<size_t>(w) * k + j];
+                    offsets[static_cast<size_t>(w) * k + j] = running;
+                    running += count;
+                }
+            }
+        }
+
+        for (long long i = begin; i < end; ++i) order[mine[data[i].clusterId]++] = static_cast<size_t>(i);
+    }
+
+    // Copies instead of moves: the coordinates are reallocated in cluster order, so a cluster's
+    // points also end up next to each other in memory
+    Dataset sorted(n);
+    std::vector<size_t> sortedIndex(n);
+    #pragma omp parallel for schedule(static)
+    for (long long pos = 0; pos < n; ++pos) {
+        sorted[pos] = data[order[pos]];
+        sortedIndex[pos] = originalIndex.empty() ? order[pos] : originalIndex[order[pos]];
+    }
+    data.swap(sorted);
+    originalIndex.swap(sortedIndex);
+    reorderCount++;
+}
+
+void ParallelKMeans::restoreOrder(Dataset& data) {
+    const long long n = static_cast<long long>(data.size());
+    Dataset restored(n);
+    #pragma omp parallel for schedule(static)
+    for (long long pos = 0; pos < n; ++pos) restored[originalIndex[pos]] = std::move(data[pos]);
+    data.swap(restored);
+    originalIndex.clear();
+}
+
+void ParallelKMeans::packCoords(const Dataset& data) {
+    const long long n = static_cast<long long>(data.size());
+    const size_t dim = data[0].coords.size();
+    // Uninitialized (see AlignedAllocator::construct), so the pages are first touched by the workers
+    // copying in the passes' chunks rather than all by this thread. Chunks are scheduled dynamically,
+    // so this spreads the block over the NUMA nodes but does not place a chunk where it is read later
+    coordBlock.resize(n * dim);
+    executor.parallelFor(n, chunkSize, [&](long long begin, long long end, int) {
+        for (long long i = begin; i < end; ++i) std::copy(data[i].coords.begin(), data[i].coords.end(), coordBlock.begin() + i * dim);
+    });
+}
+
+void ParallelKMeans::configureSums(const Dataset& data) {
+    const long long n = static_cast<long long>(data.size());
+    const int dim = static_cast<int>(data[0].coords.size());
+    double maxAbs = 0.0;
+    double maxWeight = 0.0;
+    #pragma omp parallel for schedule(static) reduction(max:maxAbs, maxWeight)
+    for (long long i = 0; i < n; ++i) {
+        for (double x : data[i].coords) maxAbs = std::max(maxAbs, std::abs(x));
+        maxWeight = std::max(maxWeight, std::abs(data[i].weight));
+    }
+    // Given initial centroids may lie outside the data, later ones are means of points or points
+    for (const auto& c : centroids) {
+        for (double x : c.coords) maxAbs = std::max(maxAbs, std::abs(x));
+    }
+
+    coordSum.configure(maxWeight * maxAbs, n);
+    weightSum.configure(maxWeight, n);
+    sseSum.configure(maxWeight * maxDistance(metric, maxAbs, dim), n);
+    foldedSSE.assign(static_cast<size_t>(k) * ReproducibleSum::FOLDS, 0.0);
+}
+
+KMeansResult ParallelKMeans::run(Dataset& data) {
+    result = KMeansResult();
     if (data.empty() || k <= 0) {
         std::cerr << "Invalid data or k parameter." << std::endl;
-        return 0;
+        return result;
     }
     if (data.size() < static_cast<size_t>(k)) {
         std::cerr << "Error: Number of clusters k (" << k << ") is larger than dataset size (" << data.size() << ")." << std::endl;
-        return 0;
+        return result;
     }
 
+    executor.configure(backend);
+    chunkSize = Executor::chunkForL2(data[0].coords.size() * sizeof(double) + sizeof(Point));
+
     initTime = 0.0;
     totalAssignTime = 0.0;
     totalUpdateTime = 0.0;
+    originalIndex.clear();
+    reorderCount = 0;
 
     auto startInit = std::chrono::high_resolution_clock::now();
 
     initializeCentroids(data);
+    if (metric == DistanceMetric::COSINE) {
+        for (auto& c : centroids) CentroidUpdate::normalize(c.coords.data(), static_cast<int>(c.coords.size()));
+    }
+    workspace.prepare(executor.numWorkers(), k, static_cast<int>(data[0].coords.size()), emptyPolicy,
+                      reproducible ? ReproducibleSum::FOLDS : 1);
+    if (reproducible) configureSums(data);
+    if (normCache && metric == DistanceMetric::SQUARED_EUCLIDEAN) {
+        // Refreshed on every run, coordinates edited since loading would leave stale norms.
+        // One O(n * dim) pass, small next to the iterations
+        DataLoader::computeNorms(data);
+        refreshCentroidNorms();
+    }
+    if (packed) packCoords(data);
 
     auto endInit = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> diffInit = endInit - startInit;
@@ -136,8 +376,11 @@ int ParallelKMeans::run(Dataset& data) {
 
     int iter = 0;
     bool converged = false;
+    long long allocsAfterFirst = 0;
 
     while (iter < maxIter && !converged) {
+        // The first iteration may still grow buffers, everything after it must not allocate
+        if (iter == 1) allocsAfterFirst = AllocCounter::count();
 
         auto startAssign = std::chrono::high_resolution_clock::now();
         assignClusters(data);
@@ -152,7 +395,133 @@ int ParallelKMeans::run(Dataset& data) {
         totalUpdateTime += diffUpdate.count();
 
         iter++;
+
+        // Labels have settled but the points are scattered (or have drifted since the last sort)
+        const double limit = reorderThreshold * static_cast<double>(data.size());
+        if (reorder && !converged && iter < maxIter && movedPoints < limit && labelRuns - k > limit) {
+            reorderByCluster(data);
+            if (packed) packCoords(data);
+        }
+    }
+    steadyStateAllocations = iter > 1 ? AllocCounter::count() - allocsAfterFirst : 0;
+    if (!originalIndex.empty()) restoreOrder(data);
+    AlignedVector<double>().swap(coordBlock);
+
+    result.iterations = iter;
+    result.converged = converged;
+    result.inertia = 0.0;
+    for (double s : result.clusterSSE) result.inertia += s;
+    if (silhouetteSample > 0) {
+        result.silhouette = ClusterMetrics::sampledSilhouette(data, k, silhouetteSample);
+    }
+
+    trainingInfo = ModelMetadata();
+    trainingInfo.numPoints = static_cast<int64_t>(data.size());
+    trainingInfo.iterations = iter;
+    trainingInfo.inertia = result.inertia;
+    trainingInfo.metric = metric;
+
+    return result;
+}
+
+KMeansResult ParallelKMeans::run(SparseDataset& data) {
+    result = KMeansResult();
+    const long long n = data.numRows();
+    if (n <= 0 || k <= 0 || data.dim <= 0) {
+        std::cerr << "Invalid data or k parameter." << std::endl;
+        return result;
+    }
+    if (n < k) {
+        std::cerr << "Error: Number of clusters k (" << k << ") is larger than dataset size (" << n << ")." << std::endl;
+        return result;
+    }
+    const int dim = data.dim;
+    DistanceMetric sparseMetric = metric;
+    if (metric == DistanceMetric::MANHATTAN) {
+        std::cerr << "Warning: manhattan distance is not supported on sparse data, using squared euclidean." << std::endl;
+        sparseMetric = DistanceMetric::SQUARED_EUCLIDEAN;
+    }
+    if (reproducible) std::cerr << "Warning: reproducible sums are not implemented for sparse data." << std::endl;
+
+    initTime = 0.0;
+    totalAssignTime = 0.0;
+    totalUpdateTime = 0.0;
+
+    auto startInit = std::chrono::high_resolution_clock::now();
+
+    if (verbose) std::cout << "Initializing centroids (Parallel, sparse)..." << std::endl;
+    // O(nnz), so always recomputed: values edited since the last run would leave stale norms
+    data.computeNorms();
+    SparseCentroids current;
+    current.resize(k, dim);
+    SparseKMeansOps::initialize(data, initialCentroids, current);
+    if (sparseMetric == DistanceMetric::COSINE) {
+        for (int j = 0; j < k; ++j) CentroidUpdate::normalize(current.rows.data() + static_cast<size_t>(j) * dim, dim);
+        current.refresh();
     }
 
-    return iter;
+    // The next centroids double as the sum buffer
+    std::vector<double> next(static_cast<size_t>(k) * dim);
+    std::vector<double> clusterWeight(k);
+    std::vector<int> counts(k);
+    std::vector<int> emptyClusters;
+
+    auto endInit = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> diffInit = endInit - startInit;
+    initTime = diffInit.count();
+
+    int iter = 0;
+    bool converged = false;
+
+    while (iter < maxIter && !converged) {
+        auto startAssign = std::chrono::high_resolution_clock::now();
+        result.clusterSSE.assign(k, 0.0);
+        reseedTracker.reset(emptyPolicy, k);
+        SparseKMeansOps::assign(data, current, result.clusterSSE.data(), reseedTracker, emptyPolicy, sparseMetric);
+        auto endAssign = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> diffAssign = endAssign - startAssign;
+        totalAssignTime += diffAssign.count();
+
+        auto startUpdate = std::chrono::high_resolution_clock::now();
+        SparseKMeansOps::accumulate(data, k, next.data(), clusterWeight.data(), counts.data());
+        double maxShift = SparseKMeansOps::finishUpdate(next.data(), clusterWeight.data(), current, emptyClusters, sparseMetric);
+
+        if (!emptyClusters.empty() && reseedTracker.active()) {
+            std::vector<double> seed(dim);
+            for (const auto& move : reseedTracker.choose(emptyClusters, result.clusterSSE)) {
+                double* row = next.data() + static_cast<size_t>(move.first) * dim;
+                data.densifyRow(move.second, seed.data());
+                if (sparseMetric == DistanceMetric::COSINE) CentroidUpdate::normalize(seed.data(), dim);
+                double shift = 0.0;
+                for (int d = 0; d < dim; ++d) shift += (row[d] - seed[d]) * (row[d] - seed[d]);
+                maxShift = std::max(maxShift, shift);
+                std::copy(seed.begin(), seed.end(), row);
+                result.reseededClusters++;
+            }
+        }
+
+        current.rows.swap(next);
+        current.refresh();
+        converged = maxShift < (threshold * threshold);
+        auto endUpdate = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> diffUpdate = endUpdate - startUpdate;
+        totalUpdateTime += diffUpdate.count();
+
+        iter++;
+    }
+
+    centroids = current.toPoints();
+    result.clusterSizes.assign(counts.begin(), counts.end());
+    result.iterations = iter;
+    result.converged = converged;
+    result.inertia = 0.0;
+    for (double s : result.clusterSSE) result.inertia += s;
+
+    trainingInfo = ModelMetadata();
+    trainingInfo.numPoints = static_cast<int64_t>(n);
+    trainingInfo.iterations = iter;
+    trainingInfo.inertia = result.inertia;
+    trainingInfo.metric = sparseMetric;
+
+    return result;
 }
@@ -0,0 +1,208 @@
+#include "../include/run_planner.h"
+#include "../include/parallel_kmeans.h"
+#include "../include/philox.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <omp.h>
+
+namespace {
+
+const char* engineName(PlannedEngine engine) {
+    switch (engine) {
+        case PlannedEngine::OPENMP: return "openmp";
+        case PlannedEngine::BISECTING: return "bisecting";
+        case PlannedEngine::DISTRIBUTED: return "distributed";
+    }
+    return "?";
+}
+
+const char* precisionName(CommCompression compression) {
+    return compression == CommCompression::FLOAT32_DELTA ? "float32 deltas" : "double";
+}
+
+}
+
+void RunPlan::print(std::ostream& out) const {
+    std::ios_base::fmtflags flags = out.flags();
+    out << "Plan for n=" << numPoints << ", dim=" << dim << ", k=" << k << std::endl;
+    out << "  Sample: " << sampleSize << " points, " << sampleIterations << " iterations ("
+        << quarterIterations << " on a quarter)" << (sampleConverged ? "" : ", not converged") << std::endl;
+    out << std::fixed << std::setprecision(1);
+    out << "  Per point and pass: assign " << assignSecondsPerPoint * 1e9 << " ns, update "
+        << updateSecondsPerPoint * 1e9 << " ns (all threads, " << threadSpeedup << "x over one)" << std::endl;
+    if (reduceSeconds > 0.0) out << "  Sums Allreduce: " << std::setprecision(3) << reduceSeconds * 1e3 << " ms" << std::endl;
+    out << "  Recommended: " << engineName(engine) << ", " << threads << " threads x " << ranks << " ranks, "
+        << precisionName(compression) << " sums" << std::endl;
+    out << "  Predicted: " << predictedIterations << " iterations, " << std::setprecision(2) << predictedSeconds << " s" << std::endl;
+    out << "  Why: " << reason << std::endl;
+    out.flags(flags);
+}
+
+RunPlanner::RunPlanner(int k, int maxIter, double threshold) : k(k), maxIter(maxIter), threshold(threshold) {}
+
+void RunPlanner::measure(const Dataset& data, RunPlan& plan) const {
+    const long long n = static_cast<long long>(data.size());
+    long long m = sampleSize > 0 ? sampleSize : std::max<long long>(50000, 50LL * k);
+    m = std::min(n, std::max<long long>(m, k));
+
+    // Stratified: one point from each of m equal slices, so sorted input is covered end to end
+    Dataset sample(m);
+    for (long long i = 0; i < m; ++i) {
+        double u = Philox4x32::toUniform(Philox4x32::generate(static_cast<uint64_t>(i), 0, seed).v[0]);
+        long long index = std::min(n - 1, static_cast<long long>((static_cast<double>(i) + u) * n / m));
+        sample[i] = data[index];
+    }
+    std::vector<Point> initial(sample.begin(), sample.begin() + k);
+
+    plan.numPoints = n;
+    plan.dim = static_cast<int>(data[0].coords.size());
+    plan.sampleSize = m;
+    plan.threads = omp_get_max_threads();
+
+    // Every fourth sample point, same initial centroids
+    Dataset work((m + 3) / 4);
+    for (size_t i = 0; i < work.size(); ++i) work[i] = sample[4 * i];
+    bool quarterConverged = true;
+    if (static_cast<long long>(work.size()) >= k) {
+        ParallelKMeans quarter(k, maxIter, threshold);
+        quarter.setVerbose(false);
+        quarter.setInitialCentroids(initial);
+        KMeansResult quarterResult = quarter.run(work);
+        plan.quarterIterations = quarterResult.iterations;
+        quarterConverged = quarterResult.converged;
+    }
+
+    work = sample;
+    ParallelKMeans full(k, maxIter, threshold);
+    full.setVerbose(false);
+    full.setInitialCentroids(initial);
+    KMeansResult result = full.run(work);
+    const double passes = static_cast<double>(std::max(1, result.iterations)) * m;
+    plan.sampleIterations = result.iterations;
+    plan.sampleConverged = result.converged && quarterConverged;
+    plan.assignSecondsPerPoint = full.getAssignTime() / passes;
+    plan.updateSecondsPerPoint = full.getUpdateTime() / passes;
+
+    // A few iterations on one thread for the scaling
+    plan.threadSpeedup = 1.0;
+    if (plan.threads > 1) {
+        const int serialIterations = std::min(3, std::max(1, result.iterations));
+        work = sample;
+        omp_set_num_threads(1);
+        ParallelKMeans serial(k, serialIterations, 0.0);
+        serial.setVerbose(false);
+        serial.setInitialCentroids(initial);
+        KMeansResult serialResult = serial.run(work);
+        omp_set_num_threads(plan.threads);
+
+        const double serialPerPoint = (serial.getAssignTime() + serial.getUpdateTime())
+                                      / (static_cast<double>(std::max(1, serialResult.iterations)) * m);
+        const double perPoint = plan.assignSecondsPerPoint + plan.updateSecondsPerPoint;
+        if (perPoint > 0.0) plan.threadSpeedup = serialPerPoint / perPoint;
+    }
+}
+
+void RunPlanner::recommend(RunPlan& plan, int availableRanks) const {
+    // Growth per doubling of the points from the quarter and the full sample, continued up to n
+    if (plan.sampleConverged) {
+        const double perDoubling = plan.quarterIterations > 0
+            ? std::max(0.0, (plan.sampleIterations - plan.quarterIterations) / 2.0) : 0.0;
+        const double doublings = std::log2(static_cast<double>(plan.numPoints) / plan.sampleSize);
+        plan.predictedIterations = std::min(maxIter, static_cast<int>(std::ceil(plan.sampleIterations + perDoubling * doublings)));
+    } else {
+        plan.predictedIterations = maxIter;
+    }
+
+    const double n = static_cast<double>(plan.numPoints);
+    const double threadedIteration = n * (plan.assignSecondsPerPoint + plan.updateSecondsPerPoint);
+
+    // The compute splits over the ranks, the sums exchange is paid once per iteration. Float32
+    // deltas halve the exchange where it is a sizeable part of the iteration
+    int bestRanks = 1;
+    double bestIteration = threadedIteration;
+    CommCompression bestCompression = CommCompression::NONE;
+    for (int r = 2; r <= availableRanks; ++r) {
+        const double compute = threadedIteration / r;
+        const bool compress = plan.reduceSeconds > 0.25 * compute;
+        const double iteration = compute + (compress ? 0.5 : 1.0) * plan.reduceSeconds;
+        if (iteration < bestIteration) {
+            bestIteration = iteration;
+            bestRanks = r;
+            bestCompression = compress ? CommCompression::FLOAT32_DELTA : CommCompression::NONE;
+        }
+    }
+
+    plan.ranks = bestRanks;
+    plan.compression = bestCompression;
+    if (bestRanks > 1) {
+        plan.engine = PlannedEngine::DISTRIBUTED;
+        plan.predictedSeconds = plan.predictedIterations * bestIteration;
+        plan.reason = "the compute per iteration outweighs the sums exchange up to " + std::to_string(bestRanks) + " ranks";
+    } else if (plan.k >= BISECTING_MIN_K) {
+        plan.engine = PlannedEngine::BISECTING;
+        plan.predictedSeconds = plan.predictedIterations * threadedIteration;
+        plan.reason = "k >= " + std::to_string(BISECTING_MIN_K) + ": splitting costs O(log k) instead of O(k) per point "
+                      "(approximate, the time given is for flat k-means)";
+    } else if (plan.threadSpeedup >= 1.5) {
+        plan.engine = PlannedEngine::OPENMP;
+        plan.predictedSeconds = plan.predictedIterations * threadedIteration;
+        plan.reason = "threads scale on this machine and one process holds the data";
+    } else {
+        plan.engine = PlannedEngine::OPENMP;
+        plan.threads = 1;
+        plan.predictedSeconds = plan.predictedIterations * threadedIteration * plan.threadSpeedup;
+        plan.reason = plan.threadSpeedup > 1.0 ? "more threads did not pay off on the sample" : "one thread available";
+    }
+}
+
+RunPlan RunPlanner::plan(const Dataset& data, Transport& world) const {
+    RunPlan plan;
+    plan.k = k;
+    if (world.rank() == 0) {
+        if (data.empty() || k <= 0) {
+            std::cerr << "Invalid data or k parameter." << std::endl;
+        } else if (data.size() < static_cast<size_t>(k)) {
+            std::cerr << "Error: Number of clusters k (" << k << ") is larger than dataset size (" << data.size() << ")." << std::endl;
+        } else {
+            measure(data, plan);
+        }
+    }
+
+    // Shape and measurements from rank 0, every rank then derives the same plan
+    double shared[10] = {static_cast<double>(plan.numPoints), static_cast<double>(plan.dim),
+                         static_cast<double>(plan.sampleSize), static_cast<double>(plan.sampleIterations),
+                         plan.sampleConverged ? 1.0 : 0.0, plan.assignSecondsPerPoint, plan.updateSecondsPerPoint,
+                         plan.threadSpeedup, static_cast<double>(plan.threads), static_cast<double>(plan.quarterIterations)};
+    world.bcast(shared, 10, CommDatatype::DOUBLE, 0);
+    plan.numPoints = static_cast<long long>(shared[0]);
+    plan.dim = static_cast<int>(shared[1]);
+    plan.sampleSize = static_cast<long long>(shared[2]);
+    plan.sampleIterations = static_cast<int>(shared[3]);
+    plan.sampleConverged = shared[4] != 0.0;
+    plan.assignSecondsPerPoint = shared[5];
+    plan.updateSecondsPerPoint = shared[6];
+    plan.threadSpeedup = shared[7];
+    plan.threads = static_cast<int>(shared[8]);
+    plan.quarterIterations = static_cast<int>(shared[9]);
+    if (plan.numPoints == 0) return plan;
+
+    // One iteration's exchange of the synchronous loop: k * dim sums, k SSE values, k weights
+    if (world.size() > 1) {
+        const int repeats = 5;
+        std::vector<double> row(static_cast<size_t>(k) * plan.dim + 2 * static_cast<size_t>(k), 1.0);
+        world.allreduce(row.data(), static_cast<int>(row.size()), CommDatatype::DOUBLE, CommOp::SUM);
+        world.barrier();
+        double start = world.wtime();
+        for (int i = 0; i < repeats; ++i) {
+            world.allreduce(row.data(), static_cast<int>(row.size()), CommDatatype::DOUBLE, CommOp::SUM);
+        }
+        double elapsed = (world.wtime() - start) / repeats;
+        world.allreduce(&elapsed, 1, CommDatatype::DOUBLE, CommOp::MAX);
+        plan.reduceSeconds = elapsed;
+    }
+
+    recommend(plan, world.size());
+    return plan;
+}
@@ -0,0 +1,208 @@
+#include "../include/sparse_dataset.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <omp.h>
+
+void SparseDataset::addRow(const int* cols, const double* vals, int count, double weight) {
+    colIdx.insert(colIdx.end(), cols, cols + count);
+    values.insert(values.end(), vals, vals + count);
+    rowPtr.push_back(static_cast<long long>(colIdx.size()));
+    if (weight != 1.0 && weights.empty()) weights.assign(numRows() - 1, 1.0);
+    if (!weights.empty()) weights.push_back(weight);
+}
+
+void SparseDataset::computeNorms() {
+    const long long n = numRows();
+    normSq.resize(n);
+
+    #pragma omp parallel for schedule(static)
+    for (long long r = 0; r < n; ++r) {
+        double sum = 0.0;
+        for (long long p = rowPtr[r]; p < rowPtr[r + 1]; ++p) sum += values[p] * values[p];
+        normSq[r] = sum;
+    }
+}
+
+void SparseDataset::densifyRow(long long row, double* out) const {
+    std::fill(out, out + dim, 0.0);
+    for (long long p = rowPtr[row]; p < rowPtr[row + 1]; ++p) out[colIdx[p]] = values[p];
+}
+
+void SparseCentroids::resize(int numClusters, int numDim) {
+    k = numClusters;
+    dim = numDim;
+    rows.assign(static_cast<size_t>(k) * dim, 0.0);
+    transposed.assign(static_cast<size_t>(k) * dim, 0.0);
+    normSq.assign(k, 0.0);
+}
+
+void SparseCentroids::refresh() {
+    #pragma omp parallel for schedule(static)
+    for (int d = 0; d < dim; ++d) {
+        for (int j = 0; j < k; ++j) transposed[static_cast<size_t>(d) * k + j] = rows[static_cast<size_t>(j) * dim + d];
+    }
+    for (int j = 0; j < k; ++j) {
+        const double* c = rows.data() + static_cast<size_t>(j) * dim;
+        double sum = 0.0;
+        #pragma omp simd reduction(+:sum)
+        for (int d = 0; d < dim; ++d) sum += c[d] * c[d];
+        normSq[j] = sum;
+    }
+}
+
+std::vector<Point> SparseCentroids::toPoints() const {
+    std::vector<Point> points;
+    points.reserve(k);
+    for (int j = 0; j < k; ++j) {
+        auto first = rows.begin() + static_cast<size_t>(j) * dim;
+        points.emplace_back(std::vector<double>(first, first + dim));
+    }
+    return points;
+}
+
+void SparseKMeansOps::initialize(const SparseDataset& data, const std::vector<Point>& initial,
+                                 SparseCentroids& centroids) {
+    const int k = centroids.k;
+    const int dim = centroids.dim;
+
+    if (!initial.empty()) {
+        if (initial.size() == static_cast<size_t>(k) && initial[0].coords.size() == static_cast<size_t>(dim)) {
+            for (int j = 0; j < k; ++j) {
+                std::copy(initial[j].coords.begin(), initial[j].coords.end(), centroids.rows.begin() + static_cast<size_t>(j) * dim);
+            }
+            centroids.refresh();
+            return;
+        }
+        std::cerr << "Warning: initial centroids do not match k/dim, using random initialization." << std::endl;
+    }
+
+    // Partial Fisher-Yates over the row indices
+    std::vector<long long> indices(data.numRows());
+    for (long long i = 0; i < data.numRows(); ++i) indices[i] = i;
+    std::random_device rd;
+    std::mt19937 g(rd());
+    for (int j = 0; j < k; ++j) {
+        std::uniform_int_distribution<long long> pick(j, data.numRows() - 1);
+        std::swap(indices[j], indices[pick(g)]);
+        data.densifyRow(indices[j], centroids.rows.data() + static_cast<size_t>(j) * dim);
+    }
+    centroids.refresh();
+}
+
+void SparseKMeansOps::assign(SparseDataset& data, const SparseCentroids& centroids, double* clusterSSE,
+                             ReseedTracker& tracker, EmptyClusterPolicy policy, DistanceMetric metric) {
+    const long long n = data.numRows();
+    const int k = centroids.k;
+    const bool cosine = metric == DistanceMetric::COSINE;
+    data.labels.resize(n);
+
+    #pragma omp parallel
+    {
+        std::vector<double> dots(k);
+        std::vector<double> localSSE(k, 0.0);
+        ReseedTracker localTracker;
+        localTracker.reset(policy, k);
+
+        #pragma omp for schedule(dynamic, 256)
+        for (long long r = 0; r < n; ++r) {
+            std::fill(dots.begin(), dots.end(), 0.0);
+            for (long long p = data.rowPtr[r]; p < data.rowPtr[r + 1]; ++p) {
+                const double v = data.values[p];
+                const double* column = centroids.transposed.data() + static_cast<size_t>(data.colIdx[p]) * k;
+                #pragma omp simd
+                for (int j = 0; j < k; ++j) dots[j] += v * column[j];
+            }
+
+            // Both metrics are normScale * ||c||^2 + dotScale * x.c + offset, so the scan has no branch
+            const double norm = std::sqrt(data.normSq[r]);
+            const double normScale = cosine ? 0.0 : 1.0;
+            const double dotScale = cosine ? (norm > 0.0 ? -1.0 / norm : 0.0) : -2.0;
+            const double offset = cosine ? 1.0 : data.normSq[r];
+
+            double minDist = std::numeric_limits<double>::max();
+            int best = 0;
+            for (int j = 0; j < k; ++j) {
+                double dist = normScale * centroids.normSq[j] + dotScale * dots[j];
+                if (dist < minDist) {
+                    minDist = dist;
+                    best = j;
+                }
+            }
+            // Cancellation can leave a tiny negative value for a point sitting on its centroid
+            minDist = std::max(0.0, minDist + offset);
+
+            data.labels[r] = best;
+            localSSE[best] += data.weight(r) * minDist;
+            localTracker.observe(minDist, static_cast<int>(r), best);
+        }
+
+        #pragma omp critical
+        {
+            for (int j = 0; j < k; ++j) clusterSSE[j] += localSSE[j];
+            tracker.merge(localTracker);
+        }
+    }
+}
+
+void SparseKMeansOps::accumulate(const SparseDataset& data, int k, double* sums, double* clusterWeight, int* counts) {
+    const long long n = data.numRows();
+    const int dim = data.dim;
+
+    // Counting sort of the rows by cluster
+    std::vector<long long> start(k + 1, 0);
+    for (long long r = 0; r < n; ++r) start[data.labels[r] + 1]++;
+    for (int j = 0; j < k; ++j) start[j + 1] += start[j];
+    std::vector<long long> order(n);
+    std::vector<long long> next(start.begin(), start.end() - 1);
+    for (long long r = 0; r < n; ++r) order[next[data.labels[r]]++] = r;
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int j = 0; j < k; ++j) {
+        double* sum = sums + static_cast<size_t>(j) * dim;
+        std::fill(sum, sum + dim, 0.0);
+        double weight = 0.0;
+        for (long long i = start[j]; i < start[j + 1]; ++i) {
+            long long r = order[i];
+            const double w = data.weight(r);
+            weight += w;
+            for (long long p = data.rowPtr[r]; p < data.rowPtr[r + 1]; ++p) sum[data.colIdx[p]] += w * data.values[p];
+        }
+        clusterWeight[j] = weight;
+        counts[j] = static_cast<int>(start[j + 1] - start[j]);
+    }
+}
+
+double SparseKMeansOps::finishUpdate(double* sums, const double* clusterWeight, const SparseCentroids& current,
+                                     std::vector<int>& emptyClusters, DistanceMetric metric) {
+    const int k = current.k;
+    const int dim = current.dim;
+    emptyClusters.clear();
+    std::vector<double> shifts(k, 0.0);
+
+    #pragma omp parallel for schedule(static)
+    for (int j = 0; j < k; ++j) {
+        double* row = sums + static_cast<size_t>(j) * dim;
+        const double* old = current.rows.data() + static_cast<size_t>(j) * dim;
+        if (clusterWeight[j] <= 0.0) {
+            std::copy(old, old + dim, row);
+            continue;
+        }
+        for (int d = 0; d < dim; ++d) row[d] /= clusterWeight[j];
+        if (metric == DistanceMetric::COSINE) CentroidUpdate::normalize(row, dim);
+
+        double shift = 0.0;
+        for (int d = 0; d < dim; ++d) {
+            double diff = row[d] - old[d];
+            shift += diff * diff;
+        }
+        shifts[j] = shift;
+    }
+
+    for (int j = 0; j < k; ++j) {
+        if (clusterWeight[j] <= 0.0) emptyClusters.push_back(j);
+    }
+    return *std::max_element(shifts.begin(), shifts.end());
+}
@@ -0,0 +1,312 @@
+#include "../include/stream_service.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+static std::atomic<bool> stopRequested{false};
+static std::atomic<bool> stopReading{false};
+
+StreamService::StreamService(const KMeansModel& trained, const StreamConfig& config)
+    : config(config), model(trained, config.halfLife), dim(trained.getDim()) {
+    this->config.maxQueuedPoints = std::max<size_t>(this->config.maxQueuedPoints, 1);
+    this->config.minBatch = std::max<size_t>(this->config.minBatch, 1);
+    ring.resize(this->config.maxQueuedPoints * dim);
+    ringValid.resize(this->config.maxQueuedPoints);
+    ringArrival.resize(this->config.maxQueuedPoints);
+    batchTarget = this->config.minBatch;
+}
+
+void StreamService::push(const double* coords, bool valid) {
+    std::unique_lock<std::mutex> lk(queueMutex);
+    // Backpressure: while the queue is full nothing more is read from the input
+    notFull.wait(lk, [&] { return queued < config.maxQueuedPoints || stopReading.load(); });
+    if (queued == config.maxQueuedPoints) return;
+
+    size_t slot = (head + queued) % config.maxQueuedPoints;
+    std::copy(coords, coords + dim, ring.begin() + slot * dim);
+    ringValid[slot] = valid ? 1 : 0;
+    ringArrival[slot] = Clock::now();
+    queued++;
+    // First point starts the consumer's deadline, a full batch ends its wait
+    if (queued == 1 || queued >= batchTarget) notEmpty.notify_one();
+}
+
+#ifndef _WIN32
+
+static void onStopSignal(int) {
+    stopRequested = true;
+}
+
+void StreamService::readerLoop(int inFd) {
+    std::vector<char> buffer(1 << 16);
+    std::string line;
+    bool overlong = false;          // line hit maxLineBytes, the rest of it is dropped
+    std::vector<double> coords(dim);
+
+    auto parseLine = [&]() {
+        if (overlong) {
+            push(coords.data(), false);
+            line.clear();
+            overlong = false;
+            return;
+        }
+        if (line.empty()) return;
+        int found = 0;
+        const char* p = line.c_str();
+        while (*p && found <= dim) {
+            while (*p == ' ' || *p == ',' || *p == '\t' || *p == '\r') ++p;
+            if (!*p) break;
+            char* end;
+            double v = std::strtod(p, &end);
+            // nan, inf and overflowing values have no nearest centroid
+            if (end == p || !std::isfinite(v)) {
+                found = -1;
+                break;
+            }
+            if (found < dim) coords[found] = v;
+            found++;
+            p = end;
+        }
+        push(coords.data(), found == dim);
+        line.clear();
+    };
+
+    while (!stopReading) {
+        // Short poll timeouts so a shutdown request is seen even without input
+        pollfd pfd {inFd, POLLIN, 0};
+        int ready = poll(&pfd, 1, 200);
+        if (ready < 0 && errno != EINTR) break;
+        if (stopRequested) break;
+        if (ready <= 0) continue;
+
+        ssize_t got = read(inFd, buffer.data(), buffer.size());
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) break;
+
+        for (ssize_t i = 0; i < got; ++i) {
+            if (buffer[i] == '\n') parseLine();
+            else if (line.size() < config.maxLineBytes) line.push_back(buffer[i]);
+            else overlong = true;
+        }
+    }
+    parseLine(); // last line without a newline
+
+    std::lock_guard<std::mutex> lk(queueMutex);
+    inputClosed = true;
+    notEmpty.notify_all();
+}
+
+static bool writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return false;
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+void StreamService::publishSnapshot() {
+    std::string tmp = config.snapshotPath + ".tmp";
+    if (model.snapshot().save(tmp) && std::rename(tmp.c_str(), config.snapshotPath.c_str()) == 0) {
+        snapshots++;
+    } else {
+        std::cerr << "[Stream] Warning: snapshot to " << config.snapshotPath << " failed." << std::endl;
+    }
+    lastSnapshot = Clock::now();
+}
+
+bool StreamService::serveConnection(int inFd, int outFd) {
+    {
+        std::lock_guard<std::mutex> lk(queueMutex);
+        head = 0;
+        queued = 0;
+        inputClosed = false;
+    }
+    stopReading = false;
+    std::thread reader(&StreamService::readerLoop, this, inFd);
+
+    const double latencyTargetS = config.latencyTargetMs / 1000.0;
+    std::vector<double> batch(config.maxBatch * dim);
+    std::vector<double> validPoints(config.maxBatch * dim);
+    std::vector<char> valid(config.maxBatch);
+    std::vector<Clock::time_point> arrival(config.maxBatch);
+    std::vector<int> labels(config.maxBatch);
+    std::vector<int> validLabels(config.maxBatch);
+    std::string out;
+    bool clientOk = true;
+
+    while (true) {
+        size_t take = 0;
+        {
+            std::unique_lock<std::mutex> lk(queueMutex);
+            // Wait for a full batch, but never longer than the oldest point can afford
+            while (queued < batchTarget && !inputClosed) {
+                if (queued == 0) {
+                    notEmpty.wait(lk);
+                    continue;
+                }
+                double budget = std::max(0.0, latencyTargetS - costPerPointS * static_cast<double>(batchTarget));
+                auto deadline = ringArrival[head] + std::chrono::duration_cast<Clock::duration>(
+                                                        std::chrono::duration<double>(budget));
+                if (notEmpty.wait_until(lk, deadline) == std::cv_status::timeout) break;
+            }
+            if (queued == 0 && inputClosed) break;
+
+            take = std::min({queued, batchTarget.load(), config.maxBatch});
+            for (size_t i = 0; i < take; ++i) {
+                size_t slot = (head + i) % config.maxQueuedPoints;
+                std::copy(ring.begin() + slot * dim, ring.begin() + (slot + 1) * dim, batch.begin() + i * dim);
+                valid[i] = ringValid[slot];
+                arrival[i] = ringArrival[slot];
+            }
+            head = (head + take) % config.maxQueuedPoints;
+            queued -= take;
+            notFull.notify_one();
+        }
+
+        auto start = Clock::now();
+
+        // Malformed lines keep their place in the output as -1
+        size_t numValid = 0;
+        for (size_t i = 0; i < take; ++i) {
+            if (!valid[i]) continue;
+            std::copy(batch.begin() + i * dim, batch.begin() + (i + 1) * dim, validPoints.begin() + numValid * dim);
+            numValid++;
+        }
+        model.processBatch(validPoints.data(), numValid, validLabels.data());
+
+        out.clear();
+        char row[16];
+        for (size_t i = 0, v = 0; i < take; ++i) {
+            int label = valid[i] ? validLabels[v++] : -1;
+            char* p = std::to_chars(row, row + 12, label).ptr;
+            *p++ = '\n';
+            out.append(row, p);
+        }
+        if (!writeAll(outFd, out.data(), out.size())) {
+            clientOk = false;
+            break;
+        }
+
+        auto done = Clock::now();
+        double elapsed = std::chrono::duration<double>(done - start).count();
+        for (size_t i = 0; i < take; ++i) {
+            double latency = std::chrono::duration<double, std::milli>(done - arrival[i]).count();
+            maxLatencyMs = std::max(maxLatencyMs, latency);
+            sumLatencyMs += latency;
+        }
+        pointsServed += static_cast<long long>(take);
+        invalidLines += static_cast<long long>(take - numValid);
+        batches++;
+
+        // Half of the target goes to processing, the rest is left for waiting/queueing
+        costPerPointS = 0.8 * costPerPointS + 0.2 * (elapsed / static_cast<double>(take));
+        double fit = 0.5 * latencyTargetS / std::max(costPerPointS, 1e-9);
+        batchTarget = static_cast<size_t>(std::clamp(fit, static_cast<double>(config.minBatch),
+                                                     static_cast<double>(std::min(config.maxBatch, config.maxQueuedPoints))));
+
+        if (config.snapshotIntervalS > 0.0
+            && std::chrono::duration<double>(done - lastSnapshot).count() >= config.snapshotIntervalS) {
+            publishSnapshot();
+        }
+    }
+
+    stopReading = true;
+    notFull.notify_all();
+    reader.join();
+    return clientOk;
+}
+
+int StreamService::run() {
+    if (!OnlineKMeans::updatesCentroids(model.getMetric())) {
+        std::cerr << "[Stream] Error: " << metricName(model.getMetric())
+                  << " models cannot be updated online (no running median), only euclidean and cosine are served." << std::endl;
+        return 1;
+    }
+    std::signal(SIGPIPE, SIG_IGN);
+    struct sigaction sa {};
+    sa.sa_handler = onStopSignal;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0; // no SA_RESTART: blocking accept/poll return on the signal
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+    stopRequested = false;
+    lastSnapshot = Clock::now();
+
+    if (config.socketPath.empty()) {
+        std::cerr << "[Stream] Serving stdin (k=" << model.getK() << ", dim=" << dim << ")" << std::endl;
+        serveConnection(STDIN_FILENO, STDOUT_FILENO);
+    } else {
+        int server = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un addr {};
+        addr.sun_family = AF_UNIX;
+        if (server < 0 || config.socketPath.size() >= sizeof(addr.sun_path)) {
+            std::cerr << "[Stream] Error: cannot create socket " << config.socketPath << "." << std::endl;
+            if (server >= 0) close(server);
+            return 1;
+        }
+        std::strncpy(addr.sun_path, config.socketPath.c_str(), sizeof(addr.sun_path) - 1);
+        unlink(config.socketPath.c_str());
+        if (bind(server, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(server, 4) != 0) {
+            std::cerr << "[Stream] Error: cannot listen on " << config.socketPath << ": " << std::strerror(errno) << std::endl;
+            close(server);
+            return 1;
+        }
+        std::cerr << "[Stream] Listening on " << config.socketPath << " (k=" << model.getK() << ", dim=" << dim << ")" << std::endl;
+
+        // One client at a time, the model state carries over between clients
+        while (!stopRequested) {
+            int client = accept(server, nullptr, nullptr);
+            if (client < 0) {
+                if (errno == EINTR) continue;
+                std::cerr << "[Stream] Error: accept failed: " << std::strerror(errno) << std::endl;
+                break;
+            }
+            if (!serveConnection(client, client)) {
+                std::cerr << "[Stream] Client disconnected before all labels were sent." << std::endl;
+            }
+            close(client);
+        }
+        close(server);
+        unlink(config.socketPath.c_str());
+    }
+
+    if (config.snapshotIntervalS > 0.0) publishSnapshot();
+    printStats();
+    return 0;
+}
+
+#else
+
+void StreamService::readerLoop(int) {}
+bool StreamService::serveConnection(int, int) { return false; }
+void StreamService::publishSnapshot() {}
+
+int StreamService::run() {
+    std::cerr << "[Stream] Error: the streaming service needs POSIX pipes/sockets." << std::endl;
+    return 1;
+}
+
+#endif
+
+void StreamService::printStats() const {
+    std::cerr << "[Stream] Points: " << pointsServed << " (" << invalidLines << " invalid), batches: " << batches
+              << ", mean batch: " << (batches > 0 ? static_cast<double>(pointsServed) / batches : 0.0)
+              << ", latency mean/max: " << (pointsServed > 0 ? sumLatencyMs / pointsServed : 0.0)
+              << " / " << maxLatencyMs << " ms, snapshots: " << snapshots << std::endl;
+}
@@ -0,0 +1,109 @@
+#include "../include/sums_exchange.h"
+#include <algorithm>
+#include <cstring>
+
+void SumsExchange::prepare(CommCompression newMode, int numClusters, int numDim, int tailSize,
+                           NodeReducer* nodeReducer) {
+    mode = newMode;
+    reducer = nodeReducer;
+    if (reducer) reducer->resetNetworkBytes();
+    k = numClusters;
+    dim = numDim;
+    tail = tailSize;
+    primed = false;
+    bytes = 0;
+
+    const size_t sums = static_cast<size_t>(k) * dim;
+    known.assign(mode == CommCompression::NONE ? 0 : sums, 0.0);
+    global.assign(mode == CommCompression::NONE ? 0 : sums, 0.0);
+    changed.assign(mode == CommCompression::CHANGED_CLUSTERS ? k : 0, 0);
+    packed.assign(mode == CommCompression::CHANGED_CLUSTERS ? sums + tail : 0, 0.0);
+    deltas.assign(mode == CommCompression::FLOAT32_DELTA ? sums : 0, 0.0f);
+    tailBuffer.assign(mode == CommCompression::FLOAT32_DELTA ? tail : 0, 0.0);
+}
+
+template <class T>
+void SumsExchange::sum(T* data, int count, Transport& transport) {
+    if (reducer) {
+        long long before = reducer->getNetworkBytes();
+        reducer->sum(data, count);
+        bytes += reducer->getNetworkBytes() - before;
+    } else {
+        transport.allreduce(data, count, commDatatypeOf<T>(), CommOp::SUM);
+        bytes += static_cast<long long>(count) * sizeof(T);
+    }
+}
+
+void SumsExchange::reduceCounts(const int* local, int* out, int count, Transport& transport) {
+    std::copy(local, local + count, out);
+    sum(out, count, transport);
+}
+
+void SumsExchange::reduceFull(const double* local, double* out, Transport& transport) {
+    const int size = k * dim + tail;
+    std::copy(local, local + size, out);
+    sum(out, size, transport);
+
+    if (mode != CommCompression::NONE) {
+        // Everybody now knows the exact local and global sums
+        std::copy(local, local + static_cast<size_t>(k) * dim, known.begin());
+        std::copy(out, out + static_cast<size_t>(k) * dim, global.begin());
+        primed = true;
+    }
+}
+
+void SumsExchange::reduce(const double* local, double* out, bool forceExact, Transport& transport) {
+    if (mode == CommCompression::NONE || !primed || forceExact) {
+        reduceFull(local, out, transport);
+        return;
+    }
+    const size_t sums = static_cast<size_t>(k) * dim;
+
+    if (mode == CommCompression::CHANGED_CLUSTERS) {
+        // Same members in the same order -> bit-identical row, so a row compare finds the changes
+        for (int j = 0; j < k; ++j) {
+            const size_t offset = static_cast<size_t>(j) * dim;
+            changed[j] = std::memcmp(local + offset, known.data() + offset, dim * sizeof(double)) != 0;
+        }
+        // Summed flags: > 0 means changed on some rank
+        sum(changed.data(), k, transport);
+
+        // Full local rows of every cluster that changed anywhere, then the tail
+        size_t used = 0;
+        for (int j = 0; j < k; ++j) {
+            if (!changed[j]) continue;
+            const double* row = local + static_cast<size_t>(j) * dim;
+            std::copy(row, row + dim, packed.begin() + used);
+            std::copy(row, row + dim, known.begin() + static_cast<size_t>(j) * dim);
+            used += dim;
+        }
+        std::copy(local + sums, local + sums + tail, packed.begin() + used);
+        const int count = static_cast<int>(used) + tail;
+        sum(packed.data(), count, transport);
+
+        used = 0;
+        for (int j = 0; j < k; ++j) {
+            if (!changed[j]) continue;
+            std::copy(packed.begin() + used, packed.begin() + used + dim, global.begin() + static_cast<size_t>(j) * dim);
+            used += dim;
+        }
+        std::copy(global.begin(), global.end(), out);
+        std::copy(packed.begin() + used, packed.begin() + used + tail, out + sums);
+        return;
+    }
+
+    // FLOAT32_DELTA: send what the others do not know yet, rounded to float. The rounding
+    // error stays in local - known and goes out with the next delta (error feedback). The
+    // rounding of the cross-rank float sum is not fed back, see the bound in the header
+    for (size_t i = 0; i < sums; ++i) {
+        deltas[i] = static_cast<float>(local[i] - known[i]);
+        known[i] += static_cast<double>(deltas[i]);
+    }
+    sum(deltas.data(), static_cast<int>(sums), transport);
+    std::copy(local + sums, local + sums + tail, tailBuffer.begin());
+    sum(tailBuffer.data(), tail, transport);
+
+    for (size_t i = 0; i < sums; ++i) global[i] += static_cast<double>(deltas[i]);
+    std::copy(global.begin(), global.end(), out);
+    std::copy(tailBuffer.begin(), tailBuffer.end(), out + sums);
+}
@@ -0,0 +1,109 @@
+#include "../include/thread_pool.h"
+#include <algorithm>
+#include <omp.h>
+
+WorkStealingPool::WorkStealingPool(int numThreads) {
+    numWorkers = numThreads > 0 ? numThreads : omp_get_max_threads();
+    if (numWorkers < 1) numWorkers = 1;
+
+    queues.reset(new ChunkQueue[numWorkers]);
+    for (int i = 1; i < numWorkers; ++i) {
+        threads.emplace_back(&WorkStealingPool::workerLoop, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lk(wakeMutex);
+        stopping = true;
+    }
+    wakeCv.notify_all();
+    for (auto& t : threads) t.join();
+}
+
+void WorkStealingPool::workerLoop(int id) {
+    unsigned long long seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lk(wakeMutex);
+            wakeCv.wait(lk, [&] { return stopping || epoch != seen; });
+            if (stopping) return;
+            seen = epoch;
+        }
+
+        drain(id);
+
+        if (busyWorkers.fetch_sub(1) == 1) {
+            std::lock_guard<std::mutex> lk(doneMutex);
+            doneCv.notify_one();
+        }
+    }
+}
+
+bool WorkStealingPool::nextChunk(int id, long long& chunkIdx) {
+    {
+        ChunkQueue& own = queues[id];
+        std::lock_guard<std::mutex> lk(own.lock);
+        if (own.head < own.tail) {
+            chunkIdx = own.head++;
+            return true;
+        }
+    }
+
+    // Own queue is empty: steal from the back of the others, starting with the neighbour
+    for (int offset = 1; offset < numWorkers; ++offset) {
+        ChunkQueue& victim = queues[(id + offset) % numWorkers];
+        std::lock_guard<std::mutex> lk(victim.lock);
+        if (victim.head < victim.tail) {
+            chunkIdx = --victim.tail;
+            stolenChunks.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::drain(int id) {
+    long long chunkIdx;
+    while (nextChunk(id, chunkIdx)) {
+        long long begin = chunkIdx * jobChunk;
+        long long end = std::min(jobSize, begin + jobChunk);
+        jobFn(jobCtx, begin, end, id);
+    }
+}
+
+void WorkStealingPool::run(long long n, long long chunk, RangeFn fn, void* ctx) {
+    if (n <= 0) return;
+    chunk = std::max(1LL, chunk);
+    const long long numChunks = (n + chunk - 1) / chunk;
+
+    // Nothing to share, skip the wake-up
+    if (numWorkers == 1 || numChunks == 1) {
+        fn(ctx, 0, n, 0);
+        return;
+    }
+
+    jobFn = fn;
+    jobCtx = ctx;
+    jobSize = n;
+    jobChunk = chunk;
+
+    // Contiguous block of chunks per worker, stealing evens out the rest
+    for (int w = 0; w < numWorkers; ++w) {
+        std::lock_guard<std::mutex> lk(queues[w].lock);
+        queues[w].head = numChunks * w / numWorkers;
+        queues[w].tail = numChunks * (w + 1) / numWorkers;
+    }
+
+    busyWorkers.store(numWorkers - 1);
+    {
+        std::lock_guard<std::mutex> lk(wakeMutex);
+        ++epoch;
+    }
+    wakeCv.notify_all();
+
+    drain(0);
+
+    std::unique_lock<std::mutex> lk(doneMutex);
+    doneCv.wait(lk, [&] { return busyWorkers.load() == 0; });
+}
@@ -0,0 +1,24 @@
+#include "../include/transport.h"
+#include "../include/local_transport.h"
+#include "../include/mpi_transport.h"
+
+size_t commDatatypeSize(CommDatatype type) {
+    switch (type) {
+        case CommDatatype::INT: return sizeof(int);
+        case CommDatatype::LONG_LONG: return sizeof(long long);
+        case CommDatatype::FLOAT: return sizeof(float);
+        case CommDatatype::DOUBLE: return sizeof(double);
+        case CommDatatype::BYTE: return 1;
+        case CommDatatype::DOUBLE_INT: return sizeof(DoubleInt);
+    }
+    return 1;
+}
+
+Transport& Transport::world() {
+#ifdef USE_MPI
+    static MpiTransport transport(MPI_COMM_WORLD);
+#else
+    static LocalTransport transport(std::make_shared<LocalCluster>(1, LocalLatency()), 0);
+#endif
+    return transport;
+}